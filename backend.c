@@ -0,0 +1,119 @@
+/*
+ * backend.c - the list of allocator backends, and the backends that are
+ *     not mm.c: the C library's malloc and a bump allocator
+ */
+#include "backend.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memlib.h"
+
+static const backend_t *backends[MAX_BACKENDS];
+static int num_backends = 0;
+
+/*
+ * backend_register - add a backend to the list
+ */
+void backend_register(const backend_t *b) {
+    if (num_backends == MAX_BACKENDS) {
+        fprintf(stderr, "backend_register: too many backends (%s)\n", b->name);
+        exit(1);
+    }
+    backends[num_backends++] = b;
+}
+
+int backend_count(void) { return num_backends; }
+
+const backend_t *backend_get(int i) { return backends[i]; }
+
+/*
+ * backend_find - look a backend up by name
+ */
+const backend_t *backend_find(const char *name) {
+    int i;
+
+    for (i = 0; i < num_backends; i++)
+        if (!strcmp(backends[i]->name, name)) return backends[i];
+    return NULL;
+}
+
+/*****************************************************************
+ * libc: the C library's malloc, the usual throughput baseline
+ ****************************************************************/
+
+static int libc_init(void) { return 0; }
+
+static const backend_t libc_backend = {
+    "libc",  "the C library's malloc (no utilization)",
+    0,       libc_init,
+    malloc,  free,
+    realloc, NULL,
+    1,       NULL,
+    NULL};
+BACKEND_REGISTER(libc_backend)
+
+/*****************************************************************
+ * bump: hands out memlib memory in order and never reuses it. This is
+ * the least bookkeeping per request any memlib allocator can do; its
+ * utilization shows what reusing memory is worth, and traces that
+ * allocate more than MAX_HEAP bytes in total run it out of memory.
+ ****************************************************************/
+
+#define BUMP_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+static int bump_init(void) { return 0; }
+
+/*
+ * bump_malloc - take size bytes (plus a header holding the size) from the
+ *     top of the heap
+ */
+static void *bump_malloc(size_t size) {
+    size_t *hdr;
+
+    size = BUMP_ALIGN(size);
+    hdr = (size_t *)mem_sbrk((int)(sizeof(size_t) + size));
+    if (hdr == (void *)-1) return NULL;
+    *hdr = size;
+    return hdr + 1;
+}
+
+static void bump_free(void *ptr) { (void)ptr; }
+
+/*
+ * bump_realloc - grow the block in place if it is the last one in the
+ *     heap, and move it otherwise
+ */
+static void *bump_realloc(void *ptr, size_t size) {
+    size_t *hdr, old;
+    void *newp;
+
+    if (ptr == NULL) return bump_malloc(size);
+    if (size == 0) return NULL;
+    hdr = (size_t *)ptr - 1;
+    old = *hdr;
+    size = BUMP_ALIGN(size);
+    if (size <= old) return ptr;
+    if ((char *)ptr + old == (char *)mem_heap_hi() + 1) {
+        if (mem_sbrk((int)(size - old)) == (void *)-1) return NULL;
+        *hdr = size;
+        return ptr;
+    }
+    if ((newp = bump_malloc(size)) == NULL) return NULL;
+    memcpy(newp, ptr, old);
+    return newp;
+}
+
+static const backend_t bump_backend = {"bump",
+                                       "bump allocator that never frees memory",
+                                       1,
+                                       bump_init,
+                                       bump_malloc,
+                                       bump_free,
+                                       bump_realloc,
+                                       NULL,
+                                       0,
+                                       NULL,
+                                       NULL};
+BACKEND_REGISTER(bump_backend)
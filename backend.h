@@ -0,0 +1,51 @@
+#ifndef BACKEND_H_
+#define BACKEND_H_
+
+#include <stddef.h>
+
+#include "mm.h"
+
+/*
+ * An allocator that mdriver can evaluate. Every backend linked into
+ * mdriver registers itself (with BACKEND_REGISTER) before main runs; -b
+ * selects the one to evaluate and -e runs them all side by side.
+ *
+ * The driver calls mem_reset_brk() before init, so a backend that takes
+ * its memory from memlib starts each replay with an empty heap.
+ */
+typedef struct {
+    const char *name;        /* selected with -b */
+    const char *description; /* shown by mdriver -h */
+    int uses_memlib;         /* allocates from the memlib heap: its payloads are
+                                checked against the heap bounds and its utilization
+                                is measured against mem_heapsize() */
+    int (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    void (*stats)(struct mm_stats *stats); /* optional, may be NULL */
+    int thread_safe; /* may be called from several threads at once (-M) */
+    /* the policy knobs of mm.h (-p and -X); optional, may be NULL */
+    void (*get_policy)(struct mm_policy *policy);
+    int (*set_policy)(const struct mm_policy *policy);
+} backend_t;
+
+#define MAX_BACKENDS 16
+
+/* add a backend to the list; called from the constructors below */
+void backend_register(const backend_t *b);
+
+/* the registered backends, in the order they were registered */
+int backend_count(void);
+const backend_t *backend_get(int i);
+
+/* the backend called name, or NULL if there is none */
+const backend_t *backend_find(const char *name);
+
+/* register the backend_t b before main runs */
+#define BACKEND_REGISTER(b)                                       \
+    static void __attribute__((constructor)) register_##b(void) { \
+        backend_register(&b);                                     \
+    }
+
+#endif /* BACKEND_H_ */
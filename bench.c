@@ -0,0 +1,89 @@
+/*
+ * bench.c - medians and bootstrap confidence intervals for the runner
+ */
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned long rng; /* splitmix64 state */
+
+static unsigned long next_random(void) {
+    unsigned long z = (rng += 0x9e3779b97f4a7c15UL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+    return z ^ (z >> 31);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * median - the median of x[0..n-1], which it sorts
+ */
+static double median(double *x, int n) {
+    qsort(x, n, sizeof(double), cmp_double);
+    return n % 2 ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2;
+}
+
+/*
+ * resample_median - the median of n samples drawn from x with replacement
+ */
+static double resample_median(const double *x, int n) {
+    double r[BENCH_MAX_RUNS];
+    int i;
+
+    for (i = 0; i < n; i++) r[i] = x[next_random() % n];
+    return median(r, n);
+}
+
+/*
+ * bench_median - the median of n samples
+ */
+double bench_median(const double *x, int n) {
+    double r[BENCH_MAX_RUNS];
+
+    memcpy(r, x, n * sizeof(double));
+    return median(r, n);
+}
+
+/*
+ * interval - the central BENCH_CONFIDENCE of the bootstrap estimates
+ */
+static void interval(double *est, double *lo, double *hi) {
+    double tail = (1 - BENCH_CONFIDENCE) / 2;
+
+    qsort(est, BENCH_RESAMPLES, sizeof(double), cmp_double);
+    *lo = est[(int)(tail * (BENCH_RESAMPLES - 1))];
+    *hi = est[(int)((1 - tail) * (BENCH_RESAMPLES - 1) + 0.5)];
+}
+
+/*
+ * bench_median_ci - a bootstrap confidence interval for the median
+ */
+void bench_median_ci(const double *x, int n, double *lo, double *hi) {
+    static double est[BENCH_RESAMPLES];
+    int i;
+
+    rng = 0;
+    for (i = 0; i < BENCH_RESAMPLES; i++) est[i] = resample_median(x, n);
+    interval(est, lo, hi);
+}
+
+/*
+ * bench_ratio_ci - the ratio of the medians of b and a, and a bootstrap
+ *     confidence interval for it (a and b are resampled independently)
+ */
+double bench_ratio_ci(const double *a, int na, const double *b, int nb,
+                      double *lo, double *hi) {
+    static double est[BENCH_RESAMPLES];
+    int i;
+
+    rng = 0;
+    for (i = 0; i < BENCH_RESAMPLES; i++)
+        est[i] = resample_median(b, nb) / resample_median(a, na);
+    interval(est, lo, hi);
+    return bench_median(b, nb) / bench_median(a, na);
+}
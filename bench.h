@@ -0,0 +1,37 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/*
+ * Statistics for the benchmark runner (-n): the median of repeated timing
+ * samples and percentile bootstrap confidence intervals, both for one set
+ * of samples and for the ratio of two (a run against a saved baseline).
+ *
+ * The resampling generator has a fixed seed, so the same samples always
+ * give the same intervals.
+ */
+
+#define BENCH_MAX_RUNS 100    /* samples kept per trace */
+#define BENCH_RESAMPLES 2000  /* bootstrap resamples per interval */
+#define BENCH_CONFIDENCE 0.95 /* coverage of the intervals */
+#define BENCH_DEFAULT_RUNS 10 /* runs if -B or -c is given without -n */
+
+/* A change against the baseline is only reported if its interval excludes
+ * no change and the median moved by at least BENCH_MIN_CHANGE; a drop in
+ * utilization (which does not vary between runs) by more than
+ * BENCH_UTIL_TOLERANCE is always reported. The intervals only cover the
+ * noise within one session; the minimum change is there to absorb the
+ * drift of a shared machine between the baseline and the comparison. */
+#define BENCH_MIN_CHANGE 0.05
+#define BENCH_UTIL_TOLERANCE 0.0001
+
+/* the median of n samples */
+double bench_median(const double *x, int n);
+
+/* a confidence interval for the median of n samples */
+void bench_median_ci(const double *x, int n, double *lo, double *hi);
+
+/* the ratio median(b) / median(a), and a confidence interval for it */
+double bench_ratio_ci(const double *a, int na, const double *b, int nb,
+                      double *lo, double *hi);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,333 @@
+/*
+ * bound.c - utilization bounds for a trace (see bound.h)
+ *
+ * The abstract heap is a list of segments, blocks and holes, in address
+ * order. Adjacent holes are always merged, and the last segment ends at
+ * the top of the heap. Each placement scans all the holes, which no real
+ * allocator could afford, but an offline bound can.
+ *
+ * A realloc is done in place when the block shrinks, or when the hole
+ * after it (or the top of the heap) has room for it to grow. Otherwise it
+ * slides down into the hole before it if that makes room, as a
+ * coalescing realloc would, and only then moves to a new place chosen by
+ * the policy.
+ */
+#include "bound.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+#include "mm.h"
+
+const char *bound_policy_names[BOUND_POLICIES] = {"first-fit", "best-fit",
+                                                  "lifetime"};
+
+#define HOLE (-1) /* the death of a hole */
+
+/* A block or a hole */
+typedef struct {
+    size_t addr, size;
+    int death;      /* op that frees or reallocs the block, or HOLE */
+    int prev, next; /* neighbours in address order, -1 at either end */
+} seg_t;
+
+/* The abstract heap during one replay */
+typedef struct {
+    seg_t *segs;
+    int *spare; /* stack of unused segs */
+    int nspare;
+    int head, tail; /* lowest and highest segs, -1 if none */
+    size_t top;     /* size of the heap so far */
+} space_t;
+
+static size_t align_size(int size) {
+    size_t s = ((size_t)size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    return s ? s : ALIGNMENT; /* every block takes some room */
+}
+
+/*
+ * seg_new - take an unused seg and link it in after prev (-1: the lowest)
+ */
+static int seg_new(space_t *s, int prev, size_t addr, size_t size, int death) {
+    int i = s->spare[--s->nspare];
+    seg_t *g = &s->segs[i];
+    int next = prev < 0 ? s->head : s->segs[prev].next;
+
+    g->addr = addr;
+    g->size = size;
+    g->death = death;
+    g->prev = prev;
+    g->next = next;
+    if (prev < 0)
+        s->head = i;
+    else
+        s->segs[prev].next = i;
+    if (next < 0)
+        s->tail = i;
+    else
+        s->segs[next].prev = i;
+    return i;
+}
+
+static void seg_unlink(space_t *s, int i) {
+    seg_t *g = &s->segs[i];
+
+    if (g->prev < 0)
+        s->head = g->next;
+    else
+        s->segs[g->prev].next = g->next;
+    if (g->next < 0)
+        s->tail = g->prev;
+    else
+        s->segs[g->next].prev = g->prev;
+    s->spare[s->nspare++] = i;
+}
+
+static int is_hole(space_t *s, int i) {
+    return i >= 0 && s->segs[i].death == HOLE;
+}
+
+/*
+ * make_hole - free seg i and merge it with the holes around it; return
+ *     the merged hole
+ */
+static int make_hole(space_t *s, int i) {
+    seg_t *g = &s->segs[i];
+    int j;
+
+    g->death = HOLE;
+    if (is_hole(s, g->next)) {
+        j = g->next;
+        g->size += s->segs[j].size;
+        seg_unlink(s, j);
+    }
+    if (is_hole(s, g->prev)) {
+        j = g->prev;
+        s->segs[j].size += g->size;
+        seg_unlink(s, i);
+        i = j;
+    }
+    return i;
+}
+
+/*
+ * place - carve a block of size bytes out of hole h, at its high end if
+ *     high is set; return the block
+ */
+static int place(space_t *s, int h, size_t size, int death, int high) {
+    seg_t *g = &s->segs[h];
+
+    if (g->size == size) {
+        g->death = death;
+        return h;
+    }
+    g->size -= size;
+    if (high) return seg_new(s, h, g->addr + g->size, size, death);
+    g->addr += size;
+    return seg_new(s, g->prev, g->addr - size, size, death);
+}
+
+/*
+ * grow - put a block at the top of the heap, taking in the hole there
+ */
+static int grow(space_t *s, size_t size, int death) {
+    int i = s->tail;
+
+    if (is_hole(s, i)) {
+        s->segs[i].size = size;
+        s->segs[i].death = death;
+    } else {
+        i = seg_new(s, i, s->top, size, death);
+    }
+    s->top = s->segs[i].addr + size;
+    return i;
+}
+
+/* distance in ops between two deaths */
+static int death_gap(int a, int b) { return a > b ? a - b : b - a; }
+
+/* A hole the lifetime policy could use */
+typedef struct {
+    int seg;   /* -1 if none yet */
+    int exact; /* the block fills it */
+    int gap;   /* ops between the block's death and its neighbour's */
+    int high;  /* the neighbour is above the hole */
+} candidate_t;
+
+/* an exact fit first, then the nearest death, then the smallest hole */
+static int better(space_t *s, const candidate_t *c, const candidate_t *best) {
+    if (best->seg < 0) return 1;
+    if (c->exact != best->exact) return c->exact;
+    if (c->gap != best->gap) return c->gap < best->gap;
+    return s->segs[c->seg].size < s->segs[best->seg].size;
+}
+
+/*
+ * choose - pick the hole for a block of size bytes dying at op death, and
+ *     which end of it to use; return -1 if no hole fits
+ */
+static int choose(space_t *s, int policy, size_t size, int death, int *high) {
+    candidate_t best = {-1, 0, 0, 0}, c;
+    seg_t *g;
+    int i;
+
+    for (i = s->head; i >= 0; i = g->next) {
+        g = &s->segs[i];
+        if (g->death != HOLE || g->size < size) continue;
+        if (policy == BOUND_FIRSTFIT) {
+            best.seg = i;
+            break;
+        }
+        if (policy == BOUND_BESTFIT) {
+            if (best.seg < 0 || g->size < s->segs[best.seg].size) best.seg = i;
+            continue;
+        }
+
+        /* BOUND_LIFETIME: put the block next to the neighbour that dies
+           nearest to it, so that the holes they leave merge. The bottom
+           of the heap never dies, and the top is only a last resort. */
+        c.seg = i;
+        c.exact = g->size == size;
+        c.gap =
+            death_gap(death, g->prev < 0 ? INT_MAX : s->segs[g->prev].death);
+        c.high = 0;
+        if (g->next >= 0 && death_gap(death, s->segs[g->next].death) < c.gap) {
+            c.gap = death_gap(death, s->segs[g->next].death);
+            c.high = 1;
+        }
+        if (better(s, &c, &best)) best = c;
+    }
+    *high = best.high;
+    return best.seg;
+}
+
+/*
+ * replay - serve the trace under one policy and return the heap it needed
+ */
+static size_t replay(trace_t *trace, const int *death, int policy, space_t *s,
+                     int *seg_of) {
+    size_t size;
+    seg_t *g;
+    int i, id, h, high, next;
+
+    s->nspare = 0;
+    for (i = 2 * trace->num_ids + 3; i >= 0; i--) s->spare[s->nspare++] = i;
+    s->head = s->tail = -1;
+    s->top = 0;
+    for (i = 0; i < trace->num_ids; i++) seg_of[i] = -1;
+
+    for (i = 0; i < trace->num_ops; i++) {
+        id = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+            case ALLOC:
+                size = align_size(trace->ops[i].size);
+                h = choose(s, policy, size, death[i], &high);
+                seg_of[id] = h < 0 ? grow(s, size, death[i])
+                                   : place(s, h, size, death[i], high);
+                break;
+
+            case REALLOC:
+                size = align_size(trace->ops[i].size);
+                h = seg_of[id];
+                g = &s->segs[h];
+                g->death = death[i];
+                next = g->next;
+                if (size <= g->size) { /* shrink in place */
+                    if (size < g->size) {
+                        make_hole(s, seg_new(s, h, g->addr + size,
+                                             g->size - size, HOLE));
+                        g->size = size;
+                    }
+                } else if (is_hole(s, next) &&
+                           g->size + s->segs[next].size >= size) {
+                    /* grow into the hole above */
+                    s->segs[next].addr += size - g->size;
+                    s->segs[next].size -= size - g->size;
+                    g->size = size;
+                    if (s->segs[next].size == 0) seg_unlink(s, next);
+                } else if (next < 0 || (is_hole(s, next) && next == s->tail)) {
+                    /* grow the heap */
+                    if (next >= 0) seg_unlink(s, next);
+                    g->size = size;
+                    s->top = g->addr + size;
+                } else if (is_hole(s, g->prev) &&
+                           s->segs[g->prev].size + g->size +
+                                   (is_hole(s, next) ? s->segs[next].size
+                                                     : 0) >=
+                               size) {
+                    /* slide down into the hole below */
+                    h = make_hole(s, h);
+                    seg_of[id] = place(s, h, size, death[i], 0);
+                } else { /* move, then free the old block */
+                    next = choose(s, policy, size, death[i], &high);
+                    seg_of[id] = next < 0
+                                     ? grow(s, size, death[i])
+                                     : place(s, next, size, death[i], high);
+                    make_hole(s, h);
+                }
+                break;
+
+            case FREE:
+                if (seg_of[id] >= 0) make_hole(s, seg_of[id]);
+                seg_of[id] = -1;
+                break;
+        }
+    }
+    return s->top;
+}
+
+/*
+ * trace_bound - find the peak live payload of the trace, and the heap it
+ *     needs under each policy
+ */
+int trace_bound(trace_t *trace, bound_t *b) {
+    int n = trace->num_ops, ids = trace->num_ids;
+    int *death = (int *)malloc(n * sizeof(int));
+    int *next_use = (int *)malloc(ids * sizeof(int));
+    int *seg_of = (int *)malloc(ids * sizeof(int));
+    size_t *sizes = (size_t *)calloc(ids, sizeof(size_t));
+    size_t live = 0;
+    space_t s;
+    int i, p, ret = -1;
+
+    s.segs = (seg_t *)malloc((2 * ids + 4) * sizeof(seg_t));
+    s.spare = (int *)malloc((2 * ids + 4) * sizeof(int));
+    if (!death || !next_use || !seg_of || !sizes || !s.segs || !s.spare)
+        goto out;
+
+    /* each block dies at the next op on its id: a free, or a realloc,
+       which makes a new block */
+    for (i = 0; i < ids; i++) next_use[i] = n;
+    for (i = n - 1; i >= 0; i--) {
+        death[i] = next_use[trace->ops[i].index];
+        next_use[trace->ops[i].index] = i;
+    }
+
+    b->peak_live = 0;
+    for (i = 0; i < n; i++) {
+        traceop_t *op = &trace->ops[i];
+        live -= sizes[op->index];
+        sizes[op->index] = op->type == FREE ? 0 : (size_t)op->size;
+        live += sizes[op->index];
+        if (live > b->peak_live) b->peak_live = live;
+    }
+
+    b->best = 0;
+    for (p = 0; p < BOUND_POLICIES; p++) {
+        b->heap[p] = replay(trace, death, p, &s, seg_of);
+        if (b->heap[p] < b->heap[b->best]) b->best = p;
+    }
+    ret = 0;
+out:
+    free(death);
+    free(next_use);
+    free(seg_of);
+    free(sizes);
+    free(s.segs);
+    free(s.spare);
+    return ret;
+}
+
+double bound_util(const bound_t *b) {
+    return b->heap[b->best] ? (double)b->peak_live / b->heap[b->best] : 0;
+}
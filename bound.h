@@ -0,0 +1,41 @@
+#ifndef BOUND_H_
+#define BOUND_H_
+
+#include <stddef.h>
+
+#include "trace.h"
+
+/*
+ * Utilization bounds for a trace: how small a heap the trace could be
+ * served from, found by replaying it on an abstract address space with
+ * no headers, footers or minimum block size, only ALIGNMENT. The heap
+ * grows like sbrk and never shrinks.
+ *
+ * Each policy places blocks with the whole trace in hand. None of them is
+ * optimal (offline placement is NP-hard), so the best of them is a bound
+ * that is known to be achievable, not a proof that nothing does better.
+ * The peak live payload is the absolute limit.
+ */
+
+enum {
+    BOUND_FIRSTFIT, /* the lowest hole that fits */
+    BOUND_BESTFIT,  /* the smallest hole that fits */
+    BOUND_LIFETIME, /* the hole whose neighbours die closest to the block */
+    BOUND_POLICIES
+};
+
+extern const char *bound_policy_names[BOUND_POLICIES];
+
+typedef struct {
+    size_t peak_live;            /* peak payload, as in eval_mm_util */
+    size_t heap[BOUND_POLICIES]; /* heap each policy needed */
+    int best;                    /* the policy with the smallest heap */
+} bound_t;
+
+/* replay trace under every policy; return -1 if out of memory */
+int trace_bound(trace_t *trace, bound_t *b);
+
+/* the best utilization a policy reached, peak_live / heap[best] */
+double bound_util(const bound_t *b);
+
+#endif /* BOUND_H_ */
@@ -0,0 +1,101 @@
+/*
+ * classes.c - choose size classes for a size histogram (see classes.h)
+ */
+#include "classes.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * best_classes - choose at most k class sizes among the n distinct sizes
+ *     in sc (sorted) so that rounding every request up to its class
+ *     wastes the fewest bytes, by dynamic programming over where each
+ *     class ends. The largest size is always a class. Store the classes in
+ *     classes and return how many there are, or -1 if out of memory.
+ */
+int best_classes(const size_count_t *sc, int n, int k, long *classes) {
+    double *cost, *prev, *cur;
+    int *from;
+    long *cnt, *bytes;
+    int c, i, j, m;
+
+    if (n == 0) return 0;
+    if (k > n) k = n;
+    cnt = (long *)calloc(n + 1, sizeof(long));
+    bytes = (long *)calloc(n + 1, sizeof(long));
+    cost = (double *)calloc(2 * n, sizeof(double));
+    from = (int *)calloc((size_t)k * n, sizeof(int));
+    if (!cnt || !bytes || !cost || !from) {
+        m = -1;
+        goto out;
+    }
+    for (i = 0; i < n; i++) {
+        cnt[i + 1] = cnt[i] + sc[i].count;
+        bytes[i + 1] = bytes[i] + sc[i].bytes;
+    }
+    /* cost of a class of size sc[j] serving sizes i..j */
+#define CLASS_COST(i, j) \
+    ((double)sc[j].size * (cnt[(j) + 1] - cnt[i]) - (bytes[(j) + 1] - bytes[i]))
+
+    prev = cost;
+    cur = cost + n;
+    for (j = 0; j < n; j++) prev[j] = CLASS_COST(0, j);
+    for (c = 1; c < k; c++) {
+        for (j = 0; j < n; j++) {
+            /* the last class ends at j; the one before it at m - 1 */
+            cur[j] = prev[j];
+            from[c * n + j] = -1; /* no more classes than needed */
+            for (m = 1; m <= j; m++) {
+                double x = prev[m - 1] + CLASS_COST(m, j);
+                if (x < cur[j]) {
+                    cur[j] = x;
+                    from[c * n + j] = m;
+                }
+            }
+        }
+        memcpy(prev, cur, n * sizeof(double));
+    }
+#undef CLASS_COST
+
+    /* walk back from the class that ends at the largest size */
+    m = 0;
+    c = k - 1;
+    j = n - 1;
+    for (;;) {
+        if (c > 0 && from[c * n + j] < 0) { /* fewer classes did as well */
+            c--;
+            continue;
+        }
+        classes[m++] = sc[j].size;
+        if (c == 0) break;
+        j = from[c * n + j] - 1;
+        c--;
+    }
+    /* in increasing order */
+    for (i = 0; i < m / 2; i++) {
+        long t = classes[i];
+        classes[i] = classes[m - 1 - i];
+        classes[m - 1 - i] = t;
+    }
+out:
+    free(cnt);
+    free(bytes);
+    free(cost);
+    free(from);
+    return m;
+}
+
+/*
+ * class_waste - bytes wasted by rounding the sizes in sc up to the given
+ *     classes; sizes above the last class count as that class
+ */
+long class_waste(const size_count_t *sc, int n, const long *classes, int k) {
+    long waste = 0;
+    int i, c = 0;
+
+    for (i = 0; i < n; i++) {
+        while (c < k - 1 && classes[c] < sc[i].size) c++;
+        waste += classes[c] * sc[i].count - sc[i].bytes;
+    }
+    return waste;
+}
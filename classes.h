@@ -0,0 +1,26 @@
+#ifndef CLASSES_H_
+#define CLASSES_H_
+
+/*
+ * Size classes chosen for a workload: given how many requests there are
+ * of each size, the classes that waste the fewest bytes when every
+ * request is rounded up to its class (mmanalyze recommends them, and
+ * mkclasses compiles them into mm.c).
+ */
+
+/* One distinct size, for the size-class search */
+typedef struct {
+    long size;  /* aligned size */
+    long count; /* requests of that size */
+    long bytes; /* their requested bytes */
+} size_count_t;
+
+/* choose at most k classes among the n sizes in sc, which are distinct
+   and sorted, into classes (increasing); return how many, or -1 if out of
+   memory */
+int best_classes(const size_count_t *sc, int n, int k, long *classes);
+
+/* bytes wasted by rounding the sizes in sc up to the k classes */
+long class_waste(const size_count_t *sc, int n, const long *classes, int k);
+
+#endif /* CLASSES_H_ */
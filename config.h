@@ -33,13 +33,13 @@ static const trace_baseline_t trace_baseline_table[] = {
     {"coalescing-bal.rep", 1, 0.90}, {"coalescing2-bal.rep", 1, 0.90},
     {"realloc-bal.rep", 1, 0.45},    {"realloc2-bal.rep", 1, 0.45}};
 /*
- * This constant gives the estimated performance of the libc malloc
- * package using our traces on some reference system, typically the
- * same kind of system the students use. Its purpose is to cap the
- * contribution of throughput to the performance index. Once the
- * students surpass the AVG_LIBC_THRUPUT, they get no further benefit
- * to their score.  This deters students from building extremely fast,
- * but extremely stupid malloc packages.
+ * The throughput of the libc malloc package caps the contribution of
+ * throughput to the performance index. Once the students surpass it,
+ * they get no further benefit to their score.  This deters students
+ * from building extremely fast, but extremely stupid malloc packages.
+ * mdriver measures libc on the same traces and machine in every run;
+ * this estimate, from some reference system, is only used if that
+ * measurement fails.
  */
 #define AVG_LIBC_THRUPUT 600E3 /* 600 Kops/sec */
 
@@ -0,0 +1,119 @@
+/*
+ * fperf.c - Count hardware events during a function f
+ *
+ * The events are opened as one perf_event group, so that they are all on
+ * the PMU at the same time and their ratios are meaningful. If there are
+ * more events than counters, the kernel multiplexes the group; the counts
+ * are then scaled up by time_enabled / time_running.
+ *
+ * Only user-space events of the calling thread are counted, which is what
+ * perf_event_paranoid levels up to 2 allow. An event the CPU (or VM) does
+ * not support is left out of the group; if none can be opened, fperf
+ * fails and the caller carries on without counters.
+ */
+#include "fperf.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+/* type and config of each event, in fperf_counts_t.count order */
+static const struct {
+    unsigned type;
+    unsigned long long config;
+} events[FPERF_NUM_EVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+/* open one event of the calling thread in group group_fd (-1: a leader) */
+static int open_event(int event, int group_fd) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[event].type;
+    attr.config = events[event].config;
+    attr.disabled = (group_fd == -1); /* the leader starts the group */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/*
+ * fperf - Count the events during n runs of f(argp)
+ */
+int fperf(fperf_test_funct f, void *argp, int n, fperf_counts_t *c) {
+    int fds[FPERF_NUM_EVENTS];
+    int slot[FPERF_NUM_EVENTS]; /* position of each event in the read */
+    /* nr, time_enabled, time_running, then one value per event */
+    unsigned long long buf[3 + FPERF_NUM_EVENTS];
+    int leader = -1, nr = 0, err = 0;
+    int e, i;
+    ssize_t len;
+
+    for (e = 0; e < FPERF_NUM_EVENTS; e++) {
+        c->count[e] = -1;
+        slot[e] = -1;
+        fds[e] = open_event(e, leader);
+        if (fds[e] < 0) {
+            if (leader == -1) err = errno; /* the most telling error */
+            continue;
+        }
+        if (leader == -1) leader = fds[e];
+        slot[e] = nr++;
+    }
+    c->running = 0;
+    if (leader == -1) {
+        errno = err;
+        return -1;
+    }
+
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    for (i = 0; i < n; i++) f(argp);
+    ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    len = read(leader, buf, sizeof(buf));
+    for (e = 0; e < FPERF_NUM_EVENTS; e++)
+        if (fds[e] >= 0) close(fds[e]);
+    if (len < (ssize_t)((3 + nr) * sizeof(buf[0])) || buf[0] != (unsigned)nr) {
+        errno = EIO;
+        return -1;
+    }
+
+    /* a group that never got on the PMU (e.g. too many events for the
+       counters) counted nothing, rather than zero events */
+    if (buf[2] == 0) return 0;
+    c->running = (double)buf[2] / buf[1];
+    for (e = 0; e < FPERF_NUM_EVENTS; e++)
+        if (slot[e] >= 0) c->count[e] = buf[3 + slot[e]] / c->running / n;
+    return nr;
+}
+
+#else /* !__linux__ */
+
+int fperf(fperf_test_funct f, void *argp, int n, fperf_counts_t *c) {
+    int e;
+
+    (void)f;
+    (void)argp;
+    (void)n;
+    for (e = 0; e < FPERF_NUM_EVENTS; e++) c->count[e] = -1;
+    c->running = 0;
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
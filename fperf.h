@@ -0,0 +1,29 @@
+/*
+ * Hardware performance counters
+ */
+#ifndef FPERF_H_
+#define FPERF_H_
+
+typedef void (*fperf_test_funct)(void *);
+
+/* The events counted, as indices into fperf_counts_t.count */
+enum {
+    FPERF_CYCLES,
+    FPERF_INSTRUCTIONS,
+    FPERF_CACHE_MISSES, /* last-level cache */
+    FPERF_DTLB_MISSES,  /* data TLB load misses */
+    FPERF_BRANCH_MISSES,
+    FPERF_NUM_EVENTS
+};
+
+typedef struct {
+    double count[FPERF_NUM_EVENTS]; /* per run, or -1 if not counted */
+    double running; /* fraction of the time the group was on the PMU */
+} fperf_counts_t;
+
+/* Count the events during n runs of f(argp) with perf_event_open and
+   store the averages in *c. Return the number of events counted, or -1
+   (with errno set) if no counter could be opened. */
+int fperf(fperf_test_funct f, void *argp, int n, fperf_counts_t *c);
+
+#endif /* FPERF_H_ */
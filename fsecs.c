@@ -2,16 +2,25 @@
  * High-level timing wrappers
  ****************************/
 #include "fsecs.h"
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
 #include "clock.h"
 #include "config.h"
 #include "fcyc.h"
+#include "fperf.h"
 #include "ftimer.h"
 
 static double Mhz; /* estimated CPU clock frequency */
 
 extern int verbose; /* -v option in mdriver.c */
 
+/* runs of f averaged by fsecs_counters */
+#define COUNTER_RUNS 3
+
+/* used to probe the counters */
+static void noop(void *argp) { (void)argp; }
+
 /*
  * init_fsecs - initialize the timing package
  */
@@ -48,3 +57,34 @@ double fsecs(fsecs_test_funct f, void *argp) {
     return ftimer_gettod(f, argp, 10);
 #endif
 }
+
+/*
+ * init_fsecs_counters - check that hardware counters can be read; if they
+ * cannot, say why and return 0
+ */
+int init_fsecs_counters(void) {
+    fperf_counts_t c;
+
+    if (fperf(noop, NULL, 1, &c) > 0) return 1;
+    if (errno == EACCES || errno == EPERM)
+        fprintf(stderr,
+                "Hardware counters are not permitted (%s); lower "
+                "/proc/sys/kernel/perf_event_paranoid to use them.\n",
+                strerror(errno));
+    else if (errno == ENOENT || errno == EOPNOTSUPP)
+        fprintf(stderr,
+                "Hardware counters are not supported on this CPU or VM.\n");
+    else
+        fprintf(stderr, "Hardware counters are unavailable (%s).\n",
+                errno ? strerror(errno) : "no event could be scheduled");
+    return 0;
+}
+
+/*
+ * fsecs_counters - Count hardware events per run of a function f. Return
+ * the number of events counted, 0 if none could be.
+ */
+int fsecs_counters(fsecs_test_funct f, void *argp, fperf_counts_t *c) {
+    int nr = fperf(f, argp, COUNTER_RUNS, c);
+    return nr < 0 ? 0 : nr;
+}
@@ -1,4 +1,10 @@
+#include "fperf.h"
+
 typedef void (*fsecs_test_funct)(void *);
 
 void init_fsecs(void);
 double fsecs(fsecs_test_funct f, void *argp);
+
+/* Hardware event counts per run of f (-C); see fperf.h */
+int init_fsecs_counters(void);
+int fsecs_counters(fsecs_test_funct f, void *argp, fperf_counts_t *c);
@@ -0,0 +1,511 @@
+/*
+ * gentrace - generate a synthetic allocator trace from a spec file
+ *
+ * Usage: gentrace [-hbv] [-s <seed>] <spec> <output>
+ *
+ * The output is binary if its name ends in ".bin" (or -b is given), and
+ * text otherwise. A spec is a list of "key value..." lines; "#" starts a
+ * comment. Time is counted in allocations: a block with lifetime L is
+ * freed just before the L-th allocation after its own.
+ *
+ *   seed <n>                 random seed (default 1)
+ *   peak <bytes>             cap on live payload bytes; when an allocation
+ *                            would exceed it, the blocks due soonest are
+ *                            freed early (default 8MB)
+ *   maxsize <bytes>          cap on any request size (default 1MB)
+ *
+ *   phase [<name>]           start a new phase; it inherits the settings
+ *                            below from the previous phase
+ *   allocs <n>               number of allocations in the phase
+ *   size <dist>              request sizes
+ *   lifetime <dist>          block lifetimes, in allocations
+ *   realloc <p> <growth> <steps>
+ *                            with probability p a block is grown <steps>
+ *                            times by a factor of <growth> over its life
+ *   drain                    free every live block at the end of the phase
+ *
+ * where <dist> is one of
+ *
+ *   const <v>
+ *   uniform <lo> <hi>
+ *   lognormal <median> <sigma>
+ *   powerlaw <lo> <hi> <alpha>   (bounded Pareto, density ~ x^-alpha)
+ *   bimodal <a> <b> <p>          (<a> with probability p, else <b>)
+ *   forever                      (lifetime only: freed at the end)
+ *
+ * Every block is freed by the end of the trace, so traces are balanced.
+ * See traces/specs for examples.
+ */
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define MAXLINE 1024
+#define MAX_PHASES 64
+
+int verbose = 0; /* read by trace.c */
+
+/* A distribution from the spec */
+typedef struct {
+    enum {
+        D_CONST,
+        D_UNIFORM,
+        D_LOGNORMAL,
+        D_POWERLAW,
+        D_BIMODAL,
+        D_FOREVER
+    } kind;
+    double a, b, c;
+} dist_t;
+
+/* One phase of the spec */
+typedef struct {
+    char name[64];
+    long allocs;
+    dist_t size;
+    dist_t lifetime;
+    double realloc_p; /* probability that a block is a realloc chain */
+    double growth;    /* ... the factor it grows by at each step */
+    int steps;        /* ... and the number of steps */
+    int drain;
+} phase_t;
+
+/* A pending free or realloc step, ordered by (time, seq) */
+typedef struct {
+    long time;
+    long seq;
+    int id;
+    int gen; /* generation of the id when this was scheduled */
+    int is_free;
+} event_t;
+
+/* the spec */
+static phase_t phases[MAX_PHASES];
+static int num_phases;
+static unsigned long seed = 1;
+static long peak = 8 << 20;
+static long maxsize = 1 << 20;
+
+/* the generator state */
+static unsigned long rng;
+static event_t *heap;
+static long heap_len, heap_cap, heap_seq;
+static int *id_size, *id_gen, *id_steps, *id_every; /* per id */
+static double *id_growth;
+static char *id_live;
+static int id_cap, num_ids;
+static int *free_ids, num_free;
+static long live_bytes, max_live_bytes;
+static trace_t trace;
+static int ops_cap;
+
+/*
+ * gen_error - report an error and exit
+ */
+static void gen_error(char *msg, char *arg) {
+    fprintf(stderr, "gentrace: %s%s\n", msg, arg ? arg : "");
+    exit(1);
+}
+
+static void *xrealloc(void *p, size_t size) {
+    if ((p = realloc(p, size)) == NULL) gen_error("out of memory", NULL);
+    return p;
+}
+
+/*****************************************************************
+ * Random numbers (splitmix64) and the distributions
+ ****************************************************************/
+
+static unsigned long next_random(void) {
+    unsigned long z = (rng += 0x9e3779b97f4a7c15UL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+    return z ^ (z >> 31);
+}
+
+/* uniform on (0, 1) */
+static double uniform01(void) {
+    return ((next_random() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * sample - draw from a distribution; returns LONG_MAX for "forever"
+ */
+static long sample(dist_t *d) {
+    double x = 0, u;
+
+    switch (d->kind) {
+        case D_CONST:
+            x = d->a;
+            break;
+        case D_UNIFORM:
+            x = d->a + floor(uniform01() * (d->b - d->a + 1));
+            break;
+        case D_LOGNORMAL: /* Box-Muller */
+            u = sqrt(-2 * log(uniform01())) * cos(2 * M_PI * uniform01());
+            x = d->a * exp(d->b * u);
+            break;
+        case D_POWERLAW: /* inverse of the bounded Pareto CDF */
+            u = uniform01();
+            if (fabs(d->c - 1) < 1e-9) {
+                x = d->a * pow(d->b / d->a, u);
+            } else {
+                double lo = pow(d->a, 1 - d->c), hi = pow(d->b, 1 - d->c);
+                x = pow(lo + u * (hi - lo), 1 / (1 - d->c));
+            }
+            break;
+        case D_BIMODAL:
+            x = uniform01() < d->c ? d->a : d->b;
+            break;
+        case D_FOREVER:
+            return LONG_MAX;
+    }
+    return x < 1 ? 1 : (x > (double)LONG_MAX / 2 ? LONG_MAX / 2 : (long)x);
+}
+
+/*****************************************************************
+ * Parsing the spec
+ ****************************************************************/
+
+/*
+ * parse_dist - parse "<kind> <params>" from the words of a spec line
+ */
+static void parse_dist(dist_t *d, char **w, int n, int lineno) {
+    static const struct {
+        char *name;
+        int kind, nparams;
+    } kinds[] = {{"const", D_CONST, 1},         {"uniform", D_UNIFORM, 2},
+                 {"lognormal", D_LOGNORMAL, 2}, {"powerlaw", D_POWERLAW, 3},
+                 {"bimodal", D_BIMODAL, 3},     {"forever", D_FOREVER, 0}};
+    char msg[MAXLINE];
+    unsigned i;
+
+    for (i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        if (n < 1 || strcmp(w[0], kinds[i].name)) continue;
+        if (n - 1 != kinds[i].nparams) break;
+        d->kind = kinds[i].kind;
+        d->a = n > 1 ? atof(w[1]) : 0;
+        d->b = n > 2 ? atof(w[2]) : 0;
+        d->c = n > 3 ? atof(w[3]) : 0;
+        if ((d->kind == D_UNIFORM || d->kind == D_POWERLAW) &&
+            !(d->a >= 1 && d->b >= d->a))
+            break;
+        return;
+    }
+    sprintf(msg, "line %d: bad distribution", lineno);
+    gen_error(msg, NULL);
+}
+
+/*
+ * read_spec - parse a spec file into phases[]
+ */
+static void read_spec(char *path) {
+    FILE *f = fopen(path, "r");
+    char line[MAXLINE], msg[MAXLINE];
+    char *w[8], *p;
+    int n, lineno = 0;
+    phase_t *ph;
+
+    if (f == NULL) gen_error("cannot open ", path);
+
+    /* settings before the first "phase" line go to the first phase */
+    ph = &phases[0];
+    memset(ph, 0, sizeof(*ph));
+    strcpy(ph->name, "main");
+    ph->size.kind = D_CONST;
+    ph->size.a = 64;
+    ph->lifetime.kind = D_CONST;
+    ph->lifetime.a = 100;
+    ph->growth = 2;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        if ((p = strchr(line, '#')) != NULL) *p = '\0';
+        for (n = 0, p = strtok(line, " \t\r\n"); p && n < 8;
+             p = strtok(NULL, " \t\r\n"))
+            w[n++] = p;
+        if (n == 0) continue;
+
+        if (!strcmp(w[0], "phase")) {
+            /* the first "phase" line names phase 0 unless it has allocs */
+            if (num_phases > 0 || ph->allocs > 0) {
+                if (++num_phases >= MAX_PHASES)
+                    gen_error("too many phases in ", path);
+                phases[num_phases] = *ph;
+                ph = &phases[num_phases];
+                ph->allocs = 0;
+                ph->drain = 0;
+            } else {
+                num_phases = 0;
+            }
+            snprintf(ph->name, sizeof(ph->name), "%s", n > 1 ? w[1] : "phase");
+            continue;
+        }
+        if (!strcmp(w[0], "seed") && n == 2) {
+            seed = strtoul(w[1], NULL, 0);
+        } else if (!strcmp(w[0], "peak") && n == 2) {
+            peak = atol(w[1]);
+        } else if (!strcmp(w[0], "maxsize") && n == 2) {
+            maxsize = atol(w[1]);
+        } else if (!strcmp(w[0], "allocs") && n == 2) {
+            ph->allocs = atol(w[1]);
+        } else if (!strcmp(w[0], "size")) {
+            parse_dist(&ph->size, w + 1, n - 1, lineno);
+            if (ph->size.kind == D_FOREVER) {
+                sprintf(msg, "line %d: sizes cannot be forever", lineno);
+                gen_error(msg, NULL);
+            }
+        } else if (!strcmp(w[0], "lifetime")) {
+            parse_dist(&ph->lifetime, w + 1, n - 1, lineno);
+        } else if (!strcmp(w[0], "realloc") && n == 4) {
+            ph->realloc_p = atof(w[1]);
+            ph->growth = atof(w[2]);
+            ph->steps = atoi(w[3]);
+        } else if (!strcmp(w[0], "drain") && n == 1) {
+            ph->drain = 1;
+        } else {
+            sprintf(msg, "line %d: unknown setting ", lineno);
+            gen_error(msg, w[0]);
+        }
+    }
+    num_phases++;
+    fclose(f);
+}
+
+/*****************************************************************
+ * Emitting ops, and the event heap
+ ****************************************************************/
+
+static void emit(int type, int id, int size) {
+    if (trace.num_ops == INT_MAX) gen_error("trace too long", NULL);
+    if (trace.num_ops == ops_cap) {
+        ops_cap = ops_cap ? 2 * ops_cap : 65536;
+        trace.ops = xrealloc(trace.ops, ops_cap * sizeof(traceop_t));
+    }
+    trace.ops[trace.num_ops].type = type;
+    trace.ops[trace.num_ops].index = id;
+    trace.ops[trace.num_ops].size = type == FREE ? 0 : size;
+    trace.num_ops++;
+}
+
+static int event_before(event_t *x, event_t *y) {
+    return x->time < y->time || (x->time == y->time && x->seq < y->seq);
+}
+
+static void heap_push(long time, int id, int is_free) {
+    event_t ev = {time, heap_seq++, id, id_gen[id], is_free};
+    long i = heap_len++;
+
+    if (heap_len > heap_cap) {
+        heap_cap = heap_cap ? 2 * heap_cap : 4096;
+        heap = xrealloc(heap, heap_cap * sizeof(event_t));
+    }
+    for (; i > 0 && event_before(&ev, &heap[(i - 1) / 2]); i = (i - 1) / 2)
+        heap[i] = heap[(i - 1) / 2];
+    heap[i] = ev;
+}
+
+static event_t heap_pop(void) {
+    event_t top = heap[0], last = heap[--heap_len];
+    long i = 0, c;
+
+    while ((c = 2 * i + 1) < heap_len) {
+        if (c + 1 < heap_len && event_before(&heap[c + 1], &heap[c])) c++;
+        if (!event_before(&heap[c], &last)) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+/*
+ * new_id - take a free id (reusing freed ones, so ids stay dense)
+ */
+static int new_id(void) {
+    int id;
+
+    if (num_free > 0) return free_ids[--num_free];
+    if (num_ids == id_cap) {
+        id_cap = id_cap ? 2 * id_cap : 4096;
+        id_size = xrealloc(id_size, id_cap * sizeof(int));
+        id_gen = xrealloc(id_gen, id_cap * sizeof(int));
+        id_steps = xrealloc(id_steps, id_cap * sizeof(int));
+        id_every = xrealloc(id_every, id_cap * sizeof(int));
+        id_growth = xrealloc(id_growth, id_cap * sizeof(double));
+        id_live = xrealloc(id_live, id_cap);
+        free_ids = xrealloc(free_ids, id_cap * sizeof(int));
+    }
+    id = num_ids++;
+    id_gen[id] = 0;
+    return id;
+}
+
+static void free_block(int id) {
+    emit(FREE, id, 0);
+    live_bytes -= id_size[id];
+    id_live[id] = 0;
+    id_gen[id]++; /* cancels the id's pending events */
+    free_ids[num_free++] = id;
+}
+
+/*
+ * run_event - carry out a popped event; if force_free, a realloc step
+ *     frees the block instead
+ */
+static void run_event(event_t *ev, int force_free) {
+    int id = ev->id;
+    long size;
+
+    if (!id_live[id] || id_gen[id] != ev->gen) return; /* stale */
+    if (ev->is_free || force_free) {
+        free_block(id);
+        return;
+    }
+
+    /* a realloc step, unless it would break the caps */
+    size = (long)ceil(id_size[id] * id_growth[id]);
+    if (size > maxsize || live_bytes + size - id_size[id] > peak) return;
+    emit(REALLOC, id, size);
+    live_bytes += size - id_size[id];
+    id_size[id] = size;
+    if (--id_steps[id] > 0) heap_push(ev->time + id_every[id], id, 0);
+}
+
+/*
+ * allocate - the allocation at time now, in phase ph
+ */
+static void allocate(phase_t *ph, long now) {
+    long size = sample(&ph->size);
+    long life = sample(&ph->lifetime);
+    event_t ev;
+    int id;
+
+    if (size > maxsize) size = maxsize;
+
+    /* make room under the peak by freeing the blocks due soonest */
+    while (live_bytes + size > peak && heap_len > 0) {
+        ev = heap_pop();
+        run_event(&ev, 1);
+    }
+
+    id = new_id();
+    emit(ALLOC, id, size);
+    id_size[id] = size;
+    id_live[id] = 1;
+    live_bytes += size;
+    if (live_bytes > max_live_bytes) max_live_bytes = live_bytes;
+
+    /* "forever" blocks are freed at the end, or early to honor the peak */
+    heap_push(life == LONG_MAX ? LONG_MAX : now + life, id, 1);
+    if (ph->steps > 0 && uniform01() < ph->realloc_p) {
+        long every = life == LONG_MAX ? 1000 : life / (ph->steps + 1);
+        id_every[id] = every < 1 ? 1 : (every > INT_MAX ? INT_MAX : every);
+        id_steps[id] = ph->steps;
+        id_growth[id] = ph->growth;
+        heap_push(now + id_every[id], id, 0);
+    }
+}
+
+/*
+ * generate - run every phase of the spec into trace
+ */
+static void generate(void) {
+    long now = 0, i;
+    event_t ev;
+    int p;
+
+    rng = seed;
+    for (p = 0; p < num_phases; p++) {
+        phase_t *ph = &phases[p];
+        long start_ops = trace.num_ops;
+
+        for (i = 0; i < ph->allocs; i++, now++) {
+            while (heap_len > 0 && heap[0].time <= now) {
+                ev = heap_pop();
+                run_event(&ev, 0);
+            }
+            allocate(ph, now);
+        }
+        if (ph->drain || p == num_phases - 1) {
+            while (heap_len > 0) {
+                ev = heap_pop();
+                run_event(&ev, 1);
+            }
+        }
+        if (verbose)
+            printf("phase %-16s %10ld allocs %10ld ops %10ld live bytes\n",
+                   ph->name, ph->allocs, trace.num_ops - start_ops, live_bytes);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: gentrace [-hbv] [-s <seed>] <spec> <output>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b         Write the binary format.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-s <seed>  Override the seed in the spec.\n");
+    fprintf(stderr, "\t-v         Print a summary of each phase.\n");
+}
+
+int main(int argc, char **argv) {
+    int binary = -1; /* -1: decide from the output file name */
+    char *outname, *seed_arg = NULL;
+    FILE *out;
+    size_t len;
+    int c, ret;
+
+    while ((c = getopt(argc, argv, "hbs:v")) != EOF) {
+        switch (c) {
+            case 'b':
+                binary = 1;
+                break;
+            case 's':
+                seed_arg = optarg;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+                usage();
+                exit(0);
+            default:
+                usage();
+                exit(1);
+        }
+    }
+    if (argc - optind != 2) {
+        usage();
+        exit(1);
+    }
+    outname = argv[optind + 1];
+    len = strlen(outname);
+    if (binary < 0) binary = len >= 4 && !strcmp(outname + len - 4, ".bin");
+
+    read_spec(argv[optind]);
+    if (seed_arg) seed = strtoul(seed_arg, NULL, 0);
+    generate();
+
+    trace.num_ids = num_ids;
+    trace.sugg_heapsize = max_live_bytes > INT_MAX ? INT_MAX : max_live_bytes;
+    trace.weight = 1;
+    if (verbose)
+        printf("%d ids, %d ops, peak live %ld bytes\n", trace.num_ids,
+               trace.num_ops, max_live_bytes);
+
+    if ((out = fopen(outname, binary ? "wb" : "w")) == NULL) {
+        perror(outname);
+        exit(1);
+    }
+    ret = binary ? write_trace_bin(&trace, out) : write_trace_rep(&trace, out);
+    if (fclose(out) != 0 || ret < 0) {
+        perror(outname);
+        exit(1);
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * hist.c - log-bucketed latency histograms and the timer they are fed by
+ */
+#include "hist.h"
+
+#include <string.h>
+
+/*
+ * hist_reset - empty a histogram
+ */
+void hist_reset(hist_t *h) { memset(h, 0, sizeof(*h)); }
+
+/*
+ * bucket_high - the largest value that falls in bucket b
+ */
+static unsigned long bucket_high(int b) {
+    int e = b / HIST_SUB_BUCKETS;
+    unsigned long m = b % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS;
+
+    if (e == 0) return b;
+    return ((m + 1) << (e - 1)) - 1;
+}
+
+/*
+ * hist_percentile - the value at fraction p of the recorded values
+ */
+unsigned long hist_percentile(const hist_t *h, double p) {
+    unsigned long rank, seen = 0, v;
+    int b;
+
+    if (h->n == 0) return 0;
+    rank = (unsigned long)(p * h->n);
+    if (rank >= h->n) rank = h->n - 1;
+    for (b = 0; b < HIST_NUM_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen > rank) break;
+    }
+    v = bucket_high(b);
+    return v < h->max ? v : h->max;
+}
+
+/*
+ * now_ns - CLOCK_MONOTONIC in nanoseconds
+ */
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * hist_ticks_per_ns - calibrate the timer against CLOCK_MONOTONIC over
+ *     about 20ms
+ */
+double hist_ticks_per_ns(void) {
+    static double rate = 0;
+    double ns0, ns1;
+    unsigned long t0, t1;
+
+    if (rate == 0) {
+        ns0 = now_ns();
+        t0 = hist_ticks();
+        while ((ns1 = now_ns()) - ns0 < 20e6)
+            ;
+        t1 = hist_ticks();
+        rate = (t1 - t0) / (ns1 - ns0);
+    }
+    return rate;
+}
+
+/*
+ * hist_overhead - the cost of the timer itself
+ */
+unsigned long hist_overhead(void) {
+    static unsigned long overhead = (unsigned long)-1;
+    unsigned long t0, t1;
+    int i;
+
+    if (overhead == (unsigned long)-1) {
+        for (i = 0; i < 10000; i++) {
+            t0 = hist_ticks();
+            t1 = hist_ticks();
+            if (t1 - t0 < overhead) overhead = t1 - t0;
+        }
+    }
+    return overhead;
+}
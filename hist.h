@@ -0,0 +1,70 @@
+#ifndef HIST_H_
+#define HIST_H_
+
+/*
+ * Log-bucketed latency histograms. Each power of two is split into
+ * HIST_SUB_BUCKETS linear sub-buckets, so a value is recorded with a
+ * relative error under 1/HIST_SUB_BUCKETS in constant space, and
+ * recording a value is a few instructions.
+ *
+ * Values are in timer ticks, read with hist_ticks(): the TSC (rdtscp) on
+ * x86, or CLOCK_MONOTONIC nanoseconds elsewhere.
+ */
+
+#include <time.h>
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_NUM_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+    unsigned long counts[HIST_NUM_BUCKETS];
+    unsigned long n;   /* number of values recorded */
+    unsigned long max; /* largest value recorded */
+} hist_t;
+
+/* empty a histogram */
+void hist_reset(hist_t *h);
+
+/* return the value below which a fraction p of the recorded values fall
+ * (the upper bound of its bucket, but no more than the maximum) */
+unsigned long hist_percentile(const hist_t *h, double p);
+
+/* timer ticks per nanosecond, measured on the first call */
+double hist_ticks_per_ns(void);
+
+/* the smallest difference between two back-to-back hist_ticks() calls,
+ * which is subtracted from every timed operation */
+unsigned long hist_overhead(void);
+
+/* read the timer */
+static inline unsigned long hist_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned lo, hi, aux;
+    /* rdtscp waits for the instructions before it to finish */
+    __asm__ volatile("rdtscp" : "=a"(lo), "=d"(hi), "=c"(aux));
+    return ((unsigned long long)hi << 32) | lo;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#endif
+}
+
+/* return the bucket that holds v */
+static inline int hist_bucket(unsigned long v) {
+    int e;
+    if (v < HIST_SUB_BUCKETS) return v;
+    /* v has a leading 1 at bit 63 - clz; keep HIST_SUB_BITS bits below it */
+    e = 63 - __builtin_clzl(v) - HIST_SUB_BITS + 1;
+    return e * HIST_SUB_BUCKETS + (int)(v >> (e - 1)) - HIST_SUB_BUCKETS;
+}
+
+/* record one value */
+static inline void hist_record(hist_t *h, unsigned long v) {
+    h->counts[hist_bucket(v)]++;
+    h->n++;
+    if (v > h->max) h->max = v;
+}
+
+#endif /* HIST_H_ */
@@ -0,0 +1,54 @@
+/*
+ * locality.c - simulated LRU caches (see locality.h)
+ */
+#include "locality.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * lru_init - set up an empty cache of sets x ways lines of 2^shift bytes
+ */
+int lru_init(lru_t *c, int sets, int ways, int shift) {
+    c->sets = sets;
+    c->ways = ways;
+    c->shift = shift;
+    c->tags = (unsigned long *)calloc((size_t)sets * ways, sizeof(*c->tags));
+    c->accesses = c->misses = 0;
+    return c->tags == NULL ? -1 : 0;
+}
+
+/*
+ * lru_reset - empty the cache and zero its counts
+ */
+void lru_reset(lru_t *c) {
+    memset(c->tags, 0, (size_t)c->sets * c->ways * sizeof(*c->tags));
+    c->accesses = c->misses = 0;
+}
+
+void lru_destroy(lru_t *c) {
+    free(c->tags);
+    c->tags = NULL;
+}
+
+/*
+ * lru_access - access the byte at addr: move its line to the front of its
+ *     set, evicting the least recently used line on a miss
+ */
+int lru_access(lru_t *c, unsigned long addr) {
+    unsigned long tag = (addr >> c->shift) + 1; /* never 0, the empty way */
+    unsigned long *set = c->tags + (tag % c->sets) * c->ways;
+    int w, miss = 0;
+
+    c->accesses++;
+    for (w = 0; w < c->ways && set[w] != tag; w++)
+        ;
+    if (w == c->ways) {
+        c->misses++;
+        miss = 1;
+        w = c->ways - 1; /* the LRU way makes room */
+    }
+    memmove(set + 1, set, w * sizeof(*set));
+    set[0] = tag;
+    return miss;
+}
@@ -0,0 +1,36 @@
+#ifndef LOCALITY_H_
+#define LOCALITY_H_
+
+/*
+ * Simulated set-associative LRU caches, for scoring where an allocator
+ * places blocks (mdriver -Y) on machines without hardware counters, and
+ * with the same answer on every machine. A TLB is the same model with
+ * one set and a page for a line.
+ */
+
+#define LOC_LINE_BITS 6   /* 64-byte lines */
+#define LOC_CACHE_SETS 64 /* 64 sets x 8 ways x 64 bytes: a 32 KB L1 */
+#define LOC_CACHE_WAYS 8
+#define LOC_PAGE_BITS 12   /* 4 KB pages */
+#define LOC_TLB_ENTRIES 64 /* fully associative */
+
+typedef struct {
+    int sets, ways;
+    int shift;           /* log2 of the line size */
+    unsigned long *tags; /* sets x ways, most recently used first; 0 is
+                            an empty way */
+    unsigned long accesses, misses;
+} lru_t;
+
+/* set up an empty cache; return -1 if there is no memory for it */
+int lru_init(lru_t *c, int sets, int ways, int shift);
+
+/* empty the cache and zero its counts */
+void lru_reset(lru_t *c);
+
+void lru_destroy(lru_t *c);
+
+/* access the byte at addr; return 1 on a miss */
+int lru_access(lru_t *c, unsigned long addr);
+
+#endif /* LOCALITY_H_ */
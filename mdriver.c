@@ -1,17 +1,31 @@
+#define _GNU_SOURCE /* sched_setaffinity */
 #include <assert.h>
 #include <errno.h>
 #include <float.h>
+#include <math.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "backend.h"
+#include "bench.h"
+#include "bound.h"
 #include "config.h"
 #include "fsecs.h"
+#include "hist.h"
+#include "locality.h"
 #include "memlib.h"
 #include "mm.h"
+#include "mmguard.h"
 #include "mminline.h"
+#include "mmprof.h"
+#include "mtbench.h"
+#include "range.h"
+#include "trace.h"
 
 /**********************
  * Constants and macros
@@ -32,31 +46,48 @@
  * The key compound data types
  *****************************/
 
-/* Records the extent of each block's payload */
-typedef struct range_t {
-    char *lo;             /* low payload address */
-    char *hi;             /* high payload address */
-    struct range_t *next; /* next list element */
-} range_t;
-
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum { ALLOC, FREE, REALLOC } type; /* type of request */
-    int index;                          /* index for free() to use later */
-    int size;                           /* byte size of alloc/realloc request */
-} traceop_t;
-
-/* Holds the information for one trace file*/
-typedef struct {
-    char trace_name[1024];
-    int sugg_heapsize;   /* suggested heap size (unused) */
-    int num_ids;         /* number of alloc/realloc ids */
-    int num_ops;         /* number of distinct requests */
-    int weight;          /* weight for this trace (unused) */
-    traceop_t *ops;      /* array of requests */
-    char **blocks;       /* array of ptrs returned by malloc/realloc... */
-    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
-} trace_t;
+/* An -O sweep stops after OPENLOOP_STEPS offered loads, or as soon as the
+ * allocator serves less than OPENLOOP_SATURATED of the offered load */
+#define OPENLOOP_STEPS 12
+#define OPENLOOP_SATURATED 0.95
+
+#define TOUCH_LINE_BYTES 64 /* what -x line writes of each payload */
+
+/* The synthetic access stream of -Y: after each request, LOC_ACCESSES
+ * reads of a live block, the first LOC_BLOCK_LINES lines of it. The block
+ * is one of the last LOC_RECENT allocated, LOC_RECENCY allocations old on
+ * average (with exponentially distributed ages). */
+#define LOC_ACCESSES 4
+#define LOC_BLOCK_LINES 4
+#define LOC_RECENT 1024
+#define LOC_RECENCY 32.0
+
+/* -Y runs a backend with policy knobs once under each placement below, so
+ * that the placements are compared on one allocator. The size classes are
+ * the policy's own, or if it has none powers of two from LOC_CLASS_MIN. */
+static const struct {
+    const char *name;
+    size_t placement; /* of free blocks in the free list (mm.h) */
+    int classes;      /* round requests up to size classes */
+} loc_placements[] = {
+    {"lifo", MM_PLACE_LIFO, 0},
+    {"addr", MM_PLACE_ADDRESS, 0},
+    {"classes", MM_PLACE_LIFO, 1},
+};
+#define LOC_PLACEMENTS (int)(sizeof(loc_placements) / sizeof(loc_placements[0]))
+#define LOC_COLUMNS (MAX_BACKENDS * LOC_PLACEMENTS)
+#define LOC_CLASS_MIN 32
+
+#define AGING_KEEP 16 /* 1 in AGING_KEEP blocks outlives its trace (-A) */
+#define AGING_PINS 64 /* ... up to AGING_PINS a trace each round */
+#define AGING_HEAP (4 * MAX_HEAP) /* -A's heap: the pins need room */
+#define AGING_ROWS 20       /* rounds printed by -A, at most (and the last) */
+#define AGING_HEADROOM 4096 /* -A stops when a request might not fit */
+
+/* The policy tuner (-X) tries TUNE_TRIALS random policies unless told how
+ * many, with size classes that start at TUNE_CLASS_MIN bytes */
+#define TUNE_TRIALS 32
+#define TUNE_CLASS_MIN 32
 
 /*
  * Holds the params to the xxx_speed functions, which are timed by fcyc.
@@ -66,14 +97,24 @@ typedef struct {
 typedef struct {
     trace_t *trace;
     range_t *ranges;
+    trace_stream_t *stream; /* set instead of trace->ops in streaming mode */
+    idmap_t *ids;           /* ... with the live blocks kept here */
 } speed_t;
 
+/* Latency percentiles of one kind of request, in ns (-L) */
+typedef struct {
+    double ops; /* number of requests timed */
+    double p50, p90, p99, p999, max;
+} latency_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
     /* defined for both libc malloc and student malloc package (mm.c) */
-    double ops;  /* number of ops (malloc/free/realloc) in the trace */
-    int valid;   /* was the trace processed correctly by the allocator? */
-    double secs; /* number of secs needed to run the trace */
+    double ops;       /* number of ops (malloc/free/realloc) in the trace */
+    int valid;        /* was the trace processed correctly by the allocator? */
+    double secs;      /* number of secs needed to run the trace */
+    double load_secs; /* number of secs needed to load the trace */
+    fperf_counts_t perf; /* hardware events per replay (-C) */
 
     char trace_name[1024];
 
@@ -82,6 +123,14 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util; /* space utilization for this trace (always 0 for libc) */
+    struct mm_stats heap; /* allocator statistics after the util replay */
+    latency_t lat[3];     /* per request type (ALLOC, FREE, REALLOC) */
+    bound_t bound;        /* utilization bound of the trace (-U) */
+
+    /* benchmark runner (-n): secs is then the median of the samples */
+    int nsamples;
+    double samples[BENCH_MAX_RUNS]; /* secs of each timed run */
+    double secs_lo, secs_hi;        /* confidence interval of the median */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t;
@@ -99,19 +148,45 @@ static char tracedir[MAXLINE] = TRACEDIR;
 /* The filenames of the default tracefiles */
 static char *default_tracefiles[] = {DEFAULT_TRACEFILES, NULL};
 
+/* The allocator evaluated on each trace (-b), mm.c unless chosen otherwise */
+static const backend_t *backend = NULL;
+
+/* How the mm package is evaluated on each trace */
+static int streaming = 0;        /* If set, stream the traces (set by -S) */
+static char *prof_prefix = NULL; /* If set, dump heap profiles here (-P) */
+static size_t prof_interval = PROF_SAMPLE_BYTES; /* mean bytes/sample (-I) */
+static int latency = 0;  /* If set, time every request (set by -L) */
+static int counters = 0; /* If set, count hardware events (set by -C) */
+static int bounds = 0;   /* If set, compare util with the trace's bound (-U) */
+static int bench_runs = 0;    /* timed runs per trace, or 0 for one (-n) */
+static int bench_warmups = 1; /* untimed runs before them (-w) */
+
+/* How much of each payload the speed replays write, and whether they read
+ * it back before freeing it (-x). TOUCH_FULL is what the scores assume. */
+enum { TOUCH_NONE, TOUCH_LINE, TOUCH_FULL, TOUCH_READLATER, TOUCH_MODES };
+static const char *touch_names[TOUCH_MODES] = {"none", "line", "full",
+                                               "readlater"};
+static int touch_mode = TOUCH_FULL;
+static unsigned long touch_sink; /* keeps the reads of readlater alive */
+
+/* Open-loop replay (-O): requests issued on a schedule, not back to back */
+static double openloop_rate = 0; /* first offered load, in requests/s */
+static int openloop_poisson = 0; /* exponential gaps instead of fixed ones */
+
+/* Utilization timeline written by eval_mm_util (-T and -K) */
+static FILE *timeline = NULL;        /* output file, NULL if disabled */
+static int timeline_json = 0;        /* write JSON instead of CSV */
+static int timeline_every = 100;     /* ops between samples */
+static int timeline_traces = 0;      /* traces written so far */
+static char timeline_trace[MAXLINE]; /* name of the trace being sampled */
+
 /*********************
  * Function prototypes
  *********************/
 
-/* these functions manipulate range lists */
+/* checks a new block and adds it to the range treap (see range.h) */
 static int add_range(range_t **ranges, char *lo, int size, int tracenum,
                      int opnum);
-static void remove_range(range_t **ranges, char *lo);
-static void clear_ranges(range_t **ranges);
-
-/* These functions read, allocate, and free storage for traces */
-static trace_t *read_trace(char *tracedir, char *filename);
-static void free_trace(trace_t *trace);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
@@ -123,12 +198,86 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
 
+/* Time every request of a trace into latency histograms (-L) */
+static void eval_mm_latency(speed_t *params, stats_t *st);
+
+/* Load the traces the backend runs correctly, for -O and -A */
+static int load_valid_traces(char **tracefiles, int num_tracefiles,
+                             trace_t **traces);
+
+/* Replay the traces on a schedule at increasing offered loads (-O) */
+static double eval_mm_openloop(trace_t *trace, double rate, hist_t *h);
+static void eval_openloop(char **tracefiles, int num_tracefiles);
+
+/* Replay the traces back to back on one heap as it ages (-A) */
+static void eval_aging(char **tracefiles, int num_tracefiles, int rounds);
+
+/* Score the placement of every backend in simulated caches (-Y) */
+static void eval_mm_locality(trace_t *trace, lru_t *cache, lru_t *tlb);
+static void loc_policy(const struct mm_policy *base, int k,
+                       struct mm_policy *p);
+static void eval_locality(char **tracefiles, int num_tracefiles);
+
+/* Search the backend's policy knobs for the best perf index (-X) */
+static void tune_random(struct mm_policy *p);
+static double tune_score(trace_t **traces, int n, double libc_thruput,
+                         double *util, double *thruput);
+static void eval_tune(char **tracefiles, int num_tracefiles, char *path,
+                      int trials);
+static void eval_mm_bench(fsecs_test_funct speed, speed_t *params, stats_t *st);
+
+/* Evaluate the mm package on one trace, or on all of them in parallel */
+static void eval_mm_trace(char *filename, int tracenum);
+static void eval_mm_parallel(char **tracefiles, int num_tracefiles, int jobs);
+static int allowed_cpus(int *cpus);
+
+/* Evaluate every backend on every trace and rank them (-e) */
+static void eval_leaderboard(char **tracefiles, int num_tracefiles, int jobs);
+
+/* Measure libc malloc's throughput, the reference for the perf index */
+static double measure_libc_thruput(char **tracefiles, int num_tracefiles);
+
+/* Streaming versions, which never hold the whole trace in memory (-S) */
+static double eval_mm_util_stream(trace_t *info, trace_stream_t *stream,
+                                  idmap_t *ids, int tracenum, range_t **ranges);
+static void eval_mm_speed_stream(void *ptr);
+
 /* Various helper routines */
 static double compute_performance_index(int num_tracefiles, double secs,
-                                        double ops, double util);
+                                        double ops, double util,
+                                        double libc_thruput);
+static double performance_index(double avg_util, double thruput,
+                                double libc_thruput);
 static void printresults(int n, stats_t *stats);
+static void printcounters(int n, stats_t *stats);
 static void printpassed(int n, stats_t *stats);
+static void printheapstats(int n, stats_t *stats);
+static void printlatency(int n, stats_t *stats);
+static void printbounds(int n, stats_t *stats);
+static void printbench(int n, stats_t *stats);
+static void save_baseline(char *path, int n, stats_t *stats);
+static int compare_baseline(char *path, int n, stats_t *stats);
 static void printresultsgradescope(int n, stats_t *stats);
+static void dump_profile(char *prefix, char *trace_name);
+
+/* read and write the policy profiles of -p and -X */
+static void load_policy(char *path, struct mm_policy *p);
+static void save_policy(char *path, const struct mm_policy *p);
+
+/* Loads a trace file, timing how long that takes */
+static trace_t *load_trace(char *filename, double *secs);
+
+/* these functions write the utilization timeline */
+static void timeline_open(char *path);
+static void timeline_begin(char *trace_name);
+static void timeline_sample(int opnum, int live, int max_live);
+static void timeline_close(void);
+
+/* writes the results as JSON or CSV (-o) */
+static void json_string(FILE *f, const char *s);
+static void csv_string(FILE *f, const char *s);
+static void write_results(char *path, int n, stats_t *mm, stats_t *libc,
+                          double perfindex);
 
 static void usage(void);
 static void unix_error(char *msg);
@@ -136,7 +285,7 @@ static void malloc_error(int tracenum, int opnum, char *msg);
 static void app_error(char *msg);
 static void driver();
 
-static stats_t *mm_stats = NULL; /* mm (i.e. student) stats for each trace */
+static stats_t *mm_results = NULL; /* mm (i.e. student) stats per trace */
 
 /**************
  * Main routine
@@ -144,29 +293,123 @@ static stats_t *mm_stats = NULL; /* mm (i.e. student) stats for each trace */
 int main(int argc, char **argv) {
     int i;
     char c;
+    char *end;
     char **tracefiles = NULL;   /* null-terminated array of trace file names */
     int num_tracefiles = 0;     /* the number of traces in that array */
     trace_t *trace = NULL;      /* stores a single trace file in memory */
-    range_t *ranges = NULL;     /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL; /* libc stats for each trace */
     speed_t speed_params;       /* input parameters to the xx_speed routines */
-
-    int run_libc = 0;   /* If set, run libc malloc (set by -l) */
+    int jobs = 1;               /* number of traces evaluated at once (-j) */
+    char *baseline_out = NULL;  /* save the runner's samples here (-B) */
+    char *baseline_in = NULL;   /* ... or compare them with this file (-c) */
+    int regressions = 0;
+    char *results_path = NULL; /* write the results here as well (-o) */
+
+    int run_libc = 0;       /* If set, run libc malloc (set by -l) */
+    int repl = 0;           /* If set, start the malloc REPL (set by -r) */
+    int leaderboard = 0;    /* If set, rank all the backends (set by -e) */
+    int mt_threads = 0;     /* If set, run the multithreaded benchmarks (-M) */
+    int aging_rounds = 0;   /* If set, age one heap this many rounds (-A) */
+    int locality = 0;       /* If set, simulate every backend's locality (-Y) */
+    char *policy_in = NULL; /* load the backend's policy from here (-p) */
+    char *tune_out = NULL;  /* tune the policy and save it here (-X) */
+    int tune_trials = TUNE_TRIALS;
     int autograder = 0; /* If set, emit summary info for autograder (-g) */
     int gradescope = 0;
     /* temporaries used to compute the performance index */
-    double secs, ops, util, perfindex;
+    double secs, ops, util, perfindex = 0, libc_thruput;
     int numcorrect;
 
     /*
      * Read and interpret the command line arguments
      */
 
-    while ((c = getopt(argc, argv, "f:t:hvVgGalr")) != EOF) {
+    while ((c = getopt(
+                argc, argv,
+                "f:t:hvVgGalrs:P:I:T:K:Sj:LCn:w:B:c:o:b:eM:O:A:x:YUp:X:")) !=
+           EOF) {
         switch (c) {
-            case 'r': /* start repl */
-                driver();
-                return 0;
+            case 'P': /* Dump a sampled heap profile per trace */
+                prof_prefix = optarg;
+                break;
+            case 'I': /* Mean number of bytes between profiler samples */
+                prof_interval = strtoul(optarg, &end, 0);
+                if (*optarg == '\0' || *end != '\0' ||
+                    strchr(optarg, '-') != NULL || prof_interval == 0) {
+                    fprintf(stderr,
+                            "mdriver: -I needs a positive byte count\n");
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'T': /* Write a utilization timeline (CSV or .json) */
+                timeline_open(optarg);
+                break;
+            case 'K': /* Ops between timeline samples */
+                if ((timeline_every = atoi(optarg)) <= 0) {
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'j': /* Evaluate this many traces at once */
+                if ((jobs = atoi(optarg)) <= 0) {
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'n': /* Benchmark: time each trace this many times */
+                bench_runs = atoi(optarg);
+                if (bench_runs <= 0 || bench_runs > BENCH_MAX_RUNS) {
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'w': /* Untimed runs before those */
+                if ((bench_warmups = atoi(optarg)) < 0) {
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'B': /* Save the benchmark as a baseline */
+                baseline_out = optarg;
+                break;
+            case 'c': /* Compare the benchmark with a baseline */
+                baseline_in = optarg;
+                break;
+            case 'o': /* Write the results as JSON or CSV */
+                results_path = optarg;
+                break;
+            case 'x': /* How the speed replays touch each payload */
+                for (touch_mode = 0; touch_mode < TOUCH_MODES; touch_mode++)
+                    if (!strcmp(optarg, touch_names[touch_mode])) break;
+                if (touch_mode == TOUCH_MODES) {
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'L': /* Time every request */
+                latency = 1;
+                break;
+            case 'C': /* Count hardware events; they print with -v */
+                counters = 1;
+                if (verbose == 0) {
+                    verbose = 1;
+                }
+                break;
+            case 'S': /* Stream the traces instead of loading them */
+                streaming = 1;
+                break;
+            case 's': /* Serve 1 in N mm_malloc calls from guard pages */
+                i = (int)strtol(optarg, &end, 0);
+                if (*optarg == '\0' || *end != '\0' || i < 0) {
+                    usage();
+                    exit(1);
+                }
+                mm_guard_set_sample_rate(i);
+                break;
+            case 'r': /* start repl, once the backend is known */
+                repl = 1;
+                break;
             case 'G':
                 gradescope = 1;
                 break;
@@ -190,6 +433,59 @@ int main(int argc, char **argv) {
                 if (tracedir[strlen(tracedir) - 1] != '/')
                     strcat(tracedir, "/"); /* path always ends with "/" */
                 break;
+            case 'b': /* Evaluate this backend instead of mm.c */
+                if ((backend = backend_find(optarg)) == NULL) {
+                    fprintf(stderr, "mdriver: no backend named %s\n", optarg);
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'e': /* Rank every backend on every trace */
+                leaderboard = 1;
+                break;
+            case 'O': /* Replay open-loop from this rate (requests/s) */
+                openloop_rate = strtod(optarg, &end);
+                if (!strcmp(end, ":poisson"))
+                    openloop_poisson = 1;
+                else if (*end != '\0')
+                    openloop_rate = 0;
+                if (openloop_rate <= 0) {
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'Y': /* Score every backend's placement in a cache model */
+                locality = 1;
+                break;
+            case 'U': /* Compare the utilization with what the trace allows */
+                bounds = 1;
+                break;
+            case 'p': /* Load the backend's policy knobs from a profile */
+                policy_in = optarg;
+                break;
+            case 'X': /* Tune the policy knobs and save the best profile */
+                tune_out = optarg;
+                if ((end = strchr(optarg, ':')) != NULL) {
+                    *end = '\0';
+                    if ((tune_trials = atoi(end + 1)) <= 0) {
+                        usage();
+                        exit(1);
+                    }
+                }
+                break;
+            case 'A': /* Replay the traces this many rounds on one heap */
+                if ((aging_rounds = atoi(optarg)) <= 0) {
+                    usage();
+                    exit(1);
+                }
+                break;
+            case 'M': /* Run the multithreaded benchmarks on 1..N threads */
+                mt_threads = atoi(optarg);
+                if (mt_threads < 1) {
+                    fprintf(stderr, "mdriver: -M needs at least 1 thread\n");
+                    exit(1);
+                }
+                break;
             case 'l': /* Run libc malloc */
                 run_libc = 1;
                 break;
@@ -208,6 +504,42 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (backend == NULL) backend = backend_find("mm");
+
+    /* Set the policy before anything runs the backend */
+    if ((policy_in || tune_out) && backend->set_policy == NULL) {
+        fprintf(stderr, "mdriver: the %s backend has no policy knobs\n",
+                backend->name);
+        exit(1);
+    }
+    if (policy_in) {
+        struct mm_policy policy;
+        backend->get_policy(&policy);
+        load_policy(policy_in, &policy);
+        if (backend->set_policy(&policy) < 0) {
+            fprintf(stderr, "mdriver: %s is not a valid policy\n", policy_in);
+            exit(1);
+        }
+    }
+
+    /* The REPL prints mm.c's heap, so it only drives mm */
+    if (repl) {
+        if (strcmp(backend->name, "mm")) {
+            fprintf(stderr, "mdriver: -r only drives the mm backend, not %s\n",
+                    backend->name);
+            exit(1);
+        }
+        driver();
+        return 0;
+    }
+
+    /* The multithreaded benchmarks replace the traces */
+    if (mt_threads) {
+        mem_init();
+        mtbench_run(backend, mt_threads);
+        exit(0);
+    }
+
     /*
      * If no -f command line arg, then use the entire set of tracefiles
      * defined in default_traces[]
@@ -220,8 +552,64 @@ int main(int argc, char **argv) {
         }
     }
 
+    /* The timeline is a single file written in trace order */
+    if (jobs > 1 && timeline) {
+        fprintf(stderr, "mdriver: -T cannot be combined with -j\n");
+        exit(1);
+    }
+
+    /* Workers sharing a CPU would time each other, not the allocator */
+    if (jobs > 1) {
+        int cpus[CPU_SETSIZE], ncpus = allowed_cpus(cpus);
+        if (ncpus > 0 && jobs > ncpus) {
+            fprintf(stderr,
+                    "mdriver: warning: -j %d, but only %d CPU%s to pin "
+                    "workers to; running %d at a time\n",
+                    jobs, ncpus, ncpus == 1 ? "" : "s", ncpus);
+            jobs = ncpus;
+        }
+    }
+
+    /* The open-loop schedule is drawn up front for a whole trace, and
+     * aging, the locality model, the bound and the tuner replay loaded
+     * traces */
+    if ((openloop_rate > 0 || aging_rounds || locality || bounds || tune_out) &&
+        streaming) {
+        fprintf(stderr,
+                "mdriver: -O, -A, -Y, -U and -X cannot be combined with -S\n");
+        exit(1);
+    }
+
+    /* Saving or comparing a baseline needs the runner */
+    if ((baseline_out || baseline_in) && bench_runs == 0)
+        bench_runs = BENCH_DEFAULT_RUNS;
+
     /* Initialize the timing package */
     init_fsecs();
+    if (verbose && touch_mode != TOUCH_FULL)
+        printf("Speed replays touch payloads: %s\n", touch_names[touch_mode]);
+    if (counters) counters = init_fsecs_counters();
+
+    if (leaderboard) {
+        eval_leaderboard(tracefiles, num_tracefiles, jobs);
+        exit(errors ? 1 : 0);
+    }
+    if (openloop_rate > 0) {
+        eval_openloop(tracefiles, num_tracefiles);
+        exit(errors ? 1 : 0);
+    }
+    if (aging_rounds) {
+        eval_aging(tracefiles, num_tracefiles, aging_rounds);
+        exit(errors ? 1 : 0);
+    }
+    if (locality) {
+        eval_locality(tracefiles, num_tracefiles);
+        exit(errors ? 1 : 0);
+    }
+    if (tune_out) {
+        eval_tune(tracefiles, num_tracefiles, tune_out, tune_trials);
+        exit(0);
+    }
 
     /*
      * Optionally run and evaluate the libc malloc package
@@ -235,7 +623,8 @@ int main(int argc, char **argv) {
 
         /* Evaluate the libc malloc package using the K-best scheme */
         for (i = 0; i < num_tracefiles; i++) {
-            trace = read_trace(tracedir, tracefiles[i]);
+            trace = load_trace(tracefiles[i], &libc_stats[i].load_secs);
+            strncpy(libc_stats[i].trace_name, trace->trace_name, MAXLINE);
             libc_stats[i].ops = trace->num_ops;
             if (verbose > 1) printf("Checking libc malloc for correctness, ");
             libc_stats[i].valid = eval_libc_valid(trace, i);
@@ -243,6 +632,9 @@ int main(int argc, char **argv) {
                 speed_params.trace = trace;
                 if (verbose > 1) printf("and performance.\n");
                 libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+                if (counters)
+                    fsecs_counters(eval_libc_speed, &speed_params,
+                                   &libc_stats[i].perf);
             }
             free_trace(trace);
         }
@@ -257,45 +649,55 @@ int main(int argc, char **argv) {
     /*
      * Always run and evaluate the student's mm package
      */
-    if (verbose > 1) printf("\nTesting mm malloc\n");
+    if (verbose > 1) printf("\nTesting %s malloc\n", backend->name);
 
     /* Allocate the mm stats array, with one stats_t struct per tracefile */
-    mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
-    if (mm_stats == NULL) unix_error("mm_stats calloc in main failed");
-
-    /* Initialize the simulated memory system in memlib.c */
-    mem_init();
+    mm_results = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+    if (mm_results == NULL) unix_error("mm_results calloc in main failed");
 
-    /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i = 0; i < num_tracefiles; i++) {
-        trace = read_trace(tracedir, tracefiles[i]);
-        strncpy(mm_stats[i].trace_name, trace->trace_name, MAXLINE);
-        mm_stats[i].ops = trace->num_ops;
-        if (verbose > 1) printf("Checking mm_malloc for correctness, ");
-        mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-        if (mm_stats[i].valid) {
-            if (verbose > 1) printf("efficiency, ");
-            mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-            speed_params.trace = trace;
-            speed_params.ranges = ranges;
-            if (verbose > 1) printf("and performance.\n");
-            mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-        }
-        free_trace(trace);
+    /* Evaluate student's mm malloc package using the K-best scheme, with
+     * the traces spread over worker processes if -j was given */
+    if (jobs > 1) {
+        eval_mm_parallel(tracefiles, num_tracefiles, jobs);
+    } else {
+        /* Initialize the simulated memory system in memlib.c */
+        mem_init();
+        for (i = 0; i < num_tracefiles; i++) eval_mm_trace(tracefiles[i], i);
     }
 
+    timeline_close();
+
     /* Display the mm results in a compact table */
     if (verbose) {
-        printf("\nResults for mm malloc:\n");
-        printresults(num_tracefiles, mm_stats);
+        printf("\nResults for %s malloc:\n", backend->name);
+        printresults(num_tracefiles, mm_results);
+        printf("\n");
+        printheapstats(num_tracefiles, mm_results);
+        printf("\n");
+    }
+    if (latency) {
+        printlatency(num_tracefiles, mm_results);
+        printf("\n");
+    }
+    if (bounds) {
+        printbounds(num_tracefiles, mm_results);
+        printf("\n");
+    }
+    if (bench_runs) {
+        printbench(num_tracefiles, mm_results);
+        printf("\n");
+    }
+    if (baseline_out) save_baseline(baseline_out, num_tracefiles, mm_results);
+    if (baseline_in) {
+        regressions = compare_baseline(baseline_in, num_tracefiles, mm_results);
         printf("\n");
     }
 
     if (gradescope) {
-        printresultsgradescope(num_tracefiles, mm_stats);
+        printresultsgradescope(num_tracefiles, mm_results);
     }
     if (verbose == 0) {
-        printpassed(num_tracefiles, mm_stats);
+        printpassed(num_tracefiles, mm_results);
     }
 
     /*
@@ -306,17 +708,30 @@ int main(int argc, char **argv) {
     util = 0;
     numcorrect = 0;
     for (i = 0; i < num_tracefiles; i++) {
-        secs += mm_stats[i].secs;
-        ops += mm_stats[i].ops;
-        util += mm_stats[i].util;
-        if (mm_stats[i].valid) numcorrect++;
+        secs += mm_results[i].secs;
+        ops += mm_results[i].ops;
+        util += mm_results[i].util;
+        if (mm_results[i].valid) numcorrect++;
     }
 
     if (!gradescope) {
-        perfindex = compute_performance_index(num_tracefiles, secs, ops, util);
+        /* throughput is scored against libc's, measured on this machine */
+        if (libc_stats) {
+            double libc_secs = 0, libc_ops = 0;
+            for (i = 0; i < num_tracefiles; i++) {
+                if (!libc_stats[i].valid) continue;
+                libc_secs += libc_stats[i].secs;
+                libc_ops += libc_stats[i].ops;
+            }
+            libc_thruput = libc_secs > 0 ? libc_ops / libc_secs : 0;
+        } else {
+            libc_thruput = measure_libc_thruput(tracefiles, num_tracefiles);
+        }
+        perfindex = compute_performance_index(num_tracefiles, secs, ops, util,
+                                              libc_thruput);
 
         // if (verbose == 0) {
-        //     printpassed(num_tracefiles,mm_stats);
+        //     printpassed(num_tracefiles,mm_results);
         // }
         if (errors != 0) { /* There were errors */
             perfindex = 0.0;
@@ -328,20 +743,24 @@ int main(int argc, char **argv) {
             printf("perfidx:%.0f\n", perfindex);
         }
     }
-    exit(0);
+    if (results_path)
+        write_results(results_path, num_tracefiles, mm_results, libc_stats,
+                      perfindex);
+    exit(regressions ? 2 : 0);
 }
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps
- * track of the extent of every allocated block payload. We use the
- * range list to detect any overlapping allocated blocks.
+ * The following routine adds each new block to the range tree
+ * (see range.h), which keeps track of the extent of every allocated
+ * block payload. We use the range tree to detect any overlapping
+ * allocated blocks.
  ****************************************************************/
 
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list.
+ *     we create a range struct for this block and add it to the range tree.
  */
 static int add_range(range_t **ranges, char *lo, int size, int tracenum,
                      int opnum) {
@@ -361,9 +780,11 @@ static int add_range(range_t **ranges, char *lo, int size, int tracenum,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-        (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap (or, if it was
+     * sampled, within the guarded pool) */
+    if (backend->uses_memlib && !(mm_guard_owns(lo) && mm_guard_owns(hi)) &&
+        ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
+         (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi()))) {
         sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)", lo, hi,
                 mem_heap_lo(), mem_heap_hi());
         malloc_error(tracenum, opnum, msg);
@@ -371,164 +792,37 @@ static int add_range(range_t **ranges, char *lo, int size, int tracenum,
     }
 
     /* The payload must not overlap any other payloads */
-    for (p = *ranges; p != NULL; p = p->next) {
-        if ((lo >= p->lo && lo <= p->hi) || (hi >= p->lo && hi <= p->hi)) {
-            sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-                    lo, hi, p->lo, p->hi);
-            malloc_error(tracenum, opnum, msg);
-            return 0;
-        }
+    if ((p = find_range(*ranges, lo, hi)) != NULL) {
+        sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n", lo,
+                hi, p->lo, p->hi);
+        malloc_error(tracenum, opnum, msg);
+        return 0;
     }
 
     /*
      * Everything looks OK, so remember the extent of this block
-     * by creating a range struct and adding it the range list.
+     * by creating a range struct and adding it the range tree.
      */
-    if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
+    if (insert_range(ranges, lo, hi) < 0)
         unix_error("malloc error in add_range");
-    p->next = *ranges;
-    p->lo = lo;
-    p->hi = hi;
-    *ranges = p;
     return 1;
 }
 
 /*
- * remove_range - Free the range record of block whose payload starts at lo
- */
-static void remove_range(range_t **ranges, char *lo) {
-    range_t *p;
-    range_t **prevpp = ranges;
-
-    for (p = *ranges; p != NULL; p = p->next) {
-        if (p->lo == lo) {
-            *prevpp = p->next;
-            free(p);
-            break;
-        }
-        prevpp = &(p->next);
-    }
-}
-
-/*
- * clear_ranges - free all of the range records for a trace
- */
-static void clear_ranges(range_t **ranges) {
-    range_t *p;
-    range_t *pnext;
-
-    for (p = *ranges; p != NULL; p = pnext) {
-        pnext = p->next;
-        free(p);
-    }
-    *ranges = NULL;
-}
-
-void _check(int errcode) {
-    if (errcode < 0) {
-        printf("Error: %s\n", strerror(-errcode));
-    }
-}
-
-/**********************************************
- * The following routines manipulate tracefiles
- *********************************************/
-
-/*
- * read_trace - read a trace file and store it in memory
+ * load_trace - read a trace file from tracedir, and set *secs to the
+ *     wall-clock time spent loading it
  */
-static trace_t *read_trace(char *tracedir, char *filename) {
-    FILE *tracefile;
+static trace_t *load_trace(char *filename, double *secs) {
+    struct timespec start, end;
     trace_t *trace;
-    char type[MAXLINE];
-    char path[MAXLINE];
-    unsigned index, size;
-    unsigned max_index = 0;
-    unsigned op_index;
-
-    if (verbose > 1) printf("Reading tracefile: %s\n", filename);
-
-    /* Allocate the trace record */
-    if ((trace = (trace_t *)malloc(sizeof(trace_t))) == NULL)
-        unix_error("malloc 1 failed in read_trance");
-
-    /* Read the trace file header */
-    strcpy(path, tracedir);
-    strcat(path, filename);
-    strncpy(trace->trace_name, filename, MAXLINE - 1);
-    if ((tracefile = fopen(path, "r")) == NULL) {
-        sprintf(msg, "Could not open %s in read_trace", path);
-        unix_error(msg);
-    }
-    _check(fscanf(tracefile, "%d", &(trace->sugg_heapsize))); /* not used */
-    _check(fscanf(tracefile, "%d", &(trace->num_ids)));
-    _check(fscanf(tracefile, "%d", &(trace->num_ops)));
-    _check(fscanf(tracefile, "%d", &(trace->weight))); /* not used */
-
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops =
-             (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-        unix_error("malloc 2 failed in read_trace");
-
-    /* We'll keep an array of pointers to the allocated blocks here... */
-    if ((trace->blocks = (char **)malloc(trace->num_ids * sizeof(char *))) ==
-        NULL)
-        unix_error("malloc 3 failed in read_trace");
-
-    /* ... along with the corresponding byte sizes of each block */
-    if ((trace->block_sizes =
-             (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-        unix_error("malloc 4 failed in read_trace");
-
-    /* read every request line in the trace file */
-    index = 0;
-    op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-        switch (type[0]) {
-            case 'a':
-                _check(fscanf(tracefile, "%u %u", &index, &size));
-                trace->ops[op_index].type = ALLOC;
-                trace->ops[op_index].index = index;
-                trace->ops[op_index].size = size;
-                max_index = (index > max_index) ? index : max_index;
-                break;
-            case 'r':
-                _check(fscanf(tracefile, "%u %u", &index, &size));
-                trace->ops[op_index].type = REALLOC;
-                trace->ops[op_index].index = index;
-                trace->ops[op_index].size = size;
-                max_index = (index > max_index) ? index : max_index;
-                break;
-            case 'f':
-                _check(fscanf(tracefile, "%ud", &index));
-                trace->ops[op_index].type = FREE;
-                trace->ops[op_index].index = index;
-                break;
-            default:
-                printf("Bogus type character (%c) in tracefile %s\n", type[0],
-                       path);
-                exit(1);
-        }
-        op_index++;
-    }
-    fclose(tracefile);
-    assert((int)max_index == trace->num_ids - 1);
-    assert((int)op_index == trace->num_ops);
 
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    trace = read_trace(tracedir, filename);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
     return trace;
 }
 
-/*
- * free_trace - Free the trace record and the three arrays it points
- *              to, all of which were allocated in read_trace().
- */
-void free_trace(trace_t *trace) {
-    free(trace->ops); /* free the three arrays... */
-    free(trace->blocks);
-    free(trace->block_sizes);
-    free(trace); /* and the trace record itself... */
-}
-
 /**********************************************************************
  * The following functions evaluate the correctness, space utilization,
  * and throughput of the libc and mm malloc packages.
@@ -546,12 +840,12 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) {
     char *oldp;
     char *p;
 
-    /* Reset the heap and free any records in the range list */
+    /* Reset the heap and free any records in the range tree */
     mem_reset_brk();
     clear_ranges(ranges);
 
     /* Call the mm package's init function */
-    if (mm_init() < 0) {
+    if (backend->init() < 0) {
         malloc_error(tracenum, 0, "mm_init failed.");
         return 0;
     }
@@ -565,7 +859,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) {
             case ALLOC: /* mm_malloc */
 
                 /* Call the student's malloc */
-                if ((p = mm_malloc(size)) == NULL && size) {
+                if ((p = backend->malloc(size)) == NULL && size) {
                     malloc_error(tracenum, i, "mm_malloc failed.");
                     return 0;
                 } else if (!size) {
@@ -575,7 +869,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) {
 
                 /*
                  * Test the range of the new block for correctness and add it
-                 * to the range list if OK. The block must be  be aligned
+                 * to the range tree if OK. The block must be  be aligned
                  * properly, and must not overlap any currently allocated block.
                  */
                 if (add_range(ranges, p, size, tracenum, i) == 0) return 0;
@@ -596,7 +890,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) {
 
                 /* Call the student's realloc */
                 oldp = trace->blocks[index];
-                if ((newp = mm_realloc(oldp, size)) == NULL && size) {
+                if ((newp = backend->realloc(oldp, size)) == NULL && size) {
                     malloc_error(tracenum, i, "mm_realloc failed.");
                     return 0;
                 } else if (!size) {
@@ -605,10 +899,10 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) {
                     break;
                 }
 
-                /* Remove the old region from the range list */
+                /* Remove the old region from the range tree */
                 remove_range(ranges, oldp);
 
-                /* Check new block for correctness and add it to range list */
+                /* Check new block for correctness and add it to range tree */
                 if (add_range(ranges, newp, size, tracenum, i) == 0) return 0;
 
                 /* ADDED: cgw
@@ -638,7 +932,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) {
                 /* Remove region from list and call student's free function */
                 p = trace->blocks[index];
                 remove_range(ranges, p);
-                mm_free(p);
+                backend->free(p);
                 break;
 
             default:
@@ -676,8 +970,11 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges) {
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
     clear_ranges(ranges);
-    if (mm_init() < 0) app_error("mm_init failed in eval_mm_util");
+    if (backend->init() < 0) app_error("mm_init failed in eval_mm_util");
+    if (timeline) timeline_begin(trace->trace_name);
     for (i = 0; i < trace->num_ops; i++) {
+        if (timeline && i % timeline_every == 0)
+            timeline_sample(i, total_size, max_total_size);
         index = trace->ops[i].index;
         size = trace->ops[i].size;
 
@@ -686,7 +983,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges) {
                 index = trace->ops[i].index;
                 size = trace->ops[i].size;
 
-                if ((p = mm_malloc(size)) == NULL && size) {
+                if ((p = backend->malloc(size)) == NULL && size) {
                     app_error("mm_malloc failed in eval_mm_util");
                 } else if (!size) {
                     // since we already checked that the return value should be
@@ -718,7 +1015,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges) {
                 oldsize = trace->block_sizes[index];
 
                 oldp = trace->blocks[index];
-                if ((newp = mm_realloc(oldp, newsize)) == NULL && size) {
+                if ((newp = backend->realloc(oldp, newsize)) == NULL && size) {
                     app_error("mm_realloc failed in eval_mm_util");
                 } else if (!size) {
                     // do not proceed further if the size is 0
@@ -752,7 +1049,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges) {
                 p = trace->blocks[index];
                 remove_range(ranges, p);
 
-                mm_free(p);
+                backend->free(p);
 
                 /* Keep track of current total size
                  * of all allocated blocks */
@@ -764,10 +1061,40 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges) {
                 app_error("Nonexistent request type in eval_mm_util");
         }
     }
+    if (timeline) timeline_sample(trace->num_ops, total_size, max_total_size);
 
+    if (!backend->uses_memlib) return 0; /* no heap to measure against */
     return ((double)max_total_size / (double)mem_heapsize());
 }
 
+/*
+ * touch_new - Write a payload the replay just got from malloc or realloc:
+ *     nothing, its first cache line, or all of it, by the touch mode
+ */
+static inline void touch_new(char *p, int index, int size) {
+    if (touch_mode == TOUCH_NONE) return;
+    if (touch_mode == TOUCH_LINE && size > TOUCH_LINE_BYTES)
+        size = TOUCH_LINE_BYTES;
+    memset(p, index & 0xFF, size);
+}
+
+/*
+ * touch_old - Read a payload back before it is freed (-x readlater), so
+ *     that the replay pays for wherever the allocator put it, as a
+ *     program reading its data would
+ */
+static inline void touch_old(const char *p, int size) {
+    unsigned long sum = 0, word;
+    int i;
+
+    if (touch_mode != TOUCH_READLATER) return;
+    for (i = 0; i + (int)sizeof(word) <= size; i += sizeof(word)) {
+        memcpy(&word, p + i, sizeof(word));
+        sum += word;
+    }
+    touch_sink += sum;
+}
+
 /*
  * eval_mm_speed - This is the function that is used by fcyc()
  *    to measure the running time of the mm malloc package.
@@ -779,7 +1106,7 @@ static void eval_mm_speed(void *ptr) {
 
     /* Reset the heap and initialize the mm package */
     mem_reset_brk();
-    if (mm_init() < 0) app_error("mm_init failed in eval_mm_speed");
+    if (backend->init() < 0) app_error("mm_init failed in eval_mm_speed");
 
     /* Interpret each trace request */
     for (i = 0; i < trace->num_ops; i++) {
@@ -789,26 +1116,29 @@ static void eval_mm_speed(void *ptr) {
             case ALLOC: /* mm_malloc */
                 index = trace->ops[i].index;
                 size = trace->ops[i].size;
-                if ((p = mm_malloc(size)) == NULL)
+                if ((p = backend->malloc(size)) == NULL)
                     app_error("mm_malloc error in eval_mm_speed");
-                memset(p, index & 0xFF, size);
+                touch_new(p, index, size);
                 trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
                 break;
 
             case REALLOC: /* mm_realloc */
                 index = trace->ops[i].index;
                 newsize = trace->ops[i].size;
                 oldp = trace->blocks[index];
-                if ((newp = mm_realloc(oldp, newsize)) == NULL)
+                if ((newp = backend->realloc(oldp, newsize)) == NULL)
                     app_error("mm_realloc error in eval_mm_speed");
-                memset(newp, index & 0xFF, size);
+                touch_new(newp, index, newsize);
                 trace->blocks[index] = newp;
+                trace->block_sizes[index] = newsize;
                 break;
 
             case FREE: /* mm_free */
                 index = trace->ops[i].index;
                 block = trace->blocks[index];
-                mm_free(block);
+                touch_old(block, trace->block_sizes[index]);
+                backend->free(block);
                 break;
 
             default:
@@ -818,113 +1148,1848 @@ static void eval_mm_speed(void *ptr) {
 }
 
 /*
- * eval_libc_valid - We run this function to make sure that the
- *    libc malloc can run to completion on the set of traces.
- *    We'll be conservative and terminate if any libc malloc call fails.
- *
+ * eval_mm_util_stream - eval_mm_util for a trace stream. Since the ops are
+ *     only read once per pass, this pass also does the correctness checks
+ *     of eval_mm_valid, reporting failures through malloc_error.
  */
-static int eval_libc_valid(trace_t *trace, int tracenum) {
-    int i, newsize;
-    char *p, *newp, *oldp;
+static double eval_mm_util_stream(trace_t *info, trace_stream_t *stream,
+                                  idmap_t *ids, int tracenum,
+                                  range_t **ranges) {
+    int i, j, n, opnum;
+    int index, size, oldsize;
+    int max_total_size = 0;
+    int total_size = 0;
+    traceop_t *ops;
+    idmap_slot_t *slot;
+    char *p;
 
-    for (i = 0; i < trace->num_ops; i++) {
-        switch (trace->ops[i].type) {
-            case ALLOC: /* malloc */
-                if ((p = malloc(trace->ops[i].size)) == NULL) {
-                    malloc_error(tracenum, i, "libc malloc failed");
-                    unix_error("System message");
-                }
-                trace->blocks[trace->ops[i].index] = p;
-                break;
+    /* initialize the heap and the mm malloc package */
+    mem_reset_brk();
+    clear_ranges(ranges);
+    idmap_clear(ids);
+    if (backend->init() < 0) {
+        malloc_error(tracenum, 0, "mm_init failed.");
+        return 0;
+    }
+    if (timeline) timeline_begin(info->trace_name);
+
+    opnum = 0;
+    while ((n = trace_stream_next(stream, &ops)) > 0) {
+        for (i = 0; i < n; i++, opnum++) {
+            if (timeline && opnum % timeline_every == 0)
+                timeline_sample(opnum, total_size, max_total_size);
+            index = ops[i].index;
+            size = ops[i].size;
+
+            switch (ops[i].type) {
+                case ALLOC: /* mm_malloc */
+                    if ((p = backend->malloc(size)) == NULL && size) {
+                        malloc_error(tracenum, opnum, "mm_malloc failed.");
+                        return 0;
+                    } else if (!size) {
+                        break;
+                    }
+                    if (add_range(ranges, p, size, tracenum, opnum) == 0)
+                        return 0;
+                    memset(p, index & 0xFF, size);
 
-            case REALLOC: /* realloc */
-                newsize = trace->ops[i].size;
-                oldp = trace->blocks[trace->ops[i].index];
-                if ((newp = realloc(oldp, newsize)) == NULL) {
-                    malloc_error(tracenum, i, "libc realloc failed");
-                    unix_error("System message");
-                }
-                trace->blocks[trace->ops[i].index] = newp;
-                break;
+                    /* Remember region and size */
+                    slot = idmap_insert(ids, index);
+                    slot->block = p;
+                    slot->size = size;
+                    total_size += size;
+                    break;
 
-            case FREE: /* free */
-                free(trace->blocks[trace->ops[i].index]);
-                break;
+                case REALLOC: /* mm_realloc */
+                    if ((slot = idmap_find(ids, index)) == NULL) {
+                        malloc_error(tracenum, opnum, "realloc of a free id");
+                        return 0;
+                    }
+                    if ((p = backend->realloc(slot->block, size)) == NULL &&
+                        size) {
+                        malloc_error(tracenum, opnum, "mm_realloc failed.");
+                        return 0;
+                    } else if (!size) {
+                        break;
+                    }
+                    remove_range(ranges, slot->block);
+                    if (add_range(ranges, p, size, tracenum, opnum) == 0)
+                        return 0;
 
-            default:
-                app_error("invalid operation type  in eval_libc_valid");
+                    /* The new block must hold the data from the old one */
+                    oldsize = slot->size;
+                    for (j = 0; j < (size < oldsize ? size : oldsize); j++) {
+                        if (p[j] != (index & 0xFF)) {
+                            malloc_error(tracenum, opnum,
+                                         "mm_realloc did not preserve the "
+                                         "data from old block");
+                            return 0;
+                        }
+                    }
+                    memset(p, index & 0xFF, size);
+
+                    slot->block = p;
+                    slot->size = size;
+                    total_size += size - oldsize;
+                    break;
+
+                case FREE: /* mm_free */
+                    if ((slot = idmap_find(ids, index)) == NULL) break;
+                    remove_range(ranges, slot->block);
+                    backend->free(slot->block);
+                    total_size -= slot->size;
+                    idmap_remove(ids, index);
+                    break;
+
+                default:
+                    app_error("Nonexistent request type in eval_mm_util");
+            }
+            max_total_size =
+                (total_size > max_total_size) ? total_size : max_total_size;
         }
     }
+    if (timeline) timeline_sample(opnum, total_size, max_total_size);
 
-    return 1;
+    if (!backend->uses_memlib) return 0; /* no heap to measure against */
+    return ((double)max_total_size / (double)mem_heapsize());
 }
 
 /*
- * eval_libc_speed - This is the function that is used by fcyc() to
- *    measure the running time of the libc malloc package on the set
- *    of traces.
+ * eval_mm_speed_stream - eval_mm_speed for a trace stream, timed by fcyc()
  */
-static void eval_libc_speed(void *ptr) {
-    int i;
-    int index, size, newsize;
-    char *p, *newp, *oldp, *block;
-    trace_t *trace = ((speed_t *)ptr)->trace;
+static void eval_mm_speed_stream(void *ptr) {
+    int i, n, index, size;
+    traceop_t *ops;
+    idmap_slot_t *slot;
+    char *p;
+    trace_stream_t *stream = ((speed_t *)ptr)->stream;
+    idmap_t *ids = ((speed_t *)ptr)->ids;
 
-    for (i = 0; i < trace->num_ops; i++) {
-        switch (trace->ops[i].type) {
-            case ALLOC: /* malloc */
-                index = trace->ops[i].index;
-                size = trace->ops[i].size;
-                if ((p = malloc(size)) == NULL)
-                    unix_error("malloc failed in eval_libc_speed");
-                trace->blocks[index] = p;
-                break;
+    /* Reset the heap, the id map and the stream */
+    mem_reset_brk();
+    idmap_clear(ids);
+    trace_stream_rewind(stream);
+    if (backend->init() < 0) app_error("mm_init failed in eval_mm_speed");
 
-            case REALLOC: /* realloc */
-                index = trace->ops[i].index;
-                newsize = trace->ops[i].size;
-                oldp = trace->blocks[index];
-                if ((newp = realloc(oldp, newsize)) == NULL)
-                    unix_error("realloc failed in eval_libc_speed\n");
+    /* Interpret each trace request */
+    while ((n = trace_stream_next(stream, &ops)) > 0) {
+        for (i = 0; i < n; i++) {
+            index = ops[i].index;
+            size = ops[i].size;
+            switch (ops[i].type) {
+                case ALLOC: /* mm_malloc */
+                    if ((p = backend->malloc(size)) == NULL)
+                        app_error("mm_malloc error in eval_mm_speed");
+                    touch_new(p, index, size);
+                    slot = idmap_insert(ids, index);
+                    slot->block = p;
+                    slot->size = size;
+                    break;
 
-                trace->blocks[index] = newp;
-                break;
+                case REALLOC: /* mm_realloc */
+                    slot = idmap_find(ids, index);
+                    if ((p = backend->realloc(slot->block, size)) == NULL)
+                        app_error("mm_realloc error in eval_mm_speed");
+                    touch_new(p, index, size);
+                    slot->block = p;
+                    slot->size = size;
+                    break;
 
-            case FREE: /* free */
-                index = trace->ops[i].index;
+                case FREE: /* mm_free */
+                    if ((slot = idmap_find(ids, index)) == NULL) break;
+                    touch_old(slot->block, slot->size);
+                    backend->free(slot->block);
+                    idmap_remove(ids, index);
+                    break;
+
+                default:
+                    app_error("Nonexistent request type in eval_mm_speed");
+            }
+        }
+    }
+}
+
+/*
+ * eval_mm_trace - Run the correctness, utilization and throughput passes
+ *     of the mm package on one trace, filling in mm_results[tracenum]
+ */
+static void eval_mm_trace(char *filename, int tracenum) {
+    static range_t *ranges = NULL; /* block extents for one trace */
+    static idmap_t stream_ids;     /* live blocks of a streamed trace */
+    stats_t *st = &mm_results[tracenum];
+    trace_t stream_info; /* header of a streamed trace */
+    speed_t speed_params;
+    trace_t *trace;
+    unsigned rate;
+    int errs;
+
+    speed_params.ids = &stream_ids;
+    if (streaming) {
+        speed_params.stream =
+            trace_stream_open(tracedir, filename, &stream_info);
+        trace = &stream_info;
+    } else {
+        speed_params.stream = NULL;
+        trace = load_trace(filename, &st->load_secs);
+    }
+    strncpy(st->trace_name, trace->trace_name, MAXLINE);
+    st->ops = trace->num_ops;
+    if (verbose > 1) printf("Checking mm_malloc for correctness, ");
+    /* a stream is checked during the util pass instead */
+    st->valid = streaming || eval_mm_valid(trace, tracenum, &ranges);
+    if (st->valid) {
+        if (verbose > 1) printf("efficiency, ");
+        if (prof_prefix) mm_prof_set_interval(prof_interval);
+        errs = errors;
+        /* sampled blocks live outside the heap, so measure it unsampled */
+        rate = mm_guard_sample_rate();
+        mm_guard_set_sample_rate(0);
+        if (streaming) {
+            st->util = eval_mm_util_stream(trace, speed_params.stream,
+                                           &stream_ids, tracenum, &ranges);
+            /* the util pass read the whole trace, as loading it would */
+            st->load_secs = trace_stream_read_secs(speed_params.stream);
+        } else {
+            st->util = eval_mm_util(trace, tracenum, &ranges);
+        }
+        mm_guard_set_sample_rate(rate);
+        st->valid = (errors == errs);
+        if (backend->stats) backend->stats(&st->heap);
+        if (prof_prefix) {
+            dump_profile(prof_prefix, trace->trace_name);
+            mm_prof_set_interval(0);
+        }
+        speed_params.trace = trace;
+        speed_params.ranges = ranges;
+        if (verbose > 1) printf("and performance.\n");
+        if (st->valid) {
+            fsecs_test_funct speed =
+                streaming ? eval_mm_speed_stream : eval_mm_speed;
+            if (bench_runs)
+                eval_mm_bench(speed, &speed_params, st);
+            else
+                st->secs = fsecs(speed, &speed_params);
+            if (counters) fsecs_counters(speed, &speed_params, &st->perf);
+        }
+        if (st->valid && latency) eval_mm_latency(&speed_params, st);
+        if (st->valid && bounds && trace_bound(trace, &st->bound) < 0)
+            unix_error("trace_bound failed in eval_mm_trace");
+    }
+    if (streaming) {
+        trace_stream_close(speed_params.stream);
+        idmap_destroy(&stream_ids);
+    } else {
+        free_trace(trace);
+    }
+}
+
+/*
+ * eval_mm_bench - Time the trace bench_runs times, after bench_warmups
+ *     untimed runs, and keep the median and its confidence interval
+ */
+static void eval_mm_bench(fsecs_test_funct speed, speed_t *params,
+                          stats_t *st) {
+    int i;
+
+    for (i = 0; i < bench_warmups; i++) speed(params);
+    for (i = 0; i < bench_runs; i++) st->samples[i] = fsecs(speed, params);
+    st->nsamples = bench_runs;
+    st->secs = bench_median(st->samples, bench_runs);
+    bench_median_ci(st->samples, bench_runs, &st->secs_lo, &st->secs_hi);
+}
+
+/*
+ * eval_mm_latency - Replay the trace once more, reading the timer around
+ *     every request, and store the latency percentiles of each kind of
+ *     request in st. This is a separate pass from eval_mm_speed so that
+ *     the timer does not perturb the throughput measurement.
+ */
+static void eval_mm_latency(speed_t *params, stats_t *st) {
+    static hist_t hists[3]; /* per request type */
+    trace_t *trace = params->trace;
+    trace_stream_t *stream = params->stream;
+    unsigned long overhead = hist_overhead();
+    unsigned long t0, t1;
+    double per_ns = hist_ticks_per_ns();
+    idmap_slot_t *slot;
+    traceop_t *ops = trace->ops;
+    char *p, **blockp;
+    int i, n, k, index, size;
+
+    for (k = 0; k < 3; k++) hist_reset(&hists[k]);
+    mem_reset_brk();
+    if (stream) {
+        idmap_clear(params->ids);
+        trace_stream_rewind(stream);
+    }
+    if (backend->init() < 0) app_error("mm_init failed in eval_mm_latency");
+
+    /* a loaded trace is a single chunk */
+    n = trace->num_ops;
+    do {
+        if (stream) n = trace_stream_next(stream, &ops);
+        for (i = 0; i < n; i++) {
+            index = ops[i].index;
+            size = ops[i].size;
+            if (!stream) {
+                blockp = &trace->blocks[index];
+            } else if ((slot = ops[i].type == ALLOC
+                                   ? idmap_insert(params->ids, index)
+                                   : idmap_find(params->ids, index)) != NULL) {
+                blockp = &slot->block;
+            } else {
+                continue;
+            }
+
+            switch (ops[i].type) {
+                case ALLOC: /* mm_malloc */
+                    t0 = hist_ticks();
+                    p = backend->malloc(size);
+                    t1 = hist_ticks();
+                    if (p == NULL)
+                        app_error("mm_malloc error in eval_mm_latency");
+                    memset(p, index & 0xFF, size);
+                    *blockp = p;
+                    break;
+
+                case REALLOC: /* mm_realloc */
+                    t0 = hist_ticks();
+                    p = backend->realloc(*blockp, size);
+                    t1 = hist_ticks();
+                    if (p == NULL)
+                        app_error("mm_realloc error in eval_mm_latency");
+                    memset(p, index & 0xFF, size);
+                    *blockp = p;
+                    break;
+
+                case FREE: /* mm_free */
+                    t0 = hist_ticks();
+                    backend->free(*blockp);
+                    t1 = hist_ticks();
+                    if (stream) idmap_remove(params->ids, index);
+                    break;
+
+                default:
+                    app_error("Nonexistent request type in eval_mm_latency");
+                    return;
+            }
+            t1 -= t0;
+            hist_record(&hists[ops[i].type], t1 > overhead ? t1 - overhead : 0);
+        }
+    } while (stream && n > 0);
+
+    for (k = 0; k < 3; k++) {
+        st->lat[k].ops = hists[k].n;
+        st->lat[k].p50 = hist_percentile(&hists[k], 0.50) / per_ns;
+        st->lat[k].p90 = hist_percentile(&hists[k], 0.90) / per_ns;
+        st->lat[k].p99 = hist_percentile(&hists[k], 0.99) / per_ns;
+        st->lat[k].p999 = hist_percentile(&hists[k], 0.999) / per_ns;
+        st->lat[k].max = hists[k].max / per_ns;
+    }
+}
+
+/*
+ * load_valid_traces - Load the traces that the backend runs correctly into
+ *     traces, and return how many there are
+ */
+static int load_valid_traces(char **tracefiles, int num_tracefiles,
+                             trace_t **traces) {
+    range_t *ranges = NULL;
+    double load_secs;
+    int i, n = 0;
+
+    for (i = 0; i < num_tracefiles; i++) {
+        trace_t *trace = load_trace(tracefiles[i], &load_secs);
+        if (eval_mm_valid(trace, i, &ranges))
+            traces[n++] = trace;
+        else
+            free_trace(trace);
+    }
+    clear_ranges(&ranges);
+    return n;
+}
+
+/*
+ * eval_mm_openloop - Replay the trace at rate requests per second, issuing
+ *     each request at its scheduled time, or as soon as the one before it
+ *     returns if the allocator is running behind. Latency runs from the
+ *     scheduled time rather than the actual issue time, so the time a
+ *     request spends queued behind a slow one is counted (there is no
+ *     coordinated omission). Return the seconds the replay took: until
+ *     the last request returned, but at least the length of the schedule,
+ *     which runs one gap past the last request, so that a replay that
+ *     keeps up is served at the offered rate and not above it.
+ */
+static double eval_mm_openloop(trace_t *trace, double rate, hist_t *h) {
+    static unsigned long *sched = NULL; /* ticks from start to each request */
+    static int sched_ops = 0;
+    double per_ns = hist_ticks_per_ns();
+    double gap = per_ns * 1e9 / rate; /* mean ticks between requests */
+    double t = 0;
+    unsigned long start, due, now, end;
+    int i, index, size;
+    char *p;
+
+    /* the schedule is drawn up front, so that drawing it costs nothing */
+    if (trace->num_ops > sched_ops) {
+        sched_ops = trace->num_ops;
+        sched = (unsigned long *)realloc(sched, sched_ops * sizeof(*sched));
+        if (sched == NULL) unix_error("realloc failed in eval_mm_openloop");
+    }
+    for (i = 0; i < trace->num_ops; i++) {
+        sched[i] = (unsigned long)t;
+        t += openloop_poisson ? -log(1 - drand48()) * gap : gap;
+    }
+    end = (unsigned long)t;
+
+    mem_reset_brk();
+    if (backend->init() < 0) app_error("mm_init failed in eval_mm_openloop");
+
+    start = now = hist_ticks();
+    for (i = 0; i < trace->num_ops; i++) {
+        due = start + sched[i];
+        while (hist_ticks() < due)
+            ; /* spin: sleeping is far too coarse at these rates */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        switch (trace->ops[i].type) {
+            case ALLOC: /* mm_malloc */
+                if ((p = backend->malloc(size)) == NULL)
+                    app_error("mm_malloc error in eval_mm_openloop");
+                touch_new(p, index, size);
+                trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
+                break;
+
+            case REALLOC: /* mm_realloc */
+                p = backend->realloc(trace->blocks[index], size);
+                if (p == NULL)
+                    app_error("mm_realloc error in eval_mm_openloop");
+                touch_new(p, index, size);
+                trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
+                break;
+
+            case FREE: /* mm_free */
+                touch_old(trace->blocks[index], trace->block_sizes[index]);
+                backend->free(trace->blocks[index]);
+                break;
+
+            default:
+                app_error("Nonexistent request type in eval_mm_openloop");
+        }
+        now = hist_ticks();
+        hist_record(h, now - due);
+    }
+    if (now - start < end) now = start + end;
+    return (now - start) / per_ns / 1e9;
+}
+
+/*
+ * eval_openloop - Replay every trace open-loop at offered loads from
+ *     openloop_rate up, doubling each time, and print the latency
+ *     percentiles at each load until the allocator saturates
+ */
+static void eval_openloop(char **tracefiles, int num_tracefiles) {
+    static hist_t h;
+    trace_t **traces;
+    double rate, secs, ops;
+    double per_us = hist_ticks_per_ns() * 1e3;
+    int i, step, ntraces = 0, saturated = 0;
+
+    traces = (trace_t **)calloc(num_tracefiles, sizeof(trace_t *));
+    if (traces == NULL) unix_error("calloc failed in eval_openloop");
+    mem_init();
+    ntraces = load_valid_traces(tracefiles, num_tracefiles, traces);
+
+    srand48(1); /* the same schedules on every run */
+    printf(
+        "Open-loop replay of %s malloc (%s arrivals; latency in us from "
+        "the\nscheduled time, over the %d valid traces):\n",
+        backend->name, openloop_poisson ? "Poisson" : "fixed-rate", ntraces);
+    printf("%12s %12s %9s %9s %9s %9s %9s\n", "offered Kops", "served Kops",
+           "p50", "p90", "p99", "p99.9", "max");
+    printf(
+        "----------------------------------------------------------------------"
+        "----\n");
+    rate = openloop_rate;
+    for (step = 0; ntraces > 0 && step < OPENLOOP_STEPS; step++, rate *= 2) {
+        hist_reset(&h);
+        secs = ops = 0;
+        for (i = 0; i < ntraces; i++) {
+            secs += eval_mm_openloop(traces[i], rate, &h);
+            ops += traces[i]->num_ops;
+        }
+        printf("%12.0f %12.0f %9.2f %9.2f %9.2f %9.2f %9.2f\n", rate / 1e3,
+               ops / secs / 1e3, hist_percentile(&h, 0.50) / per_us,
+               hist_percentile(&h, 0.90) / per_us,
+               hist_percentile(&h, 0.99) / per_us,
+               hist_percentile(&h, 0.999) / per_us, h.max / per_us);
+        if (ops / secs < OPENLOOP_SATURATED * rate) {
+            printf("\nSaturated: %s malloc serves about %.0f Kops at most.\n",
+                   backend->name, ops / secs / 1e3);
+            saturated = 1;
+            break;
+        }
+    }
+    if (ntraces > 0 && !saturated)
+        printf("\nNot saturated at %.0f Kops; start from a higher rate.\n",
+               rate / 2e3);
+
+    for (i = 0; i < ntraces; i++) free_trace(traces[i]);
+    free(traces);
+    mem_deinit();
+}
+
+/* A block whose free is put off to the end of the next aging round */
+typedef struct {
+    char *block;
+    size_t size;
+} survivor_t;
+
+typedef struct {
+    survivor_t *v;
+    int n, cap;
+} survivors_t;
+
+static void survivors_push(survivors_t *s, char *block, size_t size) {
+    if (s->n == s->cap) {
+        s->cap = s->cap ? 2 * s->cap : 1024;
+        s->v = (survivor_t *)realloc(s->v, s->cap * sizeof(survivor_t));
+        if (s->v == NULL) unix_error("realloc failed in survivors_push");
+    }
+    s->v[s->n].block = block;
+    s->v[s->n++].size = size;
+}
+
+/* upper bound of the search-length bucket that holds the fraction p of
+ * the mm_mallocs counted in hist (a delta of mm_stats.search_hist) */
+static size_t search_percentile(const size_t *hist, double p) {
+    size_t total = 0, seen = 0;
+    int b;
+
+    for (b = 0; b < MM_SEARCH_BUCKETS; b++) total += hist[b];
+    for (b = 0; b < MM_SEARCH_BUCKETS - 1; b++) {
+        seen += hist[b];
+        if (seen >= p * total) break;
+    }
+    return b == 0 ? 0 : (size_t)1 << b; /* bucket b holds [2^(b-1), 2^b) */
+}
+
+/*
+ * age_trace - Replay one trace (number tracenum) on the aging heap,
+ *     keeping 1 in AGING_KEEP of the blocks it frees in keep, up to
+ *     AGING_PINS of them, and keeping the live payload and its peak up to
+ *     date. Return the number of ops replayed, which
+ *     is short of the whole trace if the heap ran out.
+ */
+static int age_trace(trace_t *trace, int tracenum, survivors_t *keep,
+                     size_t *live, size_t *peak) {
+    int i, index, pinned = 0;
+    size_t size;
+    char *p;
+
+    for (i = 0; i < trace->num_ops; i++) {
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        /* stop while the request still fits: an allocator need not
+           survive running out of heap (mm_realloc does not) */
+        if (backend->uses_memlib && trace->ops[i].type != FREE &&
+            mem_heapsize() + size + AGING_HEADROOM > AGING_HEAP)
+            return i;
+        switch (trace->ops[i].type) {
+            case ALLOC: /* mm_malloc */
+                if ((p = backend->malloc(size)) == NULL) return i;
+                memset(p, index & 0xFF, size);
+                trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
+                *live += size;
+                break;
+
+            case REALLOC: /* mm_realloc */
+                if ((p = backend->realloc(trace->blocks[index], size)) == NULL)
+                    return i;
+                memset(p, index & 0xFF, size);
+                trace->blocks[index] = p;
+                *live += size - trace->block_sizes[index];
+                trace->block_sizes[index] = size;
+                break;
+
+            case FREE: /* mm_free, unless the block is kept */
+                if ((index * 2654435761u + tracenum) % AGING_KEEP == 0 &&
+                    pinned < AGING_PINS) {
+                    survivors_push(keep, trace->blocks[index],
+                                   trace->block_sizes[index]);
+                    pinned++;
+                    break;
+                }
+                backend->free(trace->blocks[index]);
+                *live -= trace->block_sizes[index];
+                break;
+
+            default:
+                app_error("Nonexistent request type in age_trace");
+        }
+        if (*live > *peak) *peak = *live;
+    }
+    return i;
+}
+
+/*
+ * eval_aging - Replay the valid traces back to back, rounds times, on one
+ *     heap that is never reset, and print how it ages. Real programs are
+ *     not phases that each end with an empty heap, so 1 in AGING_KEEP
+ *     blocks (picked by a hash of the trace and id) is freed at the end
+ *     of the next round instead of by its trace: these long-lived blocks
+ *     pin memory while the traces churn around them. The heap is
+ *     AGING_HEAP, not MAX_HEAP: the random traces alone need most of
+ *     MAX_HEAP. Each trace pins at most AGING_PINS blocks a round, since a
+ *     pin in front of a block that a trace keeps growing (as realloc-bal
+ *     does) makes mm_realloc move it, and so can cost as much heap as the
+ *     block.
+ */
+static void eval_aging(char **tracefiles, int num_tracefiles, int rounds) {
+    survivors_t kept[2] = {{NULL, 0, 0}, {NULL, 0, 0}}; /* last, this round */
+    survivors_t tmp;
+    struct mm_stats before, after;
+    size_t search[MM_SEARCH_BUCKETS];
+    trace_t **traces;
+    trace_t *full = NULL; /* the trace that ran out of heap */
+    double per_ns = hist_ticks_per_ns();
+    double total_ops = 0, secs, ops;
+    size_t live = 0, peak;
+    unsigned long start;
+    unsigned rate;
+    int i, j, r, b, n, ntraces, every;
+
+    traces = (trace_t **)calloc(num_tracefiles, sizeof(trace_t *));
+    if (traces == NULL) unix_error("calloc failed in eval_aging");
+    mem_init_size(AGING_HEAP);
+    ntraces = load_valid_traces(tracefiles, num_tracefiles, traces);
+
+    /* the heap's utilization is the point, so sample nothing out of it */
+    rate = mm_guard_sample_rate();
+    mm_guard_set_sample_rate(0);
+    mem_reset_brk();
+    if (backend->init() < 0) app_error("mm_init failed in eval_aging");
+    memset(&after, 0, sizeof(after));
+    every = rounds > AGING_ROWS ? rounds / AGING_ROWS : 1;
+
+    printf(
+        "Aging %s malloc: %d rounds of the %d valid traces on one %d MB "
+        "heap, with 1 in %d\nblocks (%d a trace at most) kept until the end "
+        "of the next round\n(util is peak payload over heap size):\n",
+        backend->name, rounds, ntraces, AGING_HEAP >> 20, AGING_KEEP,
+        AGING_PINS);
+    printf("%6s %10s %9s %6s %7s %9s %7s %9s\n", "round", "total Mops",
+           "heap KB", "util", "fblks", "largest", "srch90", "Kops");
+    printf(
+        "----------------------------------------------------------------------"
+        "----\n");
+    for (r = 1; ntraces > 0 && r <= rounds; r++) {
+        before = after;
+        peak = live;
+        ops = 0;
+        start = hist_ticks();
+        for (i = 0; i < ntraces; i++) {
+            n = age_trace(traces[i], i, &kept[1], &live, &peak);
+            ops += n;
+            if (n < traces[i]->num_ops) {
+                full = traces[i];
+                break;
+            }
+        }
+        if (!full) {
+            /* the blocks kept from the round before die now */
+            for (j = 0; j < kept[0].n; j++) {
+                backend->free(kept[0].v[j].block);
+                live -= kept[0].v[j].size;
+            }
+            ops += kept[0].n;
+            kept[0].n = 0;
+            tmp = kept[0];
+            kept[0] = kept[1];
+            kept[1] = tmp;
+        }
+        secs = (hist_ticks() - start) / per_ns / 1e9;
+        total_ops += ops;
+        if (backend->stats) backend->stats(&after); /* after every round */
+
+        if (!full && r % every != 0 && r != rounds) continue;
+        printf("%6d %10.2f", r, total_ops / 1e6);
+        if (backend->uses_memlib)
+            printf(" %9zu %5.1f%%", mem_heapsize() / 1024,
+                   100.0 * peak / mem_heapsize());
+        else
+            printf(" %9s %6s", "-", "-");
+        if (backend->stats) {
+            for (b = 0; b < MM_SEARCH_BUCKETS; b++)
+                search[b] = after.search_hist[b] - before.search_hist[b];
+            printf(" %7zu %8zuK %7zu", after.free_blocks,
+                   after.largest_free / 1024, search_percentile(search, 0.9));
+        } else {
+            printf(" %7s %9s %7s", "-", "-", "-");
+        }
+        printf(" %9.0f\n", ops / secs / 1e3);
+        if (full) {
+            printf("\n%s malloc ran out of heap in round %d, on %s.\n",
+                   backend->name, r, full->trace_name);
+            break;
+        }
+    }
+    if (backend->stats)
+        printf(
+            "\nsrch90: 90%% of the round's mm_mallocs visited fewer "
+            "free-list nodes than this.\n");
+
+    free(kept[0].v);
+    free(kept[1].v);
+    for (i = 0; i < ntraces; i++) free_trace(traces[i]);
+    free(traces);
+    mem_deinit();
+    mm_guard_set_sample_rate(rate);
+}
+
+/*
+ * loc_touch - Access the first LOC_BLOCK_LINES lines of a payload in the
+ *     simulated cache and TLB
+ */
+static void loc_touch(lru_t *cache, lru_t *tlb, char *p, size_t size) {
+    unsigned long addr = (unsigned long)p;
+    unsigned long end = addr + size;
+    unsigned long line = 1UL << LOC_LINE_BITS;
+
+    if (size > LOC_BLOCK_LINES * line) end = addr + LOC_BLOCK_LINES * line;
+    for (addr &= ~(line - 1); addr < end; addr += line) {
+        lru_access(cache, addr);
+        lru_access(tlb, addr);
+    }
+}
+
+/*
+ * eval_mm_locality - Replay the trace with a synthetic access stream over
+ *     its live blocks, counting misses in the simulated cache and TLB.
+ *     Every new block is written, and after each request LOC_ACCESSES
+ *     recently allocated blocks are read. The stream depends only on the
+ *     trace, not on the addresses, so every backend sees the same one:
+ *     what differs is only how close together each put the blocks.
+ */
+static void eval_mm_locality(trace_t *trace, lru_t *cache, lru_t *tlb) {
+    static int recent[LOC_RECENT]; /* ring of the last ids allocated */
+    int head = 0;                  /* allocations so far */
+    int i, k, age, index, size;
+    char *p;
+
+    lru_reset(cache);
+    lru_reset(tlb);
+    memset(trace->blocks, 0, trace->num_ids * sizeof(char *));
+    srand48(1);
+    mem_reset_brk();
+    if (backend->init() < 0) app_error("mm_init failed in eval_mm_locality");
+
+    for (i = 0; i < trace->num_ops; i++) {
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        switch (trace->ops[i].type) {
+            case ALLOC: /* mm_malloc */
+                if ((p = backend->malloc(size)) == NULL)
+                    app_error("mm_malloc error in eval_mm_locality");
+                break;
+
+            case REALLOC: /* mm_realloc, which makes the block new again */
+                if ((p = backend->realloc(trace->blocks[index], size)) == NULL)
+                    app_error("mm_realloc error in eval_mm_locality");
+                break;
+
+            case FREE: /* mm_free */
+                backend->free(trace->blocks[index]);
+                trace->blocks[index] = NULL;
+                p = NULL;
+                break;
+
+            default:
+                app_error("Nonexistent request type in eval_mm_locality");
+                return;
+        }
+        if (p != NULL) {
+            loc_touch(cache, tlb, p, size);
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            recent[head++ % LOC_RECENT] = index;
+        }
+
+        /* the program uses its recent blocks (freed ones are skipped) */
+        for (k = 0; k < LOC_ACCESSES; k++) {
+            age = (int)(-log(1 - drand48()) * LOC_RECENCY);
+            if (age >= head || age >= LOC_RECENT) continue;
+            index = recent[(head - 1 - age) % LOC_RECENT];
+            if (trace->blocks[index] != NULL)
+                loc_touch(cache, tlb, trace->blocks[index],
+                          trace->block_sizes[index]);
+        }
+    }
+}
+
+/*
+ * loc_policy - Make p the policy base with placement k of loc_placements
+ */
+static void loc_policy(const struct mm_policy *base, int k,
+                       struct mm_policy *p) {
+    size_t size;
+
+    *p = *base;
+    p->placement = loc_placements[k].placement;
+    if (!loc_placements[k].classes)
+        p->nclasses = 0;
+    else if (p->nclasses == 0)
+        for (size = LOC_CLASS_MIN; size <= MM_MAX_CLASS_SIZE; size *= 2)
+            p->classes[p->nclasses++] = size;
+}
+
+/*
+ * eval_locality - Print the simulated cache and TLB miss rates of every
+ *     backend on every trace it runs correctly (-Y). A backend with policy
+ *     knobs gets a column for each of loc_placements.
+ */
+static void eval_locality(char **tracefiles, int num_tracefiles) {
+    const backend_t *col_backend[LOC_COLUMNS];
+    int col_place[LOC_COLUMNS]; /* in loc_placements, or -1: as it is */
+    char col_name[LOC_COLUMNS][MAXLINE];
+    double *cache_miss[LOC_COLUMNS], *tlb_miss[LOC_COLUMNS];
+    unsigned long accesses[LOC_COLUMNS][2], misses[LOC_COLUMNS][2];
+    struct mm_policy saved[LOC_COLUMNS], p;
+    range_t *ranges = NULL;
+    lru_t cache, tlb;
+    trace_t *trace;
+    char names[num_tracefiles][MAXLINE];
+    double load_secs;
+    int i, b, c, k, nc = 0;
+
+    for (b = 0; b < backend_count(); b++) {
+        backend = backend_get(b);
+        for (k = 0; k < (backend->set_policy ? LOC_PLACEMENTS : 1); k++) {
+            col_backend[nc] = backend;
+            col_place[nc] = backend->set_policy ? k : -1;
+            if (backend->set_policy) {
+                backend->get_policy(&saved[nc]);
+                snprintf(col_name[nc], MAXLINE, "%s/%s", backend->name,
+                         loc_placements[k].name);
+            } else {
+                snprintf(col_name[nc], MAXLINE, "%s", backend->name);
+            }
+            nc++;
+        }
+    }
+    if (lru_init(&cache, LOC_CACHE_SETS, LOC_CACHE_WAYS, LOC_LINE_BITS) < 0 ||
+        lru_init(&tlb, 1, LOC_TLB_ENTRIES, LOC_PAGE_BITS) < 0)
+        unix_error("lru_init failed in eval_locality");
+    for (c = 0; c < nc; c++) {
+        cache_miss[c] = (double *)calloc(num_tracefiles, sizeof(double));
+        tlb_miss[c] = (double *)calloc(num_tracefiles, sizeof(double));
+        if (cache_miss[c] == NULL || tlb_miss[c] == NULL)
+            unix_error("calloc failed in eval_locality");
+        accesses[c][0] = accesses[c][1] = misses[c][0] = misses[c][1] = 0;
+    }
+
+    /* every column on one trace at a time, so each trace is loaded once;
+       a negative miss rate marks a trace the backend got wrong */
+    mem_init();
+    for (i = 0; i < num_tracefiles; i++) {
+        trace = load_trace(tracefiles[i], &load_secs);
+        strcpy(names[i], trace->trace_name);
+        for (c = 0; c < nc; c++) {
+            backend = col_backend[c];
+            if (col_place[c] >= 0) {
+                loc_policy(&saved[c], col_place[c], &p);
+                if (backend->set_policy(&p) < 0)
+                    app_error("bad placement policy in eval_locality");
+            }
+            if (eval_mm_valid(trace, i, &ranges)) {
+                eval_mm_locality(trace, &cache, &tlb);
+                cache_miss[c][i] = 100.0 * cache.misses / cache.accesses;
+                tlb_miss[c][i] = 100.0 * tlb.misses / tlb.accesses;
+                accesses[c][0] += cache.accesses;
+                misses[c][0] += cache.misses;
+                accesses[c][1] += tlb.accesses;
+                misses[c][1] += tlb.misses;
+            } else {
+                cache_miss[c][i] = tlb_miss[c][i] = -1;
+            }
+            if (col_place[c] >= 0) backend->set_policy(&saved[c]);
+        }
+        free_trace(trace);
+    }
+    clear_ranges(&ranges);
+    mem_deinit();
+
+    printf(
+        "\nLocality of each backend (%% misses in a simulated %d KB %d-way "
+        "cache\nand %d-entry TLB, for %d reads of recent blocks per "
+        "request):\n",
+        (LOC_CACHE_SETS * LOC_CACHE_WAYS << LOC_LINE_BITS) / 1024,
+        LOC_CACHE_WAYS, LOC_TLB_ENTRIES, LOC_ACCESSES);
+    printf("%6s %-20s", "trace#", " name");
+    for (c = 0; c < nc; c++) printf(" %15s", col_name[c]);
+    printf("\n%27s", "");
+    for (c = 0; c < nc; c++) printf(" %7s %7s", "cache", "TLB");
+    printf(
+        "\n------------------------------------------------------------------"
+        "----\n");
+    for (i = 0; i < num_tracefiles; i++) {
+        printf(" %-5d %-20s", i, names[i]);
+        for (c = 0; c < nc; c++) {
+            if (cache_miss[c][i] < 0)
+                printf(" %15s", "-");
+            else
+                printf(" %6.2f%% %6.2f%%", cache_miss[c][i], tlb_miss[c][i]);
+        }
+        printf("\n");
+    }
+    printf("%-27s", "Total");
+    for (c = 0; c < nc; c++) {
+        if (accesses[c][0] == 0)
+            printf(" %15s", "-");
+        else
+            printf(" %6.2f%% %6.2f%%", 100.0 * misses[c][0] / accesses[c][0],
+                   100.0 * misses[c][1] / accesses[c][1]);
+        free(cache_miss[c]);
+        free(tlb_miss[c]);
+    }
+    printf(
+        "\n\nA backend with policy knobs runs with each placement: lifo and "
+        "addr put freed\nblocks at the front of the free list or in address "
+        "order, and classes rounds\nrequests up to size classes.\n");
+    lru_destroy(&cache);
+    lru_destroy(&tlb);
+}
+
+/*
+ * tune_random - Draw a policy from the tuner's search space: the split
+ *     threshold and the grow chunk on roughly powers of two, the realloc
+ *     rule, and size classes spaced by a constant ratio up to a top
+ */
+static void tune_random(struct mm_policy *p) {
+    static const size_t splits[] = {1, 2, 4, 8, 16, 32, 64, 128};
+    static const size_t divs[] = {1, 2, 3, 4, 8};
+    static const size_t chunks[] = {0, 512, 1024, 4096, 16384, 65536};
+    static const double ratios[] = {0, 1.125, 1.25, 1.5, 2}; /* 0: none */
+    static const size_t tops[] = {256, 1024, MM_MAX_CLASS_SIZE};
+#define PICK(a) (a[(int)(drand48() * (sizeof(a) / sizeof(a[0])))])
+    double ratio = PICK(ratios);
+    size_t top = PICK(tops), size, next;
+
+    p->split_min = PICK(splits) * MINBLOCKSIZE;
+    p->realloc_split_div = PICK(divs);
+    p->grow_chunk = PICK(chunks);
+    p->nclasses = 0;
+    for (size = TUNE_CLASS_MIN;
+         ratio > 0 && size <= top && p->nclasses < MM_MAX_CLASSES;
+         size = next) {
+        p->classes[p->nclasses++] = size;
+        next = (size_t)ceil(size * ratio / ALIGNMENT) * ALIGNMENT;
+        if (next == size) next += ALIGNMENT;
+    }
+#undef PICK
+}
+
+/*
+ * tune_score - Check, measure and time the backend on the traces with its
+ *     current policy, and return the perf index, or -1 if it failed one
+ */
+static double tune_score(trace_t **traces, int n, double libc_thruput,
+                         double *util, double *thruput) {
+    static range_t *ranges = NULL;
+    speed_t params;
+    double secs = 0, ops = 0;
+    unsigned rate = mm_guard_sample_rate();
+    int i, errs = errors;
+
+    *util = *thruput = 0;
+    params.stream = NULL;
+    params.ids = NULL;
+    for (i = 0; i < n; i++) {
+        if (!eval_mm_valid(traces[i], i, &ranges)) break;
+        mm_guard_set_sample_rate(0); /* as in eval_mm_trace */
+        *util += eval_mm_util(traces[i], i, &ranges);
+        mm_guard_set_sample_rate(rate);
+        params.trace = traces[i];
+        params.ranges = ranges;
+        secs += fsecs(eval_mm_speed, &params);
+        ops += traces[i]->num_ops;
+    }
+    clear_ranges(&ranges);
+    if (errors != errs) {
+        errors = errs; /* a failed policy is only a bad score */
+        return -1;
+    }
+    *util /= n;
+    *thruput = ops / secs;
+    return performance_index(*util, *thruput, libc_thruput);
+}
+
+/*
+ * eval_tune - Random search of the backend's policy knobs for the highest
+ *     perf index on the traces. The first trial is the current policy (the
+ *     default, or the one loaded with -p), so the search only ever keeps a
+ *     policy that did better. The best is saved to path as a profile.
+ */
+static void eval_tune(char **tracefiles, int num_tracefiles, char *path,
+                      int trials) {
+    struct mm_policy best, p;
+    double best_score = -1, score, util, thruput, libc_thruput;
+    trace_t **traces;
+    int i, t, n;
+
+    libc_thruput = measure_libc_thruput(tracefiles, num_tracefiles);
+    if (libc_thruput <= 0) libc_thruput = AVG_LIBC_THRUPUT;
+    traces = (trace_t **)calloc(num_tracefiles, sizeof(trace_t *));
+    if (traces == NULL) unix_error("calloc failed in eval_tune");
+    mem_init();
+    n = load_valid_traces(tracefiles, num_tracefiles, traces);
+    if (n == 0) app_error("no valid traces to tune on");
+
+    backend->get_policy(&best);
+    srand48(1); /* the same policies on every run */
+    printf(
+        "Tuning %s malloc on %d traces (split: least bytes left to split, "
+        "div: realloc\nshrinks in place to 1/div, chunk: least sbrk, "
+        "classes: how many, up to what):\n",
+        backend->name, n);
+    printf("%6s %6s %4s %6s %14s %6s %9s %8s\n", "trial", "split", "div",
+           "chunk", "classes", "util", "Kops", "perfidx");
+    printf(
+        "----------------------------------------------------------------------"
+        "\n");
+    for (t = 0; t <= trials; t++) {
+        if (t == 0)
+            p = best;
+        else
+            tune_random(&p);
+        if (backend->set_policy(&p) < 0) app_error("tuner drew a bad policy");
+        score = tune_score(traces, n, libc_thruput, &util, &thruput);
+        printf("%6d %6zu %4zu %6zu %6d %7zu", t, p.split_min,
+               p.realloc_split_div, p.grow_chunk, p.nclasses,
+               p.nclasses ? p.classes[p.nclasses - 1] : 0);
+        if (score < 0)
+            printf(" %6s %9s %8s\n", "-", "-", "failed");
+        else
+            printf(" %5.1f%% %9.0f %8.1f%s\n", util * 100, thruput / 1e3, score,
+                   score > best_score && t > 0 ? " *" : "");
+        if (score > best_score) {
+            best = p;
+            best_score = score;
+        }
+    }
+    backend->set_policy(&best);
+    save_policy(path, &best);
+    printf("\nSaved the best policy (perf index %.1f, * above) to %s\n",
+           best_score, path);
+
+    for (i = 0; i < n; i++) free_trace(traces[i]);
+    free(traces);
+    mem_deinit();
+}
+
+/*
+ * allowed_cpus - Fill cpus with the CPUs we may run on, in order, and
+ *     return how many there are (0 if they cannot be found out)
+ */
+static int allowed_cpus(int *cpus) {
+    cpu_set_t allowed;
+    int i, n = 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        for (i = 0; i < CPU_SETSIZE; i++)
+            if (CPU_ISSET(i, &allowed)) cpus[n++] = i;
+    return n;
+}
+
+/*
+ * eval_mm_parallel - Evaluate the mm package on every trace, with up to
+ *     jobs worker processes at a time, one per trace. Each worker gets its
+ *     own simulated heap and is pinned to its own CPU (main limits jobs to
+ *     the CPUs there are), and sends back its stats_t over a pipe.
+ */
+static void eval_mm_parallel(char **tracefiles, int num_tracefiles, int jobs) {
+    typedef struct {
+        stats_t stats;
+        int errors;
+    } result_t;
+    typedef struct {
+        pid_t pid; /* 0 if the slot is idle */
+        int fd;    /* read end of the worker's pipe */
+        int tracenum;
+    } worker_t;
+    worker_t *workers;
+    result_t result;
+    cpu_set_t mine;
+    int cpus[CPU_SETSIZE], ncpus = allowed_cpus(cpus);
+    int next = 0, running = 0;
+    int i, w, fds[2], status;
+    ssize_t n;
+    pid_t pid;
+
+    if ((workers = (worker_t *)calloc(jobs, sizeof(worker_t))) == NULL)
+        unix_error("calloc failed in eval_mm_parallel");
+
+    while (next < num_tracefiles || running > 0) {
+        /* start workers while there are traces and idle slots */
+        for (w = 0; w < jobs && next < num_tracefiles; w++) {
+            if (workers[w].pid != 0) continue;
+            if (pipe(fds) < 0) unix_error("pipe failed in eval_mm_parallel");
+            fflush(stdout); /* or the worker prints our buffer again */
+            fflush(stderr);
+            if ((pid = fork()) < 0) unix_error("fork failed");
+            if (pid == 0) { /* worker */
+                close(fds[0]);
+                if (ncpus > 0) {
+                    CPU_ZERO(&mine);
+                    CPU_SET(cpus[w % ncpus], &mine);
+                    sched_setaffinity(0, sizeof(mine), &mine);
+                }
+                mem_init();
+                eval_mm_trace(tracefiles[next], next);
+                result.stats = mm_results[next];
+                result.errors = errors;
+                fflush(stdout);
+                if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+                    _exit(1);
+                _exit(0);
+            }
+            close(fds[1]);
+            workers[w].pid = pid;
+            workers[w].fd = fds[0];
+            workers[w].tracenum = next++;
+            running++;
+        }
+
+        /* collect a worker; its result fits in the pipe buffer, so it has
+         * written all of it before exiting */
+        if ((pid = wait(&status)) < 0) unix_error("wait failed");
+        for (w = 0; w < jobs && workers[w].pid != pid; w++)
+            ;
+        if (w == jobs) continue; /* not one of ours */
+        i = workers[w].tracenum;
+        n = read(workers[w].fd, &result, sizeof(result));
+        if (n == sizeof(result)) {
+            mm_results[i] = result.stats;
+            errors += result.errors;
+        } else {
+            snprintf(mm_results[i].trace_name, MAXLINE, "%s", tracefiles[i]);
+            snprintf(mm_results[i].error_msg, MAXLINE,
+                     "ERROR [trace %d]: worker died (status %#x)\n", i, status);
+            fprintf(stderr, "%s", mm_results[i].error_msg);
+            mm_results[i].valid = 0;
+            errors++;
+        }
+        close(workers[w].fd);
+        workers[w].pid = 0;
+        running--;
+    }
+    free(workers);
+}
+
+/*
+ * measure_libc_thruput - Time libc malloc on the traces, the way the
+ *     throughput of the backend under test is timed, and return its
+ *     throughput in ops/sec (or 0 if it could not be measured)
+ */
+static double measure_libc_thruput(char **tracefiles, int num_tracefiles) {
+    static idmap_t ids; /* live blocks of a streamed trace */
+    const backend_t *tested = backend;
+    trace_t info, *trace;
+    speed_t params;
+    double secs = 0, ops = 0, load_secs;
+    int i;
+
+    if ((backend = backend_find("libc")) == NULL) {
+        backend = tested;
+        return 0;
+    }
+    params.ids = &ids;
+    params.ranges = NULL;
+    for (i = 0; i < num_tracefiles; i++) {
+        if (streaming) {
+            params.stream = trace_stream_open(tracedir, tracefiles[i], &info);
+            trace = &info;
+        } else {
+            params.stream = NULL;
+            trace = load_trace(tracefiles[i], &load_secs);
+        }
+        params.trace = trace;
+        secs +=
+            fsecs(streaming ? eval_mm_speed_stream : eval_mm_speed, &params);
+        ops += trace->num_ops;
+        if (streaming) {
+            trace_stream_close(params.stream);
+            idmap_destroy(&ids);
+        } else {
+            free_trace(trace);
+        }
+    }
+    backend = tested;
+    return secs > 0 ? ops / secs : 0;
+}
+
+/*
+ * eval_leaderboard - Evaluate every registered backend on every trace
+ *     (with -j, each one in parallel) and print their throughput and
+ *     utilization side by side, with a performance index scored against
+ *     the libc backend's throughput as measured in the same run
+ */
+static void eval_leaderboard(char **tracefiles, int num_tracefiles, int jobs) {
+    int nb = backend_count();
+    stats_t *results[MAX_BACKENDS];
+    double secs[MAX_BACKENDS], ops[MAX_BACKENDS], util[MAX_BACKENDS];
+    int valid[MAX_BACKENDS];
+    double libc_thruput = 0;
+    int i, b;
+
+    for (b = 0; b < nb; b++) {
+        backend = backend_get(b);
+        if (verbose > 1) printf("\nTesting %s malloc\n", backend->name);
+        results[b] = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+        if (results[b] == NULL) unix_error("calloc failed in eval_leaderboard");
+        mm_results = results[b];
+        if (jobs > 1) {
+            eval_mm_parallel(tracefiles, num_tracefiles, jobs);
+        } else {
+            mem_init();
+            for (i = 0; i < num_tracefiles; i++)
+                eval_mm_trace(tracefiles[i], i);
+            mem_deinit();
+        }
+
+        secs[b] = ops[b] = util[b] = 0;
+        valid[b] = 0;
+        for (i = 0; i < num_tracefiles; i++) {
+            if (!results[b][i].valid) continue;
+            secs[b] += results[b][i].secs;
+            ops[b] += results[b][i].ops;
+            util[b] += results[b][i].util;
+            valid[b]++;
+        }
+        if (!strcmp(backend->name, "libc") && secs[b] > 0)
+            libc_thruput = ops[b] / secs[b];
+    }
+    if (libc_thruput <= 0) libc_thruput = AVG_LIBC_THRUPUT;
+
+    printf("\nLeaderboard (Kops and utilization of each backend):\n");
+    printf("%6s %-20s", "trace#", " name");
+    for (b = 0; b < nb; b++) printf(" %15s", backend_get(b)->name);
+    printf("\n");
+    printf(
+        "----------------------------------------------------------------------"
+        "\n");
+    for (i = 0; i < num_tracefiles; i++) {
+        printf(" %-5d %-20s", i, results[0][i].trace_name);
+        for (b = 0; b < nb; b++) {
+            stats_t *s = &results[b][i];
+            if (!s->valid)
+                printf(" %15s", "-");
+            else if (!backend_get(b)->uses_memlib)
+                printf(" %8.0f %6s", s->ops / 1e3 / s->secs, "-");
+            else
+                printf(" %8.0f %5.1f%%", s->ops / 1e3 / s->secs, s->util * 100);
+        }
+        printf("\n");
+    }
+
+    /* Totals over the traces each backend ran correctly */
+    printf("%-27s", "Total");
+    for (b = 0; b < nb; b++) {
+        if (valid[b] == 0)
+            printf(" %15s", "-");
+        else if (!backend_get(b)->uses_memlib)
+            printf(" %8.0f %6s", ops[b] / 1e3 / secs[b], "-");
+        else
+            printf(" %8.0f %5.1f%%", ops[b] / 1e3 / secs[b],
+                   util[b] / valid[b] * 100);
+    }
+    printf("\n%-27s", "Perf index");
+    for (b = 0; b < nb; b++) {
+        if (valid[b] < num_tracefiles || !backend_get(b)->uses_memlib)
+            printf(" %15s", "-");
+        else
+            printf(" %15.1f",
+                   performance_index(util[b] / valid[b], ops[b] / secs[b],
+                                     libc_thruput));
+    }
+    printf(
+        "\n\nThe perf index scores throughput against %.0f Kops for libc; "
+        "\"-\" marks\nan invalid trace, or a backend whose utilization "
+        "cannot be measured.\n",
+        libc_thruput / 1e3);
+    for (b = 0; b < nb; b++) free(results[b]);
+    mm_results = NULL;
+}
+
+/*
+ * eval_libc_valid - We run this function to make sure that the
+ *    libc malloc can run to completion on the set of traces.
+ *    We'll be conservative and terminate if any libc malloc call fails.
+ *
+ */
+static int eval_libc_valid(trace_t *trace, int tracenum) {
+    int i, newsize;
+    char *p, *newp, *oldp;
+
+    for (i = 0; i < trace->num_ops; i++) {
+        switch (trace->ops[i].type) {
+            case ALLOC: /* malloc */
+                if ((p = malloc(trace->ops[i].size)) == NULL) {
+                    malloc_error(tracenum, i, "libc malloc failed");
+                    unix_error("System message");
+                }
+                trace->blocks[trace->ops[i].index] = p;
+                break;
+
+            case REALLOC: /* realloc */
+                newsize = trace->ops[i].size;
+                oldp = trace->blocks[trace->ops[i].index];
+                if ((newp = realloc(oldp, newsize)) == NULL) {
+                    malloc_error(tracenum, i, "libc realloc failed");
+                    unix_error("System message");
+                }
+                trace->blocks[trace->ops[i].index] = newp;
+                break;
+
+            case FREE: /* free */
+                free(trace->blocks[trace->ops[i].index]);
+                break;
+
+            default:
+                app_error("invalid operation type  in eval_libc_valid");
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * eval_libc_speed - This is the function that is used by fcyc() to
+ *    measure the running time of the libc malloc package on the set
+ *    of traces.
+ */
+static void eval_libc_speed(void *ptr) {
+    int i;
+    int index, size, newsize;
+    char *p, *newp, *oldp, *block;
+    trace_t *trace = ((speed_t *)ptr)->trace;
+
+    for (i = 0; i < trace->num_ops; i++) {
+        switch (trace->ops[i].type) {
+            case ALLOC: /* malloc */
+                index = trace->ops[i].index;
+                size = trace->ops[i].size;
+                if ((p = malloc(size)) == NULL)
+                    unix_error("malloc failed in eval_libc_speed");
+                touch_new(p, index, size);
+                trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
+                break;
+
+            case REALLOC: /* realloc */
+                index = trace->ops[i].index;
+                newsize = trace->ops[i].size;
+                oldp = trace->blocks[index];
+                if ((newp = realloc(oldp, newsize)) == NULL)
+                    unix_error("realloc failed in eval_libc_speed\n");
+                touch_new(newp, index, newsize);
+                trace->blocks[index] = newp;
+                trace->block_sizes[index] = newsize;
+                break;
+
+            case FREE: /* free */
+                index = trace->ops[i].index;
                 block = trace->blocks[index];
+                touch_old(block, trace->block_sizes[index]);
                 free(block);
                 break;
         }
     }
 }
 
-/*************************************
- * Some miscellaneous helper routines
- ************************************/
+/*************************************
+ * Some miscellaneous helper routines
+ ************************************/
+
+/*
+ * compute_performance_index - computes a score based on the weighted sum of
+ * utilization and throughput
+ */
+static double compute_performance_index(int num_tracefiles, double secs,
+                                        double ops, double util,
+                                        double libc_thruput) {
+    double avg_util = util / num_tracefiles;
+    double avg_throughput = ops / secs;
+
+    double throughput_score;
+    if (libc_thruput <= 0) libc_thruput = AVG_LIBC_THRUPUT;
+    if (avg_throughput > libc_thruput) {
+        throughput_score = 1.0;
+    } else {
+        throughput_score = avg_throughput / libc_thruput;
+    }
+
+    if (verbose)
+        printf("Throughput %.0f Kops against %.0f Kops for libc malloc\n",
+               avg_throughput / 1e3, libc_thruput / 1e3);
+    printf(
+        "Computing performance index from average util %f and throughput score "
+        "%f\n",
+        avg_util * 100, throughput_score * 100);
+    return performance_index(avg_util, avg_throughput, libc_thruput);
+}
+
+/*
+ * performance_index - the weighted sum of the average utilization and of
+ *     the throughput as a fraction of libc's (capped at 1), out of 100
+ */
+static double performance_index(double avg_util, double thruput,
+                                double libc_thruput) {
+    double throughput_score = thruput / libc_thruput;
+
+    if (throughput_score > 1.0) throughput_score = 1.0;
+    return 100 *
+           ((avg_util * UTIL_WEIGHT) + (1.0 - UTIL_WEIGHT) * throughput_score);
+}
+
+/*
+ * dump_profile - write the heap profile collected while replaying a trace
+ *     to <prefix>.<trace_name>.heap
+ */
+static void dump_profile(char *prefix, char *trace_name) {
+    char path[2 * MAXLINE];
+    char *base = strrchr(trace_name, '/');
+    FILE *fh;
+
+    sprintf(path, "%s.%s.heap", prefix, base ? base + 1 : trace_name);
+    if ((fh = fopen(path, "w")) == NULL) {
+        perror("failed opening heap profile");
+        return;
+    }
+    if (mm_prof_dump(fh) < 0) perror("failed writing heap profile");
+    fclose(fh);
+    if (verbose > 1) printf("Wrote heap profile %s\n", path);
+}
+
+/*
+ * timeline_open - start a utilization timeline in path; the format is JSON
+ *     if path ends in ".json" and CSV otherwise
+ */
+static void timeline_open(char *path) {
+    size_t len = strlen(path);
+
+    if ((timeline = fopen(path, "w")) == NULL) {
+        sprintf(msg, "Could not open %s for the timeline", path);
+        unix_error(msg);
+    }
+    timeline_json = len >= 5 && !strcmp(path + len - 5, ".json");
+    if (timeline_json) {
+        fprintf(timeline, "[");
+    } else {
+        fprintf(timeline,
+                "trace,op,live_bytes,heap_bytes,util,free_blocks,"
+                "free_bytes,largest_free,frag_index\n");
+    }
+}
+
+/*
+ * timeline_begin - start the samples of a new trace
+ */
+static void timeline_begin(char *trace_name) {
+    if (timeline_json) {
+        if (timeline_traces > 0) fprintf(timeline, "]},");
+        fprintf(timeline, "\n{\"trace\": ");
+        json_string(timeline, trace_name);
+        fprintf(timeline, ", \"every\": %d, \"samples\": [", timeline_every);
+    }
+    snprintf(timeline_trace, sizeof(timeline_trace), "%s", trace_name);
+    timeline_traces++;
+}
+
+/*
+ * timeline_sample - record the state of the heap after opnum ops, when
+ *     live payload bytes are live (and at most max_live so far). The
+ *     fragmentation index is 1 - largest free block / free bytes: 0 when
+ *     all free space is one block, approaching 1 as it splinters.
+ */
+static void timeline_sample(int opnum, int live, int max_live) {
+    struct mm_stats h;
+    size_t heap = mem_heapsize();
+    double util = heap ? (double)max_live / heap : 0;
+    double frag = 0;
+
+    memset(&h, 0, sizeof(h));
+    if (backend->stats) backend->stats(&h);
+    if (h.free_bytes) frag = 1.0 - (double)h.largest_free / h.free_bytes;
+    if (timeline_json) {
+        fprintf(timeline,
+                "%s\n {\"op\": %d, \"live_bytes\": %d, \"heap_bytes\": %zu, "
+                "\"util\": %.6f, \"free_blocks\": %zu, \"free_bytes\": %zu, "
+                "\"largest_free\": %zu, \"frag_index\": %.6f}",
+                opnum ? "," : "", opnum, live, heap, util, h.free_blocks,
+                h.free_bytes, h.largest_free, frag);
+    } else {
+        csv_string(timeline, timeline_trace);
+        fprintf(timeline, ",%d,%d,%zu,%.6f,%zu,%zu,%zu,%.6f\n", opnum, live,
+                heap, util, h.free_blocks, h.free_bytes, h.largest_free, frag);
+    }
+}
+
+/*
+ * timeline_close - finish and close the timeline file
+ */
+static void timeline_close(void) {
+    if (timeline == NULL) return;
+    if (timeline_json)
+        fprintf(timeline, "%s\n]\n", timeline_traces ? "]}" : "");
+    fclose(timeline);
+    timeline = NULL;
+}
+
+/*****************************************************************
+ * The following routines write the results of a run in a machine-
+ * readable form (-o): a JSON document, or CSV with one row per
+ * allocator and trace and the environment repeated on every row so
+ * that rows from different runs can simply be concatenated.
+ ****************************************************************/
+
+#ifndef MDRIVER_CFLAGS
+#define MDRIVER_CFLAGS "unknown"
+#endif
+#ifndef MDRIVER_COMMIT
+#define MDRIVER_COMMIT "unknown"
+#endif
+
+#if USE_FCYC
+#define TIMER_NAME "fcyc"
+#elif USE_ITIMER
+#define TIMER_NAME "itimer"
+#else
+#define TIMER_NAME "gettimeofday"
+#endif
+
+/* The environment a run was measured in */
+typedef struct {
+    char cpu[MAXLINE];
+    long cpus;
+    char date[64];
+} env_t;
+
+static const char *request_names[] = {"malloc", "free", "realloc"};
+static const char *event_names[FPERF_NUM_EVENTS] = {
+    "cycles", "instructions", "cache_misses", "dtlb_misses", "branch_misses"};
+
+/*
+ * get_env - describe the machine, from /proc/cpuinfo where there is one
+ */
+static void get_env(env_t *env) {
+    char line[MAXLINE], *p;
+    time_t now = time(NULL);
+    FILE *f;
+
+    strcpy(env->cpu, "unknown");
+    if ((f = fopen("/proc/cpuinfo", "r")) != NULL) {
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (strncmp(line, "model name", 10) != 0) continue;
+            if ((p = strchr(line, ':')) == NULL) continue;
+            for (p++; *p == ' '; p++)
+                ;
+            p[strcspn(p, "\n")] = '\0';
+            snprintf(env->cpu, sizeof(env->cpu), "%s", p);
+            break;
+        }
+        fclose(f);
+    }
+    env->cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    strftime(env->date, sizeof(env->date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+}
+
+/*
+ * json_string - write s as a JSON string literal
+ */
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if (*s == '\n')
+            fputs("\\n", f);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
 
 /*
- * compute_performance_index - computes a score based on the weighted sum of
- * utilization and throughput
+ * csv_string - write s as a quoted CSV field
  */
-static double compute_performance_index(int num_tracefiles, double secs,
-                                        double ops, double util) {
-    double avg_util = util / num_tracefiles;
-    double avg_throughput = ops / secs;
+static void csv_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', f);
+        if (*s != '\n') fputc(*s, f);
+    }
+    fputc('"', f);
+}
 
-    double throughput_score;
-    if (avg_throughput > AVG_LIBC_THRUPUT) {
-        throughput_score = 1.0;
-    } else {
-        throughput_score = avg_throughput / AVG_LIBC_THRUPUT;
+/*
+ * write_stats_json - write the results of one allocator on one trace
+ */
+static void write_stats_json(FILE *f, stats_t *s, int is_mm) {
+    struct mm_stats *h = &s->heap;
+    int k;
+
+    fprintf(f, "    {\"trace\": ");
+    json_string(f, s->trace_name);
+    fprintf(f, ", \"valid\": %s, \"ops\": %.0f, \"load_secs\": %.9g",
+            s->valid ? "true" : "false", s->ops, s->load_secs);
+    if (s->error_msg[0]) {
+        fprintf(f, ", \"error\": ");
+        json_string(f, s->error_msg);
+    }
+    if (!s->valid) {
+        fprintf(f, "}");
+        return;
     }
+    fprintf(f, ", \"secs\": %.9g, \"kops\": %.3f", s->secs,
+            s->secs > 0 ? s->ops / 1e3 / s->secs : 0);
+    if (is_mm) {
+        fprintf(f, ", \"util\": %.6f", s->util);
+        fprintf(f,
+                ",\n     \"heap\": {\"live_bytes\": %zu, \"free_bytes\": %zu, "
+                "\"free_blocks\": %zu, \"largest_free\": %zu, \"sbrk_calls\": "
+                "%zu, \"splits\": %zu, \"coalesces\": [%zu, %zu, %zu, %zu], "
+                "\"realloc_in_place\": %zu, \"realloc_moved\": %zu, "
+                "\"mallocs\": %zu, \"search_hist\": [",
+                h->live_bytes, h->free_bytes, h->free_blocks, h->largest_free,
+                h->sbrk_calls, h->splits, h->coalesces[COALESCE_NONE],
+                h->coalesces[COALESCE_NEXT], h->coalesces[COALESCE_PREV],
+                h->coalesces[COALESCE_BOTH], h->realloc_in_place,
+                h->realloc_moved, h->mallocs);
+        for (k = 0; k < MM_SEARCH_BUCKETS; k++)
+            fprintf(f, "%s%zu", k ? ", " : "", h->search_hist[k]);
+        fprintf(f, "]}");
+    }
+    if (latency && is_mm) {
+        fprintf(f, ",\n     \"latency_ns\": {");
+        for (k = 0; k < 3; k++) {
+            latency_t *l = &s->lat[k];
+            fprintf(f,
+                    "%s\"%s\": {\"ops\": %.0f, \"p50\": %.0f, \"p90\": %.0f, "
+                    "\"p99\": %.0f, \"p999\": %.0f, \"max\": %.0f}",
+                    k ? ", " : "", request_names[k], l->ops, l->p50, l->p90,
+                    l->p99, l->p999, l->max);
+        }
+        fprintf(f, "}");
+    }
+    if (s->perf.running > 0) {
+        fprintf(f, ",\n     \"counters\": {\"running\": %.4f", s->perf.running);
+        for (k = 0; k < FPERF_NUM_EVENTS; k++) {
+            if (s->perf.count[k] < 0)
+                fprintf(f, ", \"%s\": null", event_names[k]);
+            else
+                fprintf(f, ", \"%s\": %.0f", event_names[k], s->perf.count[k]);
+        }
+        fprintf(f, "}");
+    }
+    if (s->nsamples > 0) {
+        fprintf(f,
+                ",\n     \"bench\": {\"runs\": %d, \"warmups\": %d, "
+                "\"secs_lo\": %.9g, \"secs_hi\": %.9g, \"samples\": [",
+                s->nsamples, bench_warmups, s->secs_lo, s->secs_hi);
+        for (k = 0; k < s->nsamples; k++)
+            fprintf(f, "%s%.9g", k ? ", " : "", s->samples[k]);
+        fprintf(f, "]}");
+    }
+    fprintf(f, "}");
+}
 
-    printf(
-        "Computing performance index from average util %f and throughput score "
-        "%f\n",
-        avg_util * 100, throughput_score * 100);
-    return 100 *
-           ((avg_util * UTIL_WEIGHT) + (1.0 - UTIL_WEIGHT) * throughput_score);
+/*
+ * The numeric CSV columns, in groups, with the format of each. The header
+ * and the rows are both written from these lists, a group at a time, so a
+ * row always has a field for every column of the header.
+ */
+typedef struct {
+    const char *name;
+    const char *fmt;
+} csv_column_t;
+
+static const csv_column_t csv_speed_columns[] = {{"secs", "%.9g"},
+                                                 {"kops", "%.3f"}};
+static const csv_column_t csv_heap_columns[] = {
+    {"util", "%.6f"},          {"live_bytes", "%.0f"},
+    {"free_bytes", "%.0f"},    {"free_blocks", "%.0f"},
+    {"largest_free", "%.0f"},  {"sbrk_calls", "%.0f"},
+    {"splits", "%.0f"},        {"realloc_in_place", "%.0f"},
+    {"realloc_moved", "%.0f"}, {"mallocs", "%.0f"}};
+static const csv_column_t csv_latency_columns[] = {
+    {"ops", "%.0f"}, {"p50", "%.0f"},  {"p90", "%.0f"},
+    {"p99", "%.0f"}, {"p999", "%.0f"}, {"max", "%.0f"}};
+static const csv_column_t csv_bench_columns[] = {
+    {"runs", "%.0f"}, {"secs_lo", "%.9g"}, {"secs_hi", "%.9g"}};
+
+#define CSV_COLUMNS(cols) (int)(sizeof(cols) / sizeof((cols)[0]))
+
+/*
+ * csv_header - write the names of n columns, each after a comma, with
+ *     prefix and "_" in front of them if prefix is not NULL
+ */
+static void csv_header(FILE *f, const csv_column_t *cols, int n,
+                       const char *prefix) {
+    int i;
+
+    for (i = 0; i < n; i++)
+        fprintf(f, ",%s%s%s", prefix ? prefix : "", prefix ? "_" : "",
+                cols[i].name);
+}
+
+/*
+ * csv_fields - write the n values of a group of columns, each after a
+ *     comma, or n empty fields if values is NULL
+ */
+static void csv_fields(FILE *f, const csv_column_t *cols, int n,
+                       const double *values) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        fputc(',', f);
+        if (values) fprintf(f, cols[i].fmt, values[i]);
+    }
+}
+
+/* csv_fields for a group whose values are in an array, which must have
+ * one value per column */
+#define CSV_FIELDS(f, cols, values, measured)                                  \
+    do {                                                                       \
+        (void)sizeof(char[CSV_COLUMNS(values) == CSV_COLUMNS(cols) ? 1 : -1]); \
+        csv_fields(f, cols, CSV_COLUMNS(cols), (measured) ? values : NULL);    \
+    } while (0)
+
+/*
+ * write_stats_csv - write the row of one allocator on one trace; fields
+ *     that were not measured are left empty. is_mm is set for the backend
+ *     under test, as opposed to the libc run of -l.
+ */
+static void write_stats_csv(FILE *f, env_t *env, const char *allocator,
+                            stats_t *s, int is_mm) {
+    struct mm_stats *h = &s->heap;
+    double speed[] = {s->secs, s->secs > 0 ? s->ops / 1e3 / s->secs : 0};
+    double heap[] = {s->util,        h->live_bytes,       h->free_bytes,
+                     h->free_blocks, h->largest_free,     h->sbrk_calls,
+                     h->splits,      h->realloc_in_place, h->realloc_moved,
+                     h->mallocs};
+    double bench[] = {s->nsamples, s->secs_lo, s->secs_hi};
+    int k;
+
+    csv_string(f, env->cpu);
+    fputc(',', f);
+    csv_string(f, __VERSION__);
+    fputc(',', f);
+    csv_string(f, MDRIVER_CFLAGS);
+    fprintf(f, ",%s,%s,%s,%s,%s,", MDRIVER_COMMIT, TIMER_NAME,
+            touch_names[touch_mode], env->date, allocator);
+    csv_string(f, s->trace_name);
+    fprintf(f, ",%d,%.0f,%.9g,", s->valid, s->ops, s->load_secs);
+    csv_string(f, s->error_msg);
+    CSV_FIELDS(f, csv_speed_columns, speed, s->valid);
+    CSV_FIELDS(f, csv_heap_columns, heap, s->valid && is_mm);
+    for (k = 0; k < 3; k++) {
+        latency_t *l = &s->lat[k];
+        double lat[] = {l->ops, l->p50, l->p90, l->p99, l->p999, l->max};
+        CSV_FIELDS(f, csv_latency_columns, lat, s->valid && latency && is_mm);
+    }
+    for (k = 0; k < FPERF_NUM_EVENTS; k++) {
+        if (s->valid && s->perf.running > 0 && s->perf.count[k] >= 0)
+            fprintf(f, ",%.0f", s->perf.count[k]);
+        else
+            fprintf(f, ",");
+    }
+    CSV_FIELDS(f, csv_bench_columns, bench, s->valid && s->nsamples > 0);
+    fputc('\n', f);
+}
+
+/*
+ * write_results - write the environment and the results of the mm package
+ *     (and of libc, if it was run) on the n traces to path, as JSON if
+ *     path ends in ".json" and as CSV otherwise
+ */
+static void write_results(char *path, int n, stats_t *mm, stats_t *libc,
+                          double perfindex) {
+    size_t len = strlen(path);
+    env_t env;
+    FILE *f;
+    int i, k;
+
+    get_env(&env);
+    if ((f = fopen(path, "w")) == NULL) {
+        sprintf(msg, "Could not open %s for the results", path);
+        unix_error(msg);
+    }
+    if (len >= 5 && !strcmp(path + len - 5, ".json")) {
+        double secs = 0, ops = 0, util = 0;
+        int valid = 0;
+
+        for (i = 0; i < n; i++) {
+            secs += mm[i].secs;
+            ops += mm[i].ops;
+            util += mm[i].util;
+            valid += mm[i].valid;
+        }
+        fprintf(f, "{\n  \"environment\": {\"cpu\": ");
+        json_string(f, env.cpu);
+        fprintf(f, ", \"cpus\": %ld, \"compiler\": ", env.cpus);
+        json_string(f, __VERSION__);
+        fprintf(f, ", \"cflags\": ");
+        json_string(f, MDRIVER_CFLAGS);
+        fprintf(f,
+                ", \"commit\": \"%s\", \"timer\": \"%s\", \"touch\": "
+                "\"%s\", \"backend\": \"%s\", \"heap\": \"%s\", "
+                "\"max_heap\": %d, \"date\": \"%s\"},\n",
+                MDRIVER_COMMIT, TIMER_NAME, touch_names[touch_mode],
+                backend->name, backend->uses_memlib ? "memlib" : "libc",
+                MAX_HEAP, env.date);
+        fprintf(f,
+                "  \"summary\": {\"traces\": %d, \"valid\": %d, \"errors\": "
+                "%d, \"ops\": %.0f, \"secs\": %.9g, \"kops\": %.3f, "
+                "\"avg_util\": %.6f, \"perfindex\": %.3f},\n",
+                n, valid, errors, ops, secs, secs > 0 ? ops / 1e3 / secs : 0,
+                util / n, perfindex);
+        for (k = 0; k < 2; k++) {
+            stats_t *stats = k ? libc : mm;
+            if (stats == NULL) continue;
+            fprintf(f, "%s  \"%s\": [\n", k ? ",\n" : "", k ? "libc" : "mm");
+            for (i = 0; i < n; i++) {
+                write_stats_json(f, &stats[i], !k);
+                fprintf(f, "%s\n", i < n - 1 ? "," : "");
+            }
+            fprintf(f, "  ]");
+        }
+        fprintf(f, "\n}\n");
+    } else {
+        /* the columns before the numeric groups, as in write_stats_csv */
+        fprintf(f,
+                "cpu,compiler,cflags,commit,timer,touch,date,allocator,trace,"
+                "valid,ops,load_secs,error");
+        csv_header(f, csv_speed_columns, CSV_COLUMNS(csv_speed_columns), NULL);
+        csv_header(f, csv_heap_columns, CSV_COLUMNS(csv_heap_columns), NULL);
+        for (k = 0; k < 3; k++)
+            csv_header(f, csv_latency_columns, CSV_COLUMNS(csv_latency_columns),
+                       request_names[k]);
+        for (k = 0; k < FPERF_NUM_EVENTS; k++)
+            fprintf(f, ",%s", event_names[k]);
+        csv_header(f, csv_bench_columns, CSV_COLUMNS(csv_bench_columns), NULL);
+        fputc('\n', f);
+        for (i = 0; i < n; i++) {
+            if (libc) write_stats_csv(f, &env, "libc", &libc[i], 0);
+            write_stats_csv(f, &env, backend->name, &mm[i], 1);
+        }
+    }
+    if (fclose(f) != 0) unix_error(path);
 }
 
 /*
@@ -933,39 +2998,442 @@ static double compute_performance_index(int num_tracefiles, double secs,
 static void printresults(int n, stats_t *stats) {
     int i;
     double secs = 0;
+    double load_secs = 0;
     double ops = 0;
     double util = 0;
 
     /* Print the individual results for each trace */
-    printf("%6s %4s                %12s %6s%5s%8s%11s\n", "trace#", " name",
-           " consistent", "util", "ops", "secs", "Kops");
+    printf("%6s %4s                %12s %6s%5s%13s%10s%8s\n", "trace#", " name",
+           " consistent", "util", "ops", "load", "secs", "Kops");
     printf(
         "----------------------------------------------------------------------"
-        "-"
+        "-----------"
         "\n");
     for (i = 0; i < n; i++) {
         if (stats[i].valid) {
-            printf(" %-2d     %-19s   %-9s%5.1f%%%8.0f%10.6f%8.0f\n", i,
+            printf(" %-2d     %-19s   %-9s%5.1f%%%8.0f%10.6f%10.6f%8.0f\n", i,
                    stats[i].trace_name, "yes", stats[i].util * 100.0,
-                   stats[i].ops, stats[i].secs,
+                   stats[i].ops, stats[i].load_secs, stats[i].secs,
                    (stats[i].ops / 1e3) / stats[i].secs);
             secs += stats[i].secs;
+            load_secs += stats[i].load_secs;
             ops += stats[i].ops;
             util += stats[i].util;
         } else {
-            printf(" %-2d     %-19s   %-7s%6s%6s%7s%11s\n", i,
-                   stats[i].trace_name, "no", "-", "-", "-", "-");
+            printf(" %-2d     %-19s   %-7s%6s%6s%10s%7s%11s\n", i,
+                   stats[i].trace_name, "no", "-", "-", "-", "-", "-");
         }
     }
     /* Print the aggregate results for the set of traces */
 
     if (errors == 0) {
-        printf("%24s%10.1f%%%8.0f%10.6f%8.0f\n",
+        printf("%24s%10.1f%%%8.0f%10.6f%10.6f%8.0f\n",
                "Total                             ", (util / n) * 100.0, ops,
-               secs, (ops / 1e3) / secs);
+               load_secs, secs, (ops / 1e3) / secs);
     } else {
-        printf("%12s%30s%6s%7s%11s\n", "Total        ", "-", "-", "-", "-");
+        printf("%12s%30s%6s%10s%7s%11s\n", "Total        ", "-", "-", "-", "-",
+               "-");
+    }
+    if (counters) {
+        printf("\n");
+        printcounters(n, stats);
+    }
+}
+
+/*
+ * printcounters - prints the hardware events per request for each trace
+ *     (-C), or "-" for an event the CPU could not count
+ */
+static void printcounters(int n, stats_t *stats) {
+    static const char *names[FPERF_NUM_EVENTS] = {
+        "cycles", "instrs", "llc-miss", "dtlb-miss", "br-miss"};
+    double total[FPERF_NUM_EVENTS] = {0};
+    double ops = 0;
+    int multiplexed = 0;
+    int i, e;
+
+    printf("Hardware events per request (user space):\n");
+    printf("%6s", "trace#");
+    for (e = 0; e < FPERF_NUM_EVENTS; e++) printf("%10s", names[e]);
+    printf("%7s\n", "IPC");
+    printf(
+        "----------------------------------------------------------------------"
+        "-----\n");
+    for (i = 0; i < n; i++) {
+        fperf_counts_t *p = &stats[i].perf;
+        if (!stats[i].valid || p->running == 0) {
+            printf(" %-2d     %s\n", i, "-");
+            continue;
+        }
+        printf(" %-5d", i);
+        for (e = 0; e < FPERF_NUM_EVENTS; e++) {
+            if (p->count[e] < 0) {
+                printf("%10s", "-");
+                total[e] = -1;
+                continue;
+            }
+            printf("%10.3f", p->count[e] / stats[i].ops);
+            if (total[e] >= 0) total[e] += p->count[e];
+        }
+        if (p->count[FPERF_CYCLES] > 0 && p->count[FPERF_INSTRUCTIONS] >= 0)
+            printf("%7.2f",
+                   p->count[FPERF_INSTRUCTIONS] / p->count[FPERF_CYCLES]);
+        else
+            printf("%7s", "-");
+        printf("%s\n", p->running < 1 ? " *" : "");
+        multiplexed |= p->running < 1;
+        ops += stats[i].ops;
+    }
+    if (ops == 0) return;
+
+    /* Print the events per request over all the traces counted */
+    printf("%-6s", "Total");
+    for (e = 0; e < FPERF_NUM_EVENTS; e++) {
+        if (total[e] < 0)
+            printf("%10s", "-");
+        else
+            printf("%10.3f", total[e] / ops);
+    }
+    if (total[FPERF_CYCLES] > 0 && total[FPERF_INSTRUCTIONS] >= 0)
+        printf("%7.2f\n", total[FPERF_INSTRUCTIONS] / total[FPERF_CYCLES]);
+    else
+        printf("%7s\n", "-");
+    if (multiplexed)
+        printf("* counters were multiplexed; counts are scaled estimates\n");
+}
+
+/*
+ * printheapstats - prints the allocator's own statistics for each trace,
+ *     as reported by mm_stats() at the end of the util replay
+ */
+static void printheapstats(int n, stats_t *stats) {
+    int i, b;
+
+    printf("Allocator statistics for mm malloc:\n");
+    printf("%6s %8s %8s %6s %8s %5s %6s %26s %13s\n", "trace#", "live", "free",
+           "fblks", "largest", "sbrk", "splits", "coalesce none/nxt/prv/both",
+           "realloc in/mv");
+    printf(
+        "----------------------------------------------------------------------"
+        "------------------------\n");
+    for (i = 0; i < n; i++) {
+        struct mm_stats *h = &stats[i].heap;
+        if (!stats[i].valid) {
+            printf(" %-2d     %s\n", i, "-");
+            continue;
+        }
+        printf(
+            " %-5d %8zu %8zu %6zu %8zu %5zu %6zu %8zu/%5zu/%5zu/%5zu "
+            "%6zu/%6zu\n",
+            i, h->live_bytes, h->free_bytes, h->free_blocks, h->largest_free,
+            h->sbrk_calls, h->splits, h->coalesces[COALESCE_NONE],
+            h->coalesces[COALESCE_NEXT], h->coalesces[COALESCE_PREV],
+            h->coalesces[COALESCE_BOTH], h->realloc_in_place, h->realloc_moved);
+    }
+
+    /* Free-list nodes visited per mm_malloc, in power-of-two buckets */
+    printf("\nFree-list nodes visited per mm_malloc:\n");
+    printf("%6s", "trace#");
+    for (b = 0; b < MM_SEARCH_BUCKETS; b++) {
+        if (b == 0) {
+            printf("%7s", "0");
+        } else if (b == MM_SEARCH_BUCKETS - 1) {
+            printf("%6s+", "1024");
+        } else {
+            printf("%7d", 1 << (b - 1));
+        }
+    }
+    printf("\n");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid) continue;
+        printf(" %-5d", i);
+        for (b = 0; b < MM_SEARCH_BUCKETS; b++) {
+            printf("%7zu", stats[i].heap.search_hist[b]);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * printbounds - Print each trace's utilization next to the best that the
+ *     policies of bound.h reached on it (-U), worst first being where an
+ *     allocator has the most room to improve
+ */
+static void printbounds(int n, stats_t *stats) {
+    double util = 0, bound = 0;
+    int i, counted = 0;
+
+    printf(
+        "Utilization against the bound (peak payload over the smallest "
+        "heap found\nby the offline policies of mmbound):\n");
+    printf("%6s %-20s %6s %6s %10s %10s %10s  %s\n", "trace#", " name", "util",
+           "bound", "% of bound", "heap KB", "bound KB", "policy");
+    for (i = 0; i < n; i++) {
+        stats_t *s = &stats[i];
+        double b = bound_util(&s->bound);
+        if (!s->valid || b == 0) {
+            printf(" %-5d %-20s %6s\n", i, s->trace_name, "-");
+            continue;
+        }
+        printf(" %-5d %-20s %5.1f%% %5.1f%% %9.1f%% %10.1f %10.1f  %s\n", i,
+               s->trace_name, s->util * 100, b * 100, s->util / b * 100,
+               s->bound.peak_live / s->util / 1024.0,
+               s->bound.heap[s->bound.best] / 1024.0,
+               bound_policy_names[s->bound.best]);
+        util += s->util;
+        bound += b;
+        counted++;
     }
+    if (counted)
+        printf("%-27s %5.1f%% %5.1f%% %9.1f%%\n", "Average",
+               util / counted * 100, bound / counted * 100, util / bound * 100);
+}
+
+/*
+ * printlatency - Print the latency percentiles of each request type on
+ *     each trace (-L)
+ */
+static void printlatency(int n, stats_t *stats) {
+    static const char *names[] = {"malloc", "free", "realloc"};
+    int i, k;
+
+    printf("Request latency for mm malloc (ns, less %.0f ns timer overhead):\n",
+           hist_overhead() / hist_ticks_per_ns());
+    printf("%6s %-8s %9s %8s %8s %8s %8s %9s\n", "trace#", "request", "ops",
+           "p50", "p90", "p99", "p99.9", "max");
+    printf(
+        "----------------------------------------------------------------------"
+        "\n");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid) {
+            printf(" %-2d     %s\n", i, "-");
+            continue;
+        }
+        for (k = 0; k < 3; k++) {
+            latency_t *l = &stats[i].lat[k];
+            if (l->ops == 0) continue;
+            printf(" %-5d %-8s %9.0f %8.0f %8.0f %8.0f %8.0f %9.0f\n", i,
+                   names[k], l->ops, l->p50, l->p90, l->p99, l->p999, l->max);
+        }
+    }
+}
+
+/*
+ * printbench - Print the median throughput of each trace over the runner's
+ *     runs, and its confidence interval (-n)
+ */
+static void printbench(int n, stats_t *stats) {
+    int i;
+
+    printf(
+        "Benchmark of mm malloc (median of %d runs after %d warmup%s, %.0f%% "
+        "CI):\n",
+        bench_runs, bench_warmups, bench_warmups == 1 ? "" : "s",
+        BENCH_CONFIDENCE * 100);
+    printf("%6s %-20s %6s %9s %21s %7s\n", "trace#", " name", "util", "Kops",
+           "Kops CI", "+/-");
+    printf(
+        "----------------------------------------------------------------------"
+        "--\n");
+    for (i = 0; i < n; i++) {
+        stats_t *s = &stats[i];
+        if (!s->valid || s->nsamples == 0) {
+            printf(" %-2d     %-20s %s\n", i, s->trace_name, "-");
+            continue;
+        }
+        printf(" %-5d %-20s %5.1f%% %9.0f  [%8.0f, %8.0f] %6.1f%%\n", i,
+               s->trace_name, s->util * 100, s->ops / 1e3 / s->secs,
+               s->ops / 1e3 / s->secs_hi, s->ops / 1e3 / s->secs_lo,
+               (s->secs_hi - s->secs_lo) / 2 / s->secs * 100);
+    }
+}
+
+/* The knobs of a policy profile, other than the classes */
+static const struct {
+    const char *name;
+    size_t offset; /* of a size_t in struct mm_policy */
+} policy_knobs[] = {
+    {"split_min", offsetof(struct mm_policy, split_min)},
+    {"realloc_split_div", offsetof(struct mm_policy, realloc_split_div)},
+    {"grow_chunk", offsetof(struct mm_policy, grow_chunk)},
+    {"placement", offsetof(struct mm_policy, placement)},
+};
+#define POLICY_KNOBS (int)(sizeof(policy_knobs) / sizeof(policy_knobs[0]))
+
+/*
+ * save_policy - Write a policy to path as a profile for -p: one knob per
+ *     line, its name and then its value, and last the size classes
+ */
+static void save_policy(char *path, const struct mm_policy *p) {
+    FILE *f;
+    int i;
+
+    if ((f = fopen(path, "w")) == NULL) unix_error(path);
+    fprintf(f, "# mdriver policy profile (see struct mm_policy in mm.h)\n");
+    for (i = 0; i < POLICY_KNOBS; i++)
+        fprintf(f, "%s %zu\n", policy_knobs[i].name,
+                *(const size_t *)((const char *)p + policy_knobs[i].offset));
+    fprintf(f, "classes");
+    for (i = 0; i < p->nclasses; i++) fprintf(f, " %zu", p->classes[i]);
+    fprintf(f, "\n");
+    if (fclose(f) != 0) unix_error(path);
+}
+
+/*
+ * load_policy - Read a profile written by save_policy into *p; the knobs
+ *     it leaves out keep their values. A line with anything but its
+ *     numbers after the name, a negative number, or more than
+ *     MM_MAX_CLASSES classes is an error.
+ */
+static void load_policy(char *path, struct mm_policy *p) {
+    char line[MAXLINE], name[MAXLINE];
+    char *s;
+    int i, used, bad;
+    size_t extra;
+    FILE *f;
+
+    if ((f = fopen(path, "r")) == NULL) unix_error(path);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (line[0] == '#' || sscanf(line, "%1023s%n", name, &used) != 1)
+            continue;
+        s = line + used;
+        bad = strchr(s, '-') != NULL; /* %zu would wrap a negative value */
+        if (!strcmp(name, "classes")) {
+            for (p->nclasses = 0;
+                 p->nclasses < MM_MAX_CLASSES &&
+                 sscanf(s, "%zu%n", &p->classes[p->nclasses], &used) == 1;
+                 p->nclasses++)
+                s += used;
+            bad |= sscanf(s, "%zu", &extra) == 1; /* a class too many */
+        } else {
+            for (i = 0; i < POLICY_KNOBS; i++)
+                if (!strcmp(name, policy_knobs[i].name)) break;
+            bad |= i == POLICY_KNOBS ||
+                   sscanf(s, "%zu%n",
+                          (size_t *)((char *)p + policy_knobs[i].offset),
+                          &used) != 1;
+            if (!bad) s += used;
+        }
+        s += strspn(s, " \t\r\n");
+        if (bad || *s != '\0') {
+            fprintf(stderr, "%s: bad policy line: %s", path, line);
+            exit(1);
+        }
+    }
+    fclose(f);
+}
+
+/*
+ * save_baseline - Write the runner's samples for each valid trace to path,
+ *     one trace per line: name, util, ops, number of samples, samples
+ */
+static void save_baseline(char *path, int n, stats_t *stats) {
+    FILE *f;
+    int i, k, saved = 0;
+
+    if ((f = fopen(path, "w")) == NULL) unix_error(path);
+    fprintf(f, "# mdriver baseline: trace util ops runs secs...\n");
+    for (i = 0; i < n; i++) {
+        stats_t *s = &stats[i];
+        if (!s->valid || s->nsamples == 0) continue;
+        fprintf(f, "%s %.9f %.0f %d", s->trace_name, s->util, s->ops,
+                s->nsamples);
+        for (k = 0; k < s->nsamples; k++) fprintf(f, " %.9g", s->samples[k]);
+        fprintf(f, "\n");
+        saved++;
+    }
+    if (fclose(f) != 0) unix_error(path);
+    printf("Saved baseline of %d traces to %s\n", saved, path);
+}
+
+/*
+ * compare_baseline - Compare each trace with its line in the baseline at
+ *     path, print a verdict per trace and return the number of
+ *     regressions (see BENCH_MIN_CHANGE)
+ */
+static int compare_baseline(char *path, int n, stats_t *stats) {
+    stats_t *base; /* baseline entries, of which only nbase are used */
+    int nbase = 0, regressions = 0;
+    char line[MAXLINE + BENCH_MAX_RUNS * 32];
+    char *p;
+    int i, j, k, used;
+    FILE *f;
+
+    if ((f = fopen(path, "r")) == NULL) unix_error(path);
+    if ((base = (stats_t *)calloc(n, sizeof(stats_t))) == NULL)
+        unix_error("calloc failed in compare_baseline");
+    while (nbase < n && fgets(line, sizeof(line), f) != NULL) {
+        stats_t *b = &base[nbase];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%1023s %lf %lf %d%n", b->trace_name, &b->util,
+                   &b->ops, &b->nsamples, &used) != 4 ||
+            b->nsamples <= 0 || b->nsamples > BENCH_MAX_RUNS) {
+            fprintf(stderr, "%s: bad baseline line: %s", path, line);
+            exit(1);
+        }
+        p = line + used;
+        for (k = 0; k < b->nsamples; k++) {
+            if (sscanf(p, "%lf%n", &b->samples[k], &used) != 1) {
+                fprintf(stderr, "%s: missing samples for %s\n", path,
+                        b->trace_name);
+                exit(1);
+            }
+            p += used;
+        }
+        nbase++;
+    }
+    fclose(f);
+
+    printf("Comparison with baseline %s (%.0f%% CI of the Kops change):\n",
+           path, BENCH_CONFIDENCE * 100);
+    printf("%6s %-20s %9s %9s %21s  %s\n", "trace#", " name", "util chg",
+           "Kops chg", "CI", "verdict");
+    printf(
+        "----------------------------------------------------------------------"
+        "--------\n");
+    for (i = 0; i < n; i++) {
+        stats_t *s = &stats[i], *b = NULL;
+        double ratio, lo, hi, util;
+        const char *verdict;
+
+        for (j = 0; j < nbase && b == NULL; j++)
+            if (!strcmp(base[j].trace_name, s->trace_name)) b = &base[j];
+        if (b == NULL) {
+            printf(" %-5d %-20s %s\n", i, s->trace_name, "not in baseline");
+            continue;
+        }
+        if (!s->valid || s->nsamples == 0) {
+            printf(" %-5d %-20s %s\n", i, s->trace_name, "INVALID");
+            regressions++;
+            continue;
+        }
+
+        /* ratio of the times, now over then; above 1 is slower */
+        ratio = bench_ratio_ci(b->samples, b->nsamples, s->samples, s->nsamples,
+                               &lo, &hi);
+        util = s->util - b->util;
+        if (util < -BENCH_UTIL_TOLERANCE) {
+            verdict = "UTIL REGRESSION";
+            regressions++;
+        } else if (lo > 1 && ratio > 1 + BENCH_MIN_CHANGE) {
+            verdict = "SLOWER";
+            regressions++;
+        } else if (hi < 1 && ratio < 1 - BENCH_MIN_CHANGE) {
+            verdict = "faster";
+        } else {
+            verdict = "same";
+        }
+        printf(" %-5d %-20s %+8.2f%% %+8.1f%%  [%+7.1f%%, %+7.1f%%]  %s\n", i,
+               s->trace_name, util * 100, (1 / ratio - 1) * 100,
+               (1 / hi - 1) * 100, (1 / lo - 1) * 100, verdict);
+    }
+    free(base);
+    if (regressions)
+        printf("%d significant regression%s\n", regressions,
+               regressions == 1 ? "" : "s");
+    else
+        printf("No significant regressions\n");
+    return regressions;
 }
 
 static void printresultsgradescope(int n, stats_t *stats) {
@@ -1066,10 +3534,11 @@ void malloc_error(int tracenum, int opnum, char *msg) {
     int ret = fprintf(stderr, "ERROR [trace %d, line %d]: %s\n", tracenum,
                       LINENUM(opnum), msg);
 
-    if (mm_stats) {
-        snprintf(
-            mm_stats[tracenum].error_msg, sizeof(mm_stats[tracenum].error_msg),
-            "ERROR [trace %d on line %d]: %s\n", tracenum, LINENUM(opnum), msg);
+    if (mm_results) {
+        snprintf(mm_results[tracenum].error_msg,
+                 sizeof(mm_results[tracenum].error_msg),
+                 "ERROR [trace %d on line %d]: %s\n", tracenum, LINENUM(opnum),
+                 msg);
     }
 
     (void)(ret);  // suppress unused result warnings
@@ -1079,17 +3548,102 @@ void malloc_error(int tracenum, int opnum, char *msg) {
  * usage - Explain the command line arguments
  */
 static void usage(void) {
-    fprintf(stderr, "Usage: mdriver [-hvValr] [-f <file>] [-t <dir>]\n");
+    int i;
+
+    fprintf(
+        stderr,
+        "Usage: mdriver [-hvValrSLC] [-f <file>] [-t <dir>] [-s <N>] [-j <N>]\n"
+        "               [-P <prefix> [-I <bytes>]] [-T <file> [-K <ops>]]\n"
+        "               [-n <runs> [-w <runs>]] [-B <file> | -c <file>]\n"
+        "               [-o <file>] [-b <backend> | -e] [-M <N>]\n"
+        "               [-O <rate>[:poisson]] [-A <rounds>] [-x <touch>] "
+        "[-YU]\n"
+        "               [-p <profile>] [-X <profile>[:<trials>]]\n");
     fprintf(stderr, "Options\n");
+    fprintf(stderr,
+            "\t-C         Print hardware events per request (implies -v).\n");
+    fprintf(stderr,
+            "\t-b <name>  Evaluate the backend <name> instead of mm.\n");
+    fprintf(stderr,
+            "\t-e         Rank every backend on every trace "
+            "(leaderboard).\n");
+    fprintf(stderr,
+            "\t-M <N>     Run the multithreaded benchmarks on 1 to <N> "
+            "threads.\n");
+    fprintf(stderr,
+            "\t-O <rate>  Replay open-loop from <rate> requests/s until "
+            "saturated\n"
+            "\t           (:poisson for Poisson arrivals).\n");
+    fprintf(stderr,
+            "\t-A <N>     Replay the traces N times on one heap to age it.\n");
+    fprintf(stderr,
+            "\t-Y         Compare the backends' (and mm's placements') "
+            "locality in a\n\t           simulated cache and TLB.\n");
+    fprintf(stderr,
+            "\t-U         Compare each trace's utilization with its bound "
+            "(see mmbound).\n");
+    fprintf(stderr,
+            "\t-x <touch> Payload writes in speed runs: none, line, full "
+            "(default),\n"
+            "\t           or readlater (full, then read back before free).\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
-    fprintf(stderr, "\t-r         Open the malloc REPL.\n");
+    fprintf(stderr, "\t-r         Open the malloc REPL (on mm only).\n");
+    fprintf(stderr,
+            "\t-o <file>  Write the results as CSV, or JSON if <file> ends "
+            "in .json.\n");
+    fprintf(stderr,
+            "\t-n <runs>  Time each trace <runs> times and report the median "
+            "and its CI.\n");
+    fprintf(stderr,
+            "\t-w <runs>  Untimed warmup runs before those (default 1).\n");
+    fprintf(stderr,
+            "\t-B <file>  Save the timed runs as a baseline (default -n "
+            "%d).\n",
+            BENCH_DEFAULT_RUNS);
+    fprintf(stderr,
+            "\t-c <file>  Compare with a baseline; exit with 2 on a "
+            "regression.\n");
+    fprintf(stderr,
+            "\t-P <pfx>   Write a sampled heap profile per trace to "
+            "<pfx>.<trace>.heap.\n");
+    fprintf(stderr,
+            "\t-I <bytes> Mean bytes between profiler samples (default %d).\n",
+            PROF_SAMPLE_BYTES);
     fprintf(stderr, "\t-G         Generates a ./gradescope-report.txt file.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr,
+            "\t-j <N>     Evaluate up to N traces at once, in worker "
+            "processes pinned\n\t           to a CPU each.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr,
+            "\t-L         Print per-request latency percentiles per trace.\n");
+    fprintf(stderr,
+            "\t-s <N>     Serve 1 in N mm_malloc calls from guard pages "
+            "(default %d, 0: none).\n",
+            GUARD_SAMPLE_RATE);
+    fprintf(stderr,
+            "\t-S         Stream the traces in chunks instead of loading "
+            "them.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr,
+            "\t-T <file>  Write a utilization timeline (CSV, or JSON if "
+            "<file> ends in .json).\n");
+    fprintf(stderr,
+            "\t-K <ops>   Ops between timeline samples (default 100).\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
-    fprintf(stderr, "\t-p         activates repl\n");
+    fprintf(stderr,
+            "\t-p <file>  Load the backend's policy knobs from a profile.\n");
+    fprintf(stderr,
+            "\t-X <file>  Search the policy knobs for the best perf index "
+            "and save\n"
+            "\t           them as a profile (:<trials> policies, default "
+            "%d).\n",
+            TUNE_TRIALS);
+    fprintf(stderr, "Backends\n");
+    for (i = 0; i < backend_count(); i++)
+        fprintf(stderr, "\t%-10s %s\n", backend_get(i)->name,
+                backend_get(i)->description);
 }
 
 // REPL Code
@@ -1147,62 +3701,86 @@ repl_block_t *find_repl_block_from_block(char *block_ptr, repl_block_t blocks[],
     return (repl_block_t *)NULL;
 }
 
+/* what print_repl_block needs to label the blocks it prints */
+typedef struct repl_print {
+    repl_block_t *blocks;
+    int repl_size;
+    block_t *epilogue;
+} repl_print_t;
+
+/*
+ * prints one block of the heap and checks its tags
+ * arguments: the block, as passed by mm_heap_walk, and a repl_print_t
+ * returns: 0, so that the walk continues
+ */
+static int print_repl_block(void *block, size_t size, int allocated,
+                            void *ctx) {
+    repl_print_t *print = ctx;
+    block_t *b = block;
+    int index = -1;
+
+    // if we are a valid repl block
+    repl_block_t *repl = find_repl_block_from_block((char *)(b), print->blocks,
+                                                    print->repl_size);
+    if (repl != NULL) {
+        index = repl->index;
+    }
+
+    // stores the identifying '[index]' after a repl block
+    // if it's a valid repl block
+    char indexstr[10] = "";
+    if (index != -1) sprintf(indexstr, "[%d]", index);
+
+    if (allocated) {
+        printf("block%s allocated \tblock at %p \tsize %d\n", indexstr,
+               (void *)(b), (int)size);
+    } else {
+        printf("free block \t\tblock at %p \tsize %d \tNext: %p\n", (void *)(b),
+               (int)size, (void *)(block_flink(b)));
+    }
+    size_t s1 = size;
+    size_t s2 = block_end_size(b);
+    if (s1 != s2) {
+        printf("block%s at %p had differing size tags: %d and %d\n\n", indexstr,
+               (void *)b, (int)s1, (int)s2);
+    }
+    if (s1 < MINBLOCKSIZE) {
+        printf("block%s at %p had too small a size: %d\n\n", indexstr,
+               (void *)b, (int)s1);
+    }
+    if (block_next(b) > print->epilogue + MINBLOCKSIZE) {
+        printf("next block wasn't in the heap. \n\n");
+    }
+    return 0;
+}
+
 /*
  * prints the state of the heap
- * arguments: none
+ * arguments: free_only: if set, prints only the free list
  * returns: nothing
  */
-void mm_print_heap_repl(repl_block_t blocks[], int repl_size) {
+void mm_print_heap_repl(repl_block_t blocks[], int repl_size, int free_only) {
+    repl_print_t print;
+
     // prints heap data & prologue
     block_t *heap_start = (block_t *)mem_heap_lo();
     printf("heap size: %d\n", (int)mem_heapsize());
-    block_t *b = (block_t *)heap_start;
+    print.blocks = blocks;
+    print.repl_size = repl_size;
+    print.epilogue = (block_t *)((char *)mem_heap_hi() - TAGS_SIZE + 1);
+    if (free_only) {
+        // prints the free list, in list order
+        mm_heap_walk(print_repl_block, &print, MM_WALK_FREE);
+        printf("\n\n");
+        return;
+    }
     printf("prologue \t\tblock at %p \tsize %d\n", (void *)heap_start,
            (int)block_size(heap_start));
-    b = block_next(b);
 
-    block_t *epilogue = (block_t *)((char *)mem_heap_hi() - TAGS_SIZE + 1);
     // prints all blocks
-    while (b != epilogue) {
-        int index = -1;
-
-        // if we are a valid repl block
-        repl_block_t *repl =
-            find_repl_block_from_block((char *)(b), blocks, repl_size);
-        if (repl != NULL) {
-            index = repl->index;
-        }
-
-        // stores the identifying '[index]' after a repl block
-        // if it's a valid repl block
-        char indexstr[10] = "";
-        if (index != -1) sprintf(indexstr, "[%d]", index);
-
-        if (block_allocated(b)) {
-            printf("block%s allocated \tblock at %p \tsize %d\n", indexstr,
-                   (void *)(b), (int)block_size(b));
-        } else {
-            printf("free block \t\tblock at %p \tsize %d \tNext: %p\n",
-                   (void *)(b), (int)block_size(b), (void *)(block_flink(b)));
-        }
-        size_t s1 = block_size(b);
-        size_t s2 = block_end_size(b);
-        if (s1 != s2) {
-            printf("block%s at %p had differing size tags: %d and %d\n\n",
-                   indexstr, (void *)b, (int)s1, (int)s2);
-        }
-        if (s1 < MINBLOCKSIZE) {
-            printf("block%s at %p had too small a size: %d\n\n", indexstr,
-                   (void *)b, (int)s1);
-        }
-        if (block_next(b) > epilogue + MINBLOCKSIZE) {
-            printf("next block wasn't in the heap. \n\n");
-        }
-        b = block_next(b);
-    }
-    printf("epilogue \t\tblock at %p \tsize %d\n\n\n", (void *)(epilogue),
-           (int)block_size(epilogue));
-    // return 0;
+    mm_heap_walk(print_repl_block, &print, MM_WALK_ALL);
+    printf("epilogue \t\tblock at %p \tsize %d\n\n\n", (void *)(print.epilogue),
+           (int)block_size(print.epilogue));
 }
 
 void help_cmd(const char *msg) {
@@ -1219,7 +3797,7 @@ void help_cmd(const char *msg) {
     fprintf(stderr, "free <index>           \t frees block at <index>\n");
     // fprintf(stderr, "reset                  \t resets memory\n");
     fprintf(stderr, "print                  \t prints the heap\n");
-    // fprintf(stderr, " print -f              \t prints the free list \n");
+    fprintf(stderr, "print -f               \t prints the free list\n");
     fprintf(
         stderr,
         "print -b <index>      \t prints the status of the block at <index>\n");
@@ -1253,9 +3831,13 @@ void print_cmd(const char *msg) {
         return;
     }
     // print free list
+    if (!strncmp(msg, "p -f", 4) || !strncmp(msg, "print -f", 8)) {
+        mm_print_heap_repl(repl_state->blocks, MAX_REPL_SIZE, 1);
+        return;
+    }
 
     // print heap (default)
-    mm_print_heap_repl(repl_state->blocks, MAX_REPL_SIZE);
+    mm_print_heap_repl(repl_state->blocks, MAX_REPL_SIZE, 0);
 }
 
 void reset_cmd(const char *msg) {
@@ -1266,7 +3848,7 @@ void reset_cmd(const char *msg) {
     clear_ranges(&(repl_state->ranges));
 
     /* Call the mm package's init function */
-    if (mm_init() < 0) {
+    if (backend->init() < 0) {
         malloc_error(repl_state->tracenum, 0, "mm_init failed.");
         exit(1);
     }
@@ -1309,7 +3891,7 @@ void malloc_cmd(const char *msg) {
         return;
     }
     repl_state->num_ops++;
-    if ((p = mm_malloc(size)) == NULL && size != 0) {
+    if ((p = backend->malloc(size)) == NULL && size != 0) {
         malloc_error(repl_state->tracenum, repl_state->num_ops,
                      "mm_malloc failed.");
         return;
@@ -1321,7 +3903,7 @@ void malloc_cmd(const char *msg) {
 
     /*
      * Test the range of the new block for correctness and add it
-     * to the range list if OK. The block must be  be aligned properly,
+     * to the range tree if OK. The block must be  be aligned properly,
      * and must not overlap any currently allocated block.
      */
     if (add_range(&(repl_state->ranges), p, size, repl_state->tracenum,
@@ -1363,7 +3945,7 @@ void free_cmd(const char *msg) {
     /* Remove region from list and call student's free function */
     p = repl_state->blocks[index].ptr;
     remove_range(&(repl_state->ranges), p);
-    mm_free(p);
+    backend->free(p);
     repl_state->blocks[index].is_valid = 0;
     return;
 }
@@ -1388,7 +3970,7 @@ void remalloc_cmd(const char *msg) {
     // }
     /* Call the student's realloc */
     oldp = repl_state->blocks[index].ptr;
-    if ((newp = mm_realloc(oldp, size)) == NULL && size) {
+    if ((newp = backend->realloc(oldp, size)) == NULL && size) {
         malloc_error(repl_state->tracenum, repl_state->num_ops,
                      "mm_realloc failed.");
         return;
@@ -1397,10 +3979,10 @@ void remalloc_cmd(const char *msg) {
         return;
     }
 
-    /* Remove the old region from the range list */
+    /* Remove the old region from the range tree */
     remove_range(&(repl_state->ranges), oldp);
 
-    /* Check new block for correctness and add it to range list */
+    /* Check new block for correctness and add it to the range tree */
     if (add_range(&(repl_state->ranges), newp, size, repl_state->tracenum,
                   repl_state->num_ops) == 0)
         return;
@@ -22,14 +22,20 @@ static char *mem_max_addr;  /* largest legal heap address */
 /*
  * mem_init - initialize the memory system model
  */
-void mem_init(void) {
+void mem_init(void) { mem_init_size(MAX_HEAP); }
+
+/*
+ * mem_init_size - initialize the memory system model with room for a heap
+ *    of max_heap bytes instead of MAX_HEAP
+ */
+void mem_init_size(size_t max_heap) {
     /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
+    if ((mem_start_brk = (char *)malloc(max_heap)) == NULL) {
         fprintf(stderr, "mem_init_vm: malloc error\n");
         exit(1);
     }
 
-    mem_max_addr = mem_start_brk + MAX_HEAP; /* max legal heap address */
+    mem_max_addr = mem_start_brk + max_heap; /* max legal heap address */
     mem_brk = mem_start_brk;                 /* heap is empty initially */
 }
 
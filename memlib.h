@@ -4,6 +4,7 @@
 #include <unistd.h>
 
 void mem_init(void);
+void mem_init_size(size_t max_heap);
 void mem_deinit(void);
 void *mem_sbrk(int incr);
 void mem_reset_brk(void);
@@ -0,0 +1,225 @@
+/*
+ * mkclasses - compile a size profile into size-class tables for mm.c
+ *
+ * Usage: mkclasses [-h] [-c <classes>] [-o <header>] <profile>
+ *
+ * Reads a size profile written by mmanalyze -w, chooses at most -c size
+ * classes among its block sizes up to MM_MAX_CLASS_SIZE, so that rounding
+ * the requests up to them wastes the fewest bytes (see classes.h), and
+ * writes a C header with:
+ *
+ *   - MM_NCLASSES and MM_CLASS_SIZES, the classes, which become mm.c's
+ *     default policy;
+ *   - mm_size_class, the class of every block size up to the largest
+ *     class, indexed by size / ALIGNMENT, so that mm.c finds the class of
+ *     a request with one load, and no branch or division;
+ *   - mm_class_chunk, the slab geometry: the bytes of a whole number of
+ *     blocks of each class, at least SLAB_BYTES, which is the least mm.c
+ *     asks mem_sbrk for when it grows the heap for that class.
+ *
+ * `make classes` runs it on the profile of the traces into mmclasses.h,
+ * and `make MM_CLASSES=1` builds mm.c with that header.
+ *
+ * The smallest class is MIN_CLASS: mm.c never splits a free block for a
+ * block of MINBLOCKSIZE, so a slab of those would all go to the first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "classes.h"
+#include "mm.h"
+
+#define DEFAULT_CLASSES 16
+#define MIN_CLASS (long)(MINBLOCKSIZE + ALIGNMENT)
+#define SLAB_BYTES 4096
+#define MAXLINE 1024
+
+static int compare_sizes(const void *x, const void *y) {
+    long a = ((const size_count_t *)x)->size;
+    long b = ((const size_count_t *)y)->size;
+    return (a > b) - (a < b);
+}
+
+/*
+ * read_profile - read the block sizes of a profile up to MM_MAX_CLASS_SIZE
+ *     into *sc, sorted and distinct; return how many there are
+ */
+static int read_profile(const char *path, size_count_t **sc, long *requests) {
+    char line[MAXLINE];
+    size_count_t s;
+    int n = 0, cap = 0, i, m;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    *sc = NULL;
+    *requests = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%ld %ld %ld", &s.size, &s.count, &s.bytes) != 3 ||
+            s.size <= 0 || s.count < 0) {
+            fprintf(stderr, "%s: bad profile line: %s", path, line);
+            exit(1);
+        }
+        *requests += s.count;
+        if (s.size > MM_MAX_CLASS_SIZE) continue;
+        if (s.size < MIN_CLASS) s.size = MIN_CLASS;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 64;
+            *sc = (size_count_t *)realloc(*sc, cap * sizeof(size_count_t));
+            if (*sc == NULL) {
+                fprintf(stderr, "mkclasses: out of memory\n");
+                exit(1);
+            }
+        }
+        (*sc)[n++] = s;
+    }
+    fclose(f);
+
+    /* merge the sizes that MIN_CLASS (or a repeated line) made equal */
+    qsort(*sc, n, sizeof(size_count_t), compare_sizes);
+    for (i = m = 0; i < n; i++) {
+        if (m > 0 && (*sc)[m - 1].size == (*sc)[i].size) {
+            (*sc)[m - 1].count += (*sc)[i].count;
+            (*sc)[m - 1].bytes += (*sc)[i].bytes;
+        } else {
+            (*sc)[m++] = (*sc)[i];
+        }
+    }
+    return m;
+}
+
+/*
+ * write_header - write the tables for the k classes to f
+ */
+static void write_header(FILE *f, const char *profile, const long *classes,
+                         int k, double waste, double served) {
+    long size, chunk;
+    int c, i;
+
+    fprintf(f,
+            "/*\n"
+            " * mmclasses.h - size classes for mm.c, generated by mkclasses "
+            "from\n"
+            " *     %s; do not edit (see mkclasses.c)\n"
+            " *\n"
+            " * They serve %.1f%% of the requests, and rounding up to them "
+            "adds %.2f%%\n"
+            " * to the bytes of those blocks.\n"
+            " */\n",
+            profile, served, waste);
+    fprintf(f, "#ifndef MMCLASSES_H_\n#define MMCLASSES_H_\n\n");
+    fprintf(f, "#include <stddef.h>\n\n");
+    fprintf(f, "#define MM_NCLASSES %d\n", k);
+    fprintf(f, "#define MM_CLASS_SIZES {");
+    for (c = 0; c < k; c++)
+        fprintf(f, "%s%ld", c == 0 ? "" : c % 8 ? ", " : ", \\\n    ",
+                classes[c]);
+    fprintf(f, "}\n\n");
+
+    fprintf(f,
+            "// the class of each block size up to the largest class, by "
+            "size / ALIGNMENT\n");
+    fprintf(f, "static const unsigned char mm_size_class[%ld] = {",
+            classes[k - 1] / ALIGNMENT + 1);
+    for (i = 0, c = 0, size = 0; size <= classes[k - 1];
+         size += ALIGNMENT, i++) {
+        while (size > classes[c]) c++;
+        fprintf(f, "%s%d", i % 16 ? ", " : (i ? ",\n    " : "\n    "), c);
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f,
+            "// the least bytes to sbrk for a block of each class: a slab "
+            "of whole blocks\n");
+    fprintf(f, "static const size_t mm_class_chunk[MM_NCLASSES] = {\n");
+    for (c = 0; c < k; c++) {
+        chunk = (SLAB_BYTES + classes[c] - 1) / classes[c] * classes[c];
+        fprintf(f, "    %ld,  // %ld x %ld\n", chunk, chunk / classes[c],
+                classes[c]);
+    }
+    fprintf(f, "};\n\n#endif  // MMCLASSES_H_\n");
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: mkclasses [-h] [-c <classes>] [-o <header>] <profile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr,
+            "\t-c <N>     Choose at most N size classes (default %d).\n",
+            DEFAULT_CLASSES);
+    fprintf(stderr, "\t-o <file>  Write the header to <file>, not stdout.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+}
+
+int main(int argc, char **argv) {
+    int nclasses = DEFAULT_CLASSES;
+    char *out = NULL;
+    size_count_t *sc;
+    long classes[MM_MAX_CLASSES];
+    long requests, served = 0, bytes = 0, payload = 0, rounding;
+    FILE *f = stdout;
+    int c, i, k, n;
+
+    while ((c = getopt(argc, argv, "hc:o:")) != EOF) {
+        switch (c) {
+            case 'c':
+                nclasses = atoi(optarg);
+                if (nclasses < 1 || nclasses > MM_MAX_CLASSES) {
+                    fprintf(stderr, "mkclasses: -c must be 1 to %d\n",
+                            MM_MAX_CLASSES);
+                    exit(1);
+                }
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            case 'h':
+                usage();
+                exit(0);
+            default:
+                usage();
+                exit(1);
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+        exit(1);
+    }
+
+    n = read_profile(argv[optind], &sc, &requests);
+    if (n == 0) {
+        fprintf(stderr, "mkclasses: no block sizes up to %d in %s\n",
+                MM_MAX_CLASS_SIZE, argv[optind]);
+        exit(1);
+    }
+    if ((k = best_classes(sc, n, nclasses, classes)) < 0) {
+        fprintf(stderr, "mkclasses: out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < n; i++) {
+        served += sc[i].count;
+        bytes += sc[i].size * sc[i].count;
+        payload += sc[i].bytes;
+    }
+    /* class_waste counts the tags and alignment as well as the rounding */
+    rounding = class_waste(sc, n, classes, k) - (bytes - payload);
+
+    if (out != NULL && (f = fopen(out, "w")) == NULL) {
+        perror(out);
+        exit(1);
+    }
+    write_header(f, argv[optind], classes, k,
+                 bytes ? 100.0 * rounding / bytes : 0,
+                 requests ? 100.0 * served / requests : 0);
+    if (f != stdout && fclose(f) != 0) {
+        perror(out);
+        exit(1);
+    }
+    free(sc);
+    return 0;
+}
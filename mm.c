@@ -18,10 +18,51 @@
  */
 #include "./memlib.h"
 #include "./mm.h"
+#include "./mmguard.h"
 #include "./mminline.h"
+#include "./mmprof.h"
+#ifdef MM_CLASSES
+#include "./mmclasses.h"  // size classes compiled from a profile (mkclasses)
+#endif
 block_t *prologue;
 block_t *epilogue;
 block_t *coalesce(void *b);
+static void *heap_malloc(size_t size);
+static void free_list_insert(block_t *block);
+static struct mm_stats counters;  // event counters reported by mm_stats()
+static int count_block(void *block, size_t size, int allocated, void *ctx);
+
+// the policy knobs (see mm.h); built with MM_CLASSES, the classes default
+// to the ones in mmclasses.h
+#ifdef MM_CLASSES
+static struct mm_policy policy = {
+    16 * MINBLOCKSIZE, 2, 0, MM_PLACE_LIFO, MM_NCLASSES, MM_CLASS_SIZES};
+#else
+static struct mm_policy policy = {16 * MINBLOCKSIZE, 2, 0,
+                                  MM_PLACE_LIFO,     0, {0}};
+#endif
+// the class of each block size up to the last class, indexed by
+// size / ALIGNMENT, so that finding a size's class is one load, and the
+// least bytes to sbrk for a block of each class. They point to the tables
+// of mmclasses.h until mm_set_policy() builds them for its classes.
+static unsigned char policy_class[MM_MAX_CLASS_SIZE / ALIGNMENT + 1];
+static size_t policy_chunk[MM_MAX_CLASSES];  // none: grow_chunk applies
+#ifdef MM_CLASSES
+static const unsigned char *size_class = mm_size_class;
+static const size_t *class_chunk = mm_class_chunk;
+#else
+static const unsigned char *size_class = policy_class;
+static const size_t *class_chunk = policy_chunk;
+#endif
+
+// records the number of free-list nodes one mm_malloc call visited
+static inline void count_search(size_t visited) {
+    int bucket = visited ? 64 - __builtin_clzl(visited) : 0;
+    if (bucket >= MM_SEARCH_BUCKETS) {
+        bucket = MM_SEARCH_BUCKETS - 1;
+    }
+    counters.search_hist[bucket]++;
+}
 
 // rounds up to the nearest multiple of WORD_SIZE
 static inline size_t align(size_t size) {
@@ -42,6 +83,8 @@ static inline size_t align(size_t size) {
  *         -1, if an error occurs
  */
 int mm_init(void) {
+    memset(&counters, 0, sizeof(counters));  // resets statistics
+    counters.sbrk_calls = 2;
     prologue = mem_sbrk(TAGS_SIZE);  // allocates prologue
     if (prologue == (void *)-1) {    // error checking
         return -1;
@@ -51,6 +94,8 @@ int mm_init(void) {
         return -1;
     }
     flist_first = NULL;  // since no other free blocks exist
+    mm_guard_reset();    // returns all sampled slots to the guarded pool
+    mm_prof_reset();     // drops profiler samples from the previous heap
     block_set_size_and_allocated(prologue, TAGS_SIZE, 1);  // sets size
     block_set_size_and_allocated(epilogue, TAGS_SIZE, 1);  // sets size
     return 0;
@@ -68,28 +113,66 @@ int mm_init(void) {
  *          is a multiple of ALIGNMENT), or NULL if an error occurred
  */
 void *mm_malloc(size_t size) {
+    void *p = NULL;
+    counters.mallocs++;
+    if (mm_guard_should_sample()) {  // serves 1 in N calls from guard pages
+        p = mm_guard_malloc(size);
+    }
+    if (p == NULL) {
+        p = heap_malloc(size);
+    }
+    if (mm_prof_should_sample(size)) {  // records 1 in N bytes' call site
+        mm_prof_record(p, size);
+    }
+    return p;
+}
+
+/**
+ * Helper function for mm_malloc(), allocates a block from the free list (or
+ * by extending the heap)
+ *
+ * Parameters:
+ * - size: the desired payload size for the block
+ *
+ * Returns:
+ * - a pointer to the newly-allocated block's payload, or NULL on error
+ * **/
+static void *heap_malloc(size_t size) {
     block_t *curr = flist_first;
     block_t *new = NULL;
+    size_t visited = 0;  // free-list nodes looked at, for the statistics
     size = align(size) + TAGS_SIZE;  // aligns size
     if (size == 0) {
         return NULL;
     }
+    size_t chunk = policy.grow_chunk;  // least bytes to sbrk for the block
+    if (policy.nclasses > 0 &&
+        size <= policy.classes[policy.nclasses - 1]) {  // rounds up to class
+        int c = size_class[size / ALIGNMENT];
+        size = policy.classes[c];
+        if (class_chunk[c] > chunk) {
+            chunk = class_chunk[c];
+        }
+    }
     while (curr != NULL) {  // search through free list
+        visited++;
         if (block_size(curr) >=
             size) {  // if the size is large enough to malloc
             block_t *alloc = curr;
             pull_free_block(curr);  // pulls free block
             if (size > MINBLOCKSIZE &&
                 block_size(curr) - size >
-                    (16 * MINBLOCKSIZE)) {  // condition to check for splitting
+                    policy.split_min) {  // condition to check for splitting
                 size_t total = block_size(curr);
                 block_set_size_and_allocated(alloc, size, 1);
                 block_t *freed = block_next(curr);
                 block_set_size_and_allocated(
                     freed, total - size,
                     0);  // splitting- taking (total size - size allocated)
-                insert_free_block(freed);  // inserts into free list
+                free_list_insert(freed);  // inserts into free list
+                counters.splits++;
             }
+            count_search(visited);
             block_set_allocated(curr, 1);  // sets curr as allocated
             return curr->payload;          // returns its payload
         }
@@ -99,14 +182,25 @@ void *mm_malloc(size_t size) {
             break;
         }
     }
-    new = mem_sbrk(size);     // otherwise, if there is no memory, asks for more
+    count_search(visited);
+    counters.sbrk_calls++;
+    size_t grow = size < chunk ? chunk : size;
+    new = mem_sbrk(grow);     // otherwise, if there is no memory, asks for more
                               // (can't find a fit)
     if (new == (void *)-1) {  // error checking
         return NULL;
     }
+    if (grow - size < MINBLOCKSIZE) {  // too little left over to free
+        size = grow;
+    }
     new = epilogue;  // the new block is the end of heap
     block_set_size_and_allocated(new, size, 1);
     epilogue = block_next(new);  // sets epilogue to be the block after new
+    if (grow > size) {           // frees the rest of the chunk
+        block_set_size_and_allocated(epilogue, grow - size, 0);
+        free_list_insert(epilogue);
+        epilogue = block_next(epilogue);
+    }
     block_set_size_and_allocated(epilogue, TAGS_SIZE,
                                  1);  // sets epilogue to be allocated
     return new->payload;              // returns payload
@@ -124,10 +218,44 @@ void *mm_malloc(size_t size) {
  * returns: nothing
  */
 void mm_free(void *ptr) {
+    if (prof_num_live != 0) {  // retires the block's bytes if it was sampled
+        mm_prof_forget(ptr);
+    }
+    if (mm_guard_owns(ptr)) {  // sampled block: quarantine its slot
+        mm_guard_free(ptr);
+        return;
+    }
     block_t *block = payload_to_block(ptr);
     block_set_allocated(block, 0);  // sets block to be unallocated
     block = coalesce(ptr);          // coalesce
-    insert_free_block(block);       // inserts into free list
+    free_list_insert(block);        // inserts into free list
+}
+
+/**
+ * Helper function, puts a free block in the free list where the placement
+ * policy says: at the front, or before the first block above it, so that
+ * the list stays in address order
+ *
+ * Parameters:
+ * - block: the free block
+ *
+ * Returns:
+ * - nothing
+ * **/
+static void free_list_insert(block_t *block) {
+    block_t *curr = flist_first;
+    if (policy.placement == MM_PLACE_LIFO || curr == NULL || block < curr) {
+        insert_free_block(block);  // at the front
+        return;
+    }
+    do {  // finds the first block above it (or wraps around to the front)
+        curr = block_flink(curr);
+    } while (curr != flist_first && curr < block);
+    block_t *prev = block_blink(curr);
+    block_set_flink(block, curr);
+    block_set_blink(block, prev);
+    block_set_flink(prev, block);
+    block_set_blink(curr, block);
 }
 
 /**
@@ -159,6 +287,7 @@ block_t *coalesce(void *b) {
         pull_free_block(prev);
         block_set_allocated(prev, 0);
         block_set_allocated(t, 0);
+        counters.coalesces[COALESCE_BOTH]++;
         block_set_size(prev,
                        (one + two + three));  // changes size of prev block (so
                                               // it is all one large free block)
@@ -173,6 +302,7 @@ block_t *coalesce(void *b) {
         pull_free_block(next);
         block_set_allocated(next, 0);
         block_set_allocated(t, 0);
+        counters.coalesces[COALESCE_NEXT]++;
         block_set_size(t, (one + three));
     } else if (!(block_prev_allocated(t)) &&
                (block_next_allocated(t))) {  // if prev unallocated, next
@@ -183,11 +313,13 @@ block_t *coalesce(void *b) {
         pull_free_block(prev);
         block_set_allocated(prev, 0);
         block_set_allocated(t, 0);
+        counters.coalesces[COALESCE_PREV]++;
         // changes size of prev to include the current block
         block_set_size(prev, (two + three));
         // set pointer to prev
         t = prev;
     } else {
+        counters.coalesces[COALESCE_NONE]++;
         return t;  // if there is no need to coalesce
     }
     return t;
@@ -211,6 +343,16 @@ void *mm_realloc(void *ptr, size_t size) {
         mm_free(ptr);
         return NULL;
     }
+    if (mm_guard_owns(ptr)) {  // sampled block: move it back into the heap
+        size_t guarded = mm_guard_size(ptr);
+        void *ret = mm_malloc(size);
+        if (ret != NULL) {
+            memcpy(ret, ptr, guarded < size ? guarded : size);
+        }
+        mm_guard_free(ptr);
+        counters.realloc_moved++;
+        return ret;
+    }
     size_t oldsize = size;  // stors unaligned size
     size = align(size) + TAGS_SIZE;
     if (ptr == NULL) {  // if ptr is null, calls malloc
@@ -221,13 +363,19 @@ void *mm_realloc(void *ptr, size_t size) {
     size_t requested = size;
     if (((original - requested) >= MINBLOCKSIZE) &&
         (requested <=
-         (original / 2))) {  // splits if requested size smaller than ptr's size
+         (original / policy.realloc_split_div))) {  // splits if requested size
+                                                    // smaller than ptr's size
         block_set_size(block, requested);
         block_t *freed = block_next(block);
         block_set_size_and_allocated(
             freed, original - requested,
             0);  // splitting- taking (original size - requested size)
-        insert_free_block(freed);  // inserts this new block into free list
+        free_list_insert(freed);  // inserts this new block into free list
+        counters.splits++;
+        counters.realloc_in_place++;
+        if (prof_num_live != 0) {  // a sampled block keeps its call site
+            mm_prof_resize(ptr, oldsize);
+        }
         return ptr;
     }
     size_t to_check =
@@ -240,22 +388,34 @@ void *mm_realloc(void *ptr, size_t size) {
         block_t *freed = block_next(block);
         pull_free_block(freed);  // pulls next block from free list
         if ((to_check - requested) >= MINBLOCKSIZE &&
-            (requested <= (to_check / 2))) {  // if splitting is necessary
+            (requested <=
+             (to_check / policy.realloc_split_div))) {  // if splitting is
+                                                        // necessary
             block_set_size(block, requested);
             block_set_size_and_allocated(
                 block_next(block), to_check - requested,
                 0);  // splitting- taking (combined size - requested size)
-            insert_free_block(
+            free_list_insert(
                 block_next(block));  // inserts next block into free list
+            counters.splits++;
+            counters.realloc_in_place++;
+            if (prof_num_live != 0) {
+                mm_prof_resize(ptr, oldsize);
+            }
             return ptr;
         }
         block_set_size(block, to_check);  // otherwise, if splitting unecessary
+        counters.realloc_in_place++;
+        if (prof_num_live != 0) {  // a sampled block keeps its call site
+            mm_prof_resize(ptr, oldsize);
+        }
         return ptr;
     } else {  // otherwise, searches free list for available memory
         char to_save[requested];  // creates a buffer to save the ptr, so that
                                   // it can be freed
         memcpy(to_save, ptr, requested);  // copies over the memory
-        mm_free(ptr);                     // frees current block
+        counters.realloc_moved++;
+        mm_free(ptr);  // frees current block
         void *ret = mm_malloc(
             requested);     // get large enough block for requested memory
         if (ret == NULL) {  // error checking
@@ -273,3 +433,140 @@ void *mm_realloc(void *ptr, size_t size) {
         return to_return;
     }
 }
+
+/*
+ *                                  _           _
+ *     _ __ ___  _ __ ___      ___ | |_   __ _ | |_  ___
+ *    | '_ ` _ \| '_ ` _ \    / __|| __| / _` || __|/ __|
+ *    | | | | | | | | | | |   \__ \| |_ | (_| || |_ \__ \
+ *    |_| |_| |_|_| |_| |_|___|___/ \__| \__,_| \__||___/
+ *                       |_____|
+ *
+ * reports the allocator's statistics since the last call to mm_init()
+ * arguments: stats: filled in with the event counters, plus the live and
+ *                   free byte counts found by walking the heap
+ * returns: nothing
+ */
+void mm_stats(struct mm_stats *stats) {
+    *stats = counters;
+    stats->live_bytes = 0;
+    stats->free_bytes = 0;
+    stats->free_blocks = 0;
+    stats->largest_free = 0;
+    mm_heap_walk(count_block, stats, MM_WALK_ALL);
+}
+
+/**
+ * Helper function for mm_stats(), adds one block to the byte and block counts
+ *
+ * Parameters:
+ * - block, size, allocated: the block, as passed by mm_heap_walk()
+ * - ctx: the struct mm_stats being filled in
+ *
+ * Returns:
+ * - 0, so that the walk continues
+ * **/
+static int count_block(void *block, size_t size, int allocated, void *ctx) {
+    struct mm_stats *stats = ctx;
+    (void)block;
+    if (allocated) {
+        stats->live_bytes += size;
+    } else {
+        stats->free_bytes += size;
+        stats->free_blocks++;
+        if (size > stats->largest_free) {
+            stats->largest_free = size;
+        }
+    }
+    return 0;
+}
+
+/*
+ * visits the blocks of the heap, for profilers, checkers and visualizers
+ * arguments: fn: called with each block's address, size and state; the walk
+ *                stops early if it returns nonzero
+ *            ctx: passed through to fn
+ *            flags: MM_WALK_ALL visits every block between the prologue and
+ *                   the epilogue in address order; MM_WALK_FREE visits only
+ *                   the free blocks, by following the free list
+ * returns: the nonzero value that stopped the walk, or 0
+ */
+int mm_heap_walk(mm_walk_fn fn, void *ctx, int flags) {
+    block_t *b;
+    int ret;
+    if (flags & MM_WALK_FREE) {
+        if ((b = flist_first) == NULL) {
+            return 0;
+        }
+        do {
+            if ((ret = fn(b, block_size(b), 0, ctx)) != 0) {
+                return ret;
+            }
+            b = block_flink(b);
+        } while (b != flist_first);
+        return 0;
+    }
+    for (b = block_next(prologue); b != epilogue; b = block_next(b)) {
+        if ((ret = fn(b, block_size(b), block_allocated(b), ctx)) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/*
+ * copies the allocator's current policy knobs
+ * arguments: p: filled in with the knobs
+ * returns: nothing
+ */
+void mm_get_policy(struct mm_policy *p) { *p = policy; }
+
+/*
+ * changes the allocator's policy knobs, from the next request on
+ * arguments: p: the new knobs; split_min must be at least MINBLOCKSIZE, so
+ *               that a split never leaves a block smaller than that,
+ *               realloc_split_div at least 1, grow_chunk and the classes
+ *               multiples of ALIGNMENT, placement one of the MM_PLACE_
+ *               policies, and the classes at least
+ *               MINBLOCKSIZE, at most MM_MAX_CLASS_SIZE and increasing
+ * returns: 0, if successful
+ *         -1, if the policy is not valid (the old one is kept)
+ */
+int mm_set_policy(const struct mm_policy *p) {
+    if (p->split_min < MINBLOCKSIZE || p->realloc_split_div < 1 ||
+        (p->grow_chunk & (ALIGNMENT - 1)) || p->placement > MM_PLACE_ADDRESS ||
+        p->nclasses < 0 || p->nclasses > MM_MAX_CLASSES) {
+        return -1;
+    }
+    for (int i = 0; i < p->nclasses; i++) {
+        if ((p->classes[i] & (ALIGNMENT - 1)) || p->classes[i] < MINBLOCKSIZE ||
+            p->classes[i] > MM_MAX_CLASS_SIZE ||
+            (i > 0 && p->classes[i] <= p->classes[i - 1])) {
+            return -1;
+        }
+    }
+    policy = *p;
+#ifdef MM_CLASSES
+    // keeps the compiled tables, slabs included, for the compiled classes
+    static const size_t compiled[MM_NCLASSES] = MM_CLASS_SIZES;
+    if (p->nclasses == MM_NCLASSES &&
+        memcmp(p->classes, compiled, sizeof(compiled)) == 0) {
+        size_class = mm_size_class;
+        class_chunk = mm_class_chunk;
+        return 0;
+    }
+#endif
+    // fills in the class of every block size up to the last class
+    int c = 0;
+    for (size_t size = 0;
+         p->nclasses > 0 && size <= p->classes[p->nclasses - 1];
+         size += ALIGNMENT) {
+        while (size > p->classes[c]) {
+            c++;
+        }
+        policy_class[size / ALIGNMENT] = c;
+    }
+    size_class = policy_class;
+    class_chunk = policy_chunk;
+    return 0;
+}
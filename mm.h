@@ -8,6 +8,72 @@ void *mm_malloc(size_t size);
 void mm_free(void *ptr);
 void *mm_realloc(void *ptr, size_t size);
 
+// Number of buckets in the search-length histogram of struct mm_stats.
+// Bucket 0 counts mm_malloc calls that visited no free-list node, bucket b
+// counts calls that visited [2^(b-1), 2^b) nodes, and the last bucket
+// collects everything longer.
+#define MM_SEARCH_BUCKETS 12
+
+// Indices into mm_stats.coalesces, one per branch of coalesce()
+enum { COALESCE_NONE, COALESCE_NEXT, COALESCE_PREV, COALESCE_BOTH };
+
+// Allocator statistics since the last mm_init. The event counters are kept
+// up to date by the allocator; the byte and block counts are computed by
+// mm_stats() itself, so reading them costs a walk over the heap.
+struct mm_stats {
+    size_t live_bytes;        // bytes in allocated blocks, tags included
+    size_t free_bytes;        // bytes in free blocks
+    size_t free_blocks;       // number of blocks in the free list
+    size_t largest_free;      // size of the largest free block
+    size_t sbrk_calls;        // calls to mem_sbrk
+    size_t splits;            // blocks split in mm_malloc and mm_realloc
+    size_t coalesces[4];      // frees by coalesce() case (COALESCE_*)
+    size_t realloc_in_place;  // reallocs that kept their block
+    size_t realloc_moved;     // reallocs that copied to a new block
+    size_t mallocs;           // calls to mm_malloc
+    size_t search_hist[MM_SEARCH_BUCKETS];  // free-list nodes visited
+};
+
+void mm_stats(struct mm_stats *stats);
+
+// Flags for mm_heap_walk()
+#define MM_WALK_ALL 0   // visit every block, in address order
+#define MM_WALK_FREE 1  // visit only free blocks, in free-list order
+
+// Called by mm_heap_walk() for each block with the block's address, its
+// size (tags included) and whether it is allocated. A nonzero return value
+// stops the walk.
+typedef int (*mm_walk_fn)(void *block, size_t size, int allocated, void *ctx);
+
+int mm_heap_walk(mm_walk_fn fn, void *ctx, int flags);
+
+// Most size classes a policy can have, and the largest class (a block size,
+// tags included) they can round up to.
+#define MM_MAX_CLASSES 32
+#define MM_MAX_CLASS_SIZE 4096
+
+// Where a block goes when it joins the free list, which first fit then
+// searches from the front: at the front (LIFO), or in address order.
+#define MM_PLACE_LIFO 0
+#define MM_PLACE_ADDRESS 1
+
+// The allocator's policy knobs. They default to the rules mm.c was tuned
+// with by hand, can be changed at any time, and are kept by mm_init().
+// mdriver -p loads them from a profile and mdriver -X searches for them.
+struct mm_policy {
+    size_t split_min;          // split a free block if more than this is left
+    size_t realloc_split_div;  // shrink in place to at most 1/this of a block
+    size_t grow_chunk;         // least bytes asked of mem_sbrk at a time
+    size_t placement;          // MM_PLACE_LIFO or MM_PLACE_ADDRESS
+    int nclasses;              // block sizes up to the last class round up
+    size_t classes[MM_MAX_CLASSES];  // to the next class, in increasing order
+};
+
+void mm_get_policy(struct mm_policy *policy);
+
+// Returns -1, and changes nothing, if the policy is not valid.
+int mm_set_policy(const struct mm_policy *policy);
+
 
 // Defines alignment to 8 bytes.
 #define ALIGNMENT 8
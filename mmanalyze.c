@@ -0,0 +1,449 @@
+/*
+ * mmanalyze - describe the workload in allocator traces, and recommend
+ *     size classes and thresholds for it
+ *
+ * Usage: mmanalyze [-h] [-c <classes>] [-w <profile>] <trace>...
+ *
+ * For each trace (of either format, see trace.h) this prints:
+ *
+ *   - the histogram of request sizes, in power-of-two buckets;
+ *   - the histogram of block lifetimes, in ops from the malloc to the free;
+ *   - the live-set curve: live payload and blocks over the trace;
+ *   - realloc chains: how many times blocks are reallocated, and by what
+ *     factor they grow at each step;
+ *   - the free order: how often the block freed is the youngest live
+ *     block (LIFO) or the oldest (FIFO), and its mean age rank among the
+ *     live blocks (0 for LIFO, 1 for FIFO);
+ *
+ * and then recommends a small-object threshold, size classes below it
+ * (chosen to waste the fewest bytes on this trace's requests), an mmap
+ * threshold and a split threshold for mm.c.
+ *
+ * With -w, it also writes the size profile of all the traces together:
+ * one line per block size that mm.c would use (the aligned request plus
+ * the tags), with the number of requests of that size and their payload
+ * bytes. mkclasses turns a profile into size classes for mm.c.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "classes.h"
+#include "mm.h"
+#include "trace.h"
+
+#define LOG_BUCKETS 32 /* power-of-two buckets, up to 2^31 */
+#define LIVE_POINTS 20 /* points printed on the live-set curve */
+#define DEFAULT_CLASSES 16
+#define MAX_CLASSES 64
+#define SMALL_FRACTION 0.9  /* of requests served from size classes */
+#define MMAP_FRACTION 0.999 /* of requests below the mmap threshold */
+#define MMAP_MIN (64 << 10) /* smallest mmap threshold worth a syscall */
+#define SPLIT_FRACTION 0.25 /* of requests a split remainder must fit */
+
+int verbose = 0; /* read by trace.c */
+
+/* the request sizes of all the traces, for the size profile (-w) */
+static int *profile;
+static long profile_n, profile_cap;
+static void profile_add(const int *sizes, long n);
+
+/* What the analysis keeps per id */
+typedef struct {
+    int alloc_op; /* op of the malloc, for the lifetime */
+    int seq;      /* allocation order, for the free order */
+    int size;     /* current payload size */
+    int chain;    /* reallocs so far */
+} block_info_t;
+
+static void *xcalloc(size_t n, size_t size) {
+    void *p = calloc(n, size);
+    if (p == NULL && n > 0) {
+        fprintf(stderr, "mmanalyze: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static int log2_bucket(unsigned long v) {
+    int b = 0;
+    while (v > 1 && b < LOG_BUCKETS - 1) {
+        v >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static long align_size(long size) {
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+static int compare_ints(const void *x, const void *y) {
+    int a = *(const int *)x, b = *(const int *)y;
+    return (a > b) - (a < b);
+}
+
+static int compare_doubles(const void *x, const void *y) {
+    double a = *(const double *)x, b = *(const double *)y;
+    return (a > b) - (a < b);
+}
+
+/*
+ * print_log2_hist - print a histogram in power-of-two buckets, skipping
+ *     empty buckets at either end
+ */
+static void print_log2_hist(const char *unit, const long *counts) {
+    long total = 0, seen = 0;
+    int b, lo, hi;
+
+    for (b = 0; b < LOG_BUCKETS; b++) total += counts[b];
+    if (total == 0) {
+        printf("  (none)\n");
+        return;
+    }
+    for (lo = 0; counts[lo] == 0; lo++)
+        ;
+    for (hi = LOG_BUCKETS - 1; counts[hi] == 0; hi--)
+        ;
+    printf("  %21s %10s %7s %7s\n", unit, "count", "%", "cum %");
+    for (b = lo; b <= hi; b++) {
+        seen += counts[b];
+        printf("  [%8lu, %8lu) %10ld %6.2f%% %6.2f%%\n", b ? 1UL << b : 0,
+               1UL << (b + 1), counts[b], 100.0 * counts[b] / total,
+               100.0 * seen / total);
+    }
+}
+
+/*****************************************************************
+ * Fenwick tree over allocation order, counting live blocks, so that the
+ * age rank of a freed block among the live ones is a log-time query
+ ****************************************************************/
+
+static long *fenwick;
+static int fenwick_n;
+
+static void fenwick_add(int i, long d) {
+    for (i++; i <= fenwick_n; i += i & -i) fenwick[i] += d;
+}
+
+/* live blocks allocated before the i-th */
+static long fenwick_prefix(int i) {
+    long s = 0;
+    for (; i > 0; i -= i & -i) s += fenwick[i];
+    return s;
+}
+
+/*****************************************************************
+ * The analysis
+ ****************************************************************/
+
+/*
+ * analyze - print the analysis of one trace and the recommendations
+ */
+static void analyze(trace_t *trace, int nclasses) {
+    block_info_t *info =
+        (block_info_t *)xcalloc(trace->num_ids, sizeof(block_info_t));
+    long size_hist[LOG_BUCKETS] = {0}, realloc_hist[LOG_BUCKETS] = {0};
+    long life_hist[LOG_BUCKETS] = {0}, chain_hist[LOG_BUCKETS] = {0};
+    int *sizes = (int *)xcalloc(trace->num_ops, sizeof(int));
+    double *growth = (double *)xcalloc(trace->num_ops, sizeof(double));
+    size_count_t *sc;
+    long classes[MAX_CLASSES], pow2[LOG_BUCKETS];
+    long nallocs = 0, nreallocs = 0, nfrees = 0, nsizes = 0, ngrowth = 0;
+    long shrinks = 0, lifo = 0, fifo = 0, ranked = 0;
+    long live_bytes = 0, live_blocks = 0, peak_bytes = 0, peak_blocks = 0;
+    long total_bytes = 0, small_bytes, waste, pow2_waste;
+    long small, mmap, split, above, nabove;
+    int peak_op = 0, seq = 0, oldest = 0, youngest;
+    int *seq_live, *stack, nstack = 0;
+    double rank_sum = 0;
+    int i, j, k, n, index, size;
+
+    fenwick_n = trace->num_ops;
+    fenwick = (long *)xcalloc(fenwick_n + 1, sizeof(long));
+    seq_live = (int *)xcalloc(trace->num_ops, sizeof(int));
+    stack = (int *)xcalloc(trace->num_ops, sizeof(int));
+
+    printf("%s: %d ops, %d ids\n", trace->trace_name, trace->num_ops,
+           trace->num_ids);
+    printf("\nLive set (payload bytes and blocks after the op):\n");
+    printf("  %10s %12s %10s\n", "op", "bytes", "blocks");
+    for (i = 0; i < trace->num_ops; i++) {
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        switch (trace->ops[i].type) {
+            case ALLOC:
+                nallocs++;
+                size_hist[log2_bucket(size)]++;
+                sizes[nsizes++] = size;
+                total_bytes += size;
+                info[index].alloc_op = i;
+                info[index].seq = seq;
+                info[index].size = size;
+                info[index].chain = 0;
+                seq_live[seq] = 1;
+                fenwick_add(seq, 1);
+                stack[nstack++] = seq++;
+                live_bytes += size;
+                live_blocks++;
+                break;
+
+            case REALLOC:
+                nreallocs++;
+                realloc_hist[log2_bucket(size)]++;
+                sizes[nsizes++] = size;
+                total_bytes += size;
+                if (info[index].size > 0)
+                    growth[ngrowth++] = (double)size / info[index].size;
+                if (size < info[index].size) shrinks++;
+                info[index].chain++;
+                live_bytes += size - info[index].size;
+                info[index].size = size;
+                break;
+
+            case FREE:
+                nfrees++;
+                life_hist[log2_bucket(i - info[index].alloc_op)]++;
+                if (info[index].chain > 0)
+                    chain_hist[log2_bucket(info[index].chain)]++;
+
+                /* where the block stands among the live ones by age */
+                while (!seq_live[oldest]) oldest++;
+                while (!seq_live[stack[nstack - 1]]) nstack--;
+                youngest = stack[nstack - 1];
+                if (info[index].seq == youngest) lifo++;
+                if (info[index].seq == oldest) fifo++;
+                if (live_blocks > 1) {
+                    /* older live blocks over all the others */
+                    rank_sum += (double)fenwick_prefix(info[index].seq) /
+                                (live_blocks - 1);
+                    ranked++;
+                }
+                seq_live[info[index].seq] = 0;
+                fenwick_add(info[index].seq, -1);
+                live_bytes -= info[index].size;
+                live_blocks--;
+                info[index].size = 0;
+                break;
+        }
+        if (live_bytes > peak_bytes) {
+            peak_bytes = live_bytes;
+            peak_blocks = live_blocks;
+            peak_op = i;
+        }
+        if ((long)(i + 1) * LIVE_POINTS / trace->num_ops !=
+            (long)i * LIVE_POINTS / trace->num_ops)
+            printf("  %10d %12ld %10ld\n", i, live_bytes, live_blocks);
+    }
+    printf("  peak %ld bytes in %ld blocks at op %d; %ld blocks never freed\n",
+           peak_bytes, peak_blocks, peak_op, live_blocks);
+
+    printf(
+        "\nRequests: %ld mallocs, %ld reallocs, %ld frees; %ld bytes "
+        "requested\n",
+        nallocs, nreallocs, nfrees, total_bytes);
+    printf("\nmalloc sizes:\n");
+    print_log2_hist("bytes", size_hist);
+    if (nreallocs > 0) {
+        printf("\nrealloc sizes:\n");
+        print_log2_hist("bytes", realloc_hist);
+    }
+    printf("\nLifetimes (ops from malloc to free):\n");
+    print_log2_hist("ops", life_hist);
+
+    printf("\nRealloc chains (reallocs per freed block that had any):\n");
+    print_log2_hist("reallocs", chain_hist);
+    if (ngrowth > 0) {
+        qsort(growth, ngrowth, sizeof(double), compare_doubles);
+        printf(
+            "  growth per realloc: median %.2fx, p10 %.2fx, p90 %.2fx; "
+            "%.1f%% shrink\n",
+            growth[ngrowth / 2], growth[ngrowth / 10], growth[ngrowth * 9 / 10],
+            100.0 * shrinks / ngrowth);
+    }
+
+    printf(
+        "\nFree order: %.1f%% LIFO (youngest live block), %.1f%% FIFO "
+        "(oldest);\n  mean age rank %.2f (0 = always LIFO, 1 = always "
+        "FIFO)\n",
+        nfrees ? 100.0 * lifo / nfrees : 0, nfrees ? 100.0 * fifo / nfrees : 0,
+        ranked ? 1 - rank_sum / ranked : 0);
+
+    /* Recommendations, from the sizes of all mallocs and reallocs */
+    printf("\nRecommendations:\n");
+    if (nsizes == 0) {
+        printf("  (no requests)\n");
+        goto done;
+    }
+    qsort(sizes, nsizes, sizeof(int), compare_ints);
+    profile_add(sizes, nsizes);
+    small = 1;
+    while (small < sizes[(long)((nsizes - 1) * SMALL_FRACTION)]) small <<= 1;
+    mmap = 1;
+    while (mmap < sizes[(long)((nsizes - 1) * MMAP_FRACTION)]) mmap <<= 1;
+    if (mmap < MMAP_MIN) mmap = MMAP_MIN;
+    for (above = nabove = 0, j = nsizes - 1; j >= 0 && sizes[j] >= mmap; j--) {
+        above += sizes[j];
+        nabove++;
+    }
+    split =
+        align_size(sizes[(long)((nsizes - 1) * SPLIT_FRACTION)]) + TAGS_SIZE;
+    if (split < (long)MINBLOCKSIZE) split = MINBLOCKSIZE;
+
+    /* the distinct aligned sizes up to the small-object threshold */
+    sc = (size_count_t *)xcalloc(nsizes, sizeof(size_count_t));
+    small_bytes = 0;
+    for (n = 0, j = 0; j < nsizes && sizes[j] <= small; j++) {
+        long a = align_size(sizes[j]);
+        if (n == 0 || sc[n - 1].size != a) {
+            sc[n].size = a;
+            sc[n].count = sc[n].bytes = 0;
+            n++;
+        }
+        sc[n - 1].count++;
+        sc[n - 1].bytes += sizes[j];
+        small_bytes += sizes[j];
+    }
+    if ((k = best_classes(sc, n, nclasses, classes)) < 0) {
+        fprintf(stderr, "mmanalyze: out of memory\n");
+        exit(1);
+    }
+    waste = class_waste(sc, n, classes, k);
+    for (i = 0, pow2[0] = ALIGNMENT; pow2[i] < sc[n - 1].size; i++)
+        pow2[i + 1] = 2 * pow2[i];
+    pow2_waste = class_waste(sc, n, pow2, i + 1);
+
+    printf("  small-object threshold: %ld bytes (%.1f%% of requests fit)\n",
+           small, 100.0 * j / nsizes);
+    printf("  %d size classes below it:", k);
+    for (i = 0; i < k; i++) printf("%s %ld", i % 10 ? "" : "\n   ", classes[i]);
+    printf(
+        "\n  they waste %.2f%% of the small bytes requested, against "
+        "%.2f%% for\n  power-of-two classes\n",
+        small_bytes ? 100.0 * waste / small_bytes : 0,
+        small_bytes ? 100.0 * pow2_waste / small_bytes : 0);
+    printf(
+        "  mmap threshold: %ld bytes (%.2f%% of requests, %.1f%% of "
+        "bytes, above it)\n",
+        mmap, 100.0 * nabove / nsizes,
+        total_bytes ? 100.0 * above / total_bytes : 0);
+    printf(
+        "  split threshold: split when the remainder is at least %ld "
+        "bytes,\n  which fits %.0f%% of requests (mm.c splits above "
+        "%zu)\n",
+        split, 100 * (1 - SPLIT_FRACTION), 16 * MINBLOCKSIZE);
+    free(sc);
+
+done:
+    free(info);
+    free(sizes);
+    free(growth);
+    free(fenwick);
+    free(seq_live);
+    free(stack);
+}
+
+/*****************************************************************
+ * The size profile (-w)
+ ****************************************************************/
+
+/*
+ * profile_add - add a trace's request sizes to the size profile
+ */
+static void profile_add(const int *sizes, long n) {
+    if (profile_n + n > profile_cap) {
+        profile_cap = 2 * (profile_n + n);
+        profile = (int *)realloc(profile, profile_cap * sizeof(int));
+        if (profile == NULL) {
+            fprintf(stderr, "mmanalyze: out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(profile + profile_n, sizes, n * sizeof(int));
+    profile_n += n;
+}
+
+/*
+ * profile_write - write the size profile to path, by block size
+ */
+static void profile_write(const char *path) {
+    FILE *f = fopen(path, "w");
+    long i, size, count, bytes;
+
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    qsort(profile, profile_n, sizeof(int), compare_ints);
+    fprintf(f, "# mmanalyze size profile: block size, requests, bytes\n");
+    for (i = 0; i < profile_n;) {
+        size = align_size(profile[i]) + TAGS_SIZE;
+        for (count = bytes = 0;
+             i < profile_n && align_size(profile[i]) + (long)TAGS_SIZE == size;
+             i++) {
+            count++;
+            bytes += profile[i];
+        }
+        fprintf(f, "%ld %ld %ld\n", size, count, bytes);
+    }
+    if (fclose(f) != 0) {
+        perror(path);
+        exit(1);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: mmanalyze [-h] [-c <classes>] [-w <profile>] "
+            "<trace>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr,
+            "\t-c <N>     Recommend at most N size classes (default %d).\n",
+            DEFAULT_CLASSES);
+    fprintf(stderr,
+            "\t-w <file>  Write the size profile of the traces (for "
+            "mkclasses).\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+}
+
+int main(int argc, char **argv) {
+    int nclasses = DEFAULT_CLASSES;
+    char *profile_path = NULL;
+    trace_t *trace;
+    int c, i;
+
+    while ((c = getopt(argc, argv, "hc:w:")) != EOF) {
+        switch (c) {
+            case 'c':
+                nclasses = atoi(optarg);
+                if (nclasses < 1 || nclasses > MAX_CLASSES) {
+                    fprintf(stderr, "mmanalyze: -c must be 1 to %d\n",
+                            MAX_CLASSES);
+                    exit(1);
+                }
+                break;
+            case 'w':
+                profile_path = optarg;
+                break;
+            case 'h':
+                usage();
+                exit(0);
+            default:
+                usage();
+                exit(1);
+        }
+    }
+    if (optind == argc) {
+        usage();
+        exit(1);
+    }
+    for (i = optind; i < argc; i++) {
+        trace = read_trace("", argv[i]);
+        if (i > optind) printf("\n\n");
+        analyze(trace, nclasses);
+        free_trace(trace);
+    }
+    if (profile_path) profile_write(profile_path);
+    return 0;
+}
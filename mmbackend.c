@@ -0,0 +1,52 @@
+/*
+ * mmbackend.c - registers mm.c as the backend "mm"
+ *
+ * Built with -D MM_VARIANT=v, it registers the mm.c variant mm-v.c
+ * instead, as the backend "v". The variant's global symbols have been
+ * prefixed with "v_" by the Makefile, so any number of variants link
+ * into one mdriver next to mm.c.
+ */
+#include "backend.h"
+
+#ifdef MM_VARIANT
+#define PASTE(v, f) v##_##f
+#define VARIANT_FN(v, f) PASTE(v, f)
+#define MM_FN(f) VARIANT_FN(MM_VARIANT, f)
+#define QUOTE(v) #v
+#define MM_NAME(v) QUOTE(v)
+
+int MM_FN(mm_init)(void);
+void *MM_FN(mm_malloc)(size_t size);
+void MM_FN(mm_free)(void *ptr);
+void *MM_FN(mm_realloc)(void *ptr, size_t size);
+void MM_FN(mm_stats)(struct mm_stats *stats);
+void MM_FN(mm_get_policy)(struct mm_policy *policy);
+int MM_FN(mm_set_policy)(const struct mm_policy *policy);
+
+static const backend_t mm_backend = {
+    MM_NAME(MM_VARIANT),
+    "mm.c variant mm-" MM_NAME(MM_VARIANT) ".c",
+    1,
+    MM_FN(mm_init),
+    MM_FN(mm_malloc),
+    MM_FN(mm_free),
+    MM_FN(mm_realloc),
+    MM_FN(mm_stats),
+    0,
+    MM_FN(mm_get_policy),
+    MM_FN(mm_set_policy)};
+#else
+static const backend_t mm_backend = {"mm",
+                                     "the explicit free list allocator in mm.c",
+                                     1,
+                                     mm_init,
+                                     mm_malloc,
+                                     mm_free,
+                                     mm_realloc,
+                                     mm_stats,
+                                     0,
+                                     mm_get_policy,
+                                     mm_set_policy};
+#endif
+
+BACKEND_REGISTER(mm_backend)
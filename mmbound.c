@@ -0,0 +1,72 @@
+/*
+ * mmbound - how close to full utilization could an allocator get on
+ *     these traces?
+ *
+ * Usage: mmbound [-h] <trace>...
+ *
+ * For each trace (of either format, see trace.h) this prints the peak
+ * live payload, which is what mdriver divides by the heap size to get the
+ * utilization, and then the heap that each of the policies in bound.h
+ * needed when placing the blocks with the whole trace in hand, with the
+ * utilization that heap would score.
+ *
+ * The best policy's utilization is the bound mdriver -U compares each
+ * allocator against: a trace where an allocator is well short of it has
+ * room to improve; one where the bound itself is low is hard for every
+ * allocator.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bound.h"
+#include "trace.h"
+
+int verbose = 0; /* read by trace.c */
+
+static void usage(void) {
+    fprintf(stderr, "Usage: mmbound [-h] <trace>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+}
+
+int main(int argc, char **argv) {
+    trace_t *trace;
+    bound_t b;
+    int c, i, p;
+
+    while ((c = getopt(argc, argv, "h")) != EOF) {
+        switch (c) {
+            case 'h':
+                usage();
+                exit(0);
+            default:
+                usage();
+                exit(1);
+        }
+    }
+    if (optind == argc) {
+        usage();
+        exit(1);
+    }
+
+    printf("%-24s %10s", "trace", "peak KB");
+    for (p = 0; p < BOUND_POLICIES; p++)
+        printf(" %10s %6s", bound_policy_names[p], "util");
+    printf("  best\n");
+    for (i = optind; i < argc; i++) {
+        trace = read_trace("", argv[i]);
+        if (trace_bound(trace, &b) < 0) {
+            fprintf(stderr, "mmbound: out of memory for %s\n", argv[i]);
+            exit(1);
+        }
+        printf("%-24s %10.1f", trace->trace_name, b.peak_live / 1024.0);
+        for (p = 0; p < BOUND_POLICIES; p++)
+            printf(" %10.1f %5.1f%%", b.heap[p] / 1024.0,
+                   b.heap[p] ? 100.0 * b.peak_live / b.heap[p] : 0);
+        printf("  %s\n", bound_policy_names[b.best]);
+        free_trace(trace);
+    }
+    printf("(heap sizes in KB)\n");
+    return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * mmguard.c - sampled guard-page allocations for catching heap overflows
+ *             and use-after-free bugs in production at negligible cost.
+ *
+ * The pool is one anonymous mapping laid out as
+ *
+ *     [guard][slot 0][guard][slot 1][guard] ... [slot N-1][guard]
+ *
+ * where every slot and every guard is a single page. Only slots that are
+ * currently allocated are readable and writable; everything else is
+ * PROT_NONE, so any stray access into the pool faults.
+ */
+#include "mmguard.h"
+
+#include <execinfo.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mm.h"
+
+typedef enum { SLOT_AVAILABLE, SLOT_ALLOCATED, SLOT_QUARANTINED } slot_state_t;
+
+// metadata for one guarded slot (kept outside the pool, so it survives
+// the slot being made PROT_NONE)
+typedef struct {
+    slot_state_t state;
+    char *ptr;    // payload handed out to the caller
+    size_t size;  // requested payload size
+    int alloc_frames;
+    int free_frames;
+    void *alloc_trace[GUARD_MAX_FRAMES];
+    void *free_trace[GUARD_MAX_FRAMES];
+} guard_slot_t;
+
+size_t guard_countdown = SIZE_MAX;
+char *guard_pool_lo = NULL;
+char *guard_pool_hi = NULL;
+
+static unsigned guard_rate = GUARD_SAMPLE_RATE;
+static size_t guard_page;
+static guard_slot_t guard_slots[GUARD_NUM_SLOTS];
+// stack of available slot indices
+static int guard_avail[GUARD_NUM_SLOTS];
+static int guard_num_avail;
+// FIFO of quarantined slot indices
+static int guard_quarantine[GUARD_QUARANTINE];
+static int guard_q_head;
+static int guard_q_len;
+// alternates left/right alignment so both under- and overflows are caught
+static unsigned guard_flip;
+static unsigned long guard_rng = 88172645463325252UL;
+static struct sigaction guard_prev_segv;
+
+static void guard_handler(int sig, siginfo_t *info, void *uctx);
+
+// returns the next interval between samples, uniform on [1, 2 * rate - 1] so
+// that the mean is 'rate' but the sampled calls are not periodic
+static size_t next_countdown(void) {
+    if (guard_rate == 0) {
+        return SIZE_MAX;
+    }
+    guard_rng ^= guard_rng << 13;
+    guard_rng ^= guard_rng >> 7;
+    guard_rng ^= guard_rng << 17;
+    return 1 + guard_rng % (2 * (size_t)guard_rate - 1);
+}
+
+// returns the address of the data page of slot i
+static inline char *slot_page(int i) {
+    return guard_pool_lo + (2 * (size_t)i + 1) * guard_page;
+}
+
+// maps the pool and installs the fault handler; returns 0 on success
+static int guard_map_pool(void) {
+    struct sigaction sa;
+    size_t len;
+    char *pool;
+
+    guard_page = (size_t)getpagesize();
+    len = (2 * (size_t)GUARD_NUM_SLOTS + 1) * guard_page;
+    pool = mmap(NULL, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED) {
+        return -1;
+    }
+    guard_pool_lo = pool;
+    guard_pool_hi = pool + len;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = guard_handler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, &guard_prev_segv);
+    mm_guard_reset();
+    return 0;
+}
+
+void mm_guard_set_sample_rate(unsigned rate) {
+    guard_rate = rate;
+    if (rate != 0 && guard_pool_lo == NULL && guard_map_pool() < 0) {
+        fprintf(stderr, "mm_guard: could not map guarded pool\n");
+        guard_rate = 0;
+    }
+    guard_countdown = next_countdown();
+}
+
+unsigned mm_guard_sample_rate(void) { return guard_rate; }
+
+void mm_guard_reset(void) {
+    int i;
+    guard_countdown = next_countdown();
+    if (guard_pool_lo == NULL) {
+        // sampling at the default rate maps the pool on first use
+        if (guard_rate != 0 && guard_map_pool() < 0) {
+            guard_rate = 0;
+            guard_countdown = next_countdown();
+        }
+        return;
+    }
+    mprotect(guard_pool_lo, guard_pool_hi - guard_pool_lo, PROT_NONE);
+    for (i = 0; i < GUARD_NUM_SLOTS; i++) {
+        guard_slots[i].state = SLOT_AVAILABLE;
+        // hand out low slots first
+        guard_avail[i] = GUARD_NUM_SLOTS - 1 - i;
+    }
+    guard_num_avail = GUARD_NUM_SLOTS;
+    guard_q_head = 0;
+    guard_q_len = 0;
+}
+
+void *mm_guard_malloc(size_t size) {
+    guard_slot_t *slot;
+    char *page;
+    int i;
+
+    guard_countdown = next_countdown();
+    if (size == 0 || size > guard_page || guard_num_avail == 0) {
+        return NULL;
+    }
+    i = guard_avail[--guard_num_avail];
+    slot = &guard_slots[i];
+    page = slot_page(i);
+    if (mprotect(page, guard_page, PROT_READ | PROT_WRITE) < 0) {
+        guard_avail[guard_num_avail++] = i;
+        return NULL;
+    }
+    // right-align against the following guard page on every other sample
+    // (rounded down to ALIGNMENT, so up to ALIGNMENT - 1 bytes of slack)
+    if (guard_flip++ & 1) {
+        slot->ptr = page + ((guard_page - size) & ~(size_t)(ALIGNMENT - 1));
+    } else {
+        slot->ptr = page;
+    }
+    slot->size = size;
+    slot->state = SLOT_ALLOCATED;
+    slot->alloc_frames = backtrace(slot->alloc_trace, GUARD_MAX_FRAMES);
+    slot->free_frames = 0;
+    return slot->ptr;
+}
+
+// returns the index of the slot whose data page contains addr, or -1 if
+// addr lies on a guard page
+static int slot_of(const char *addr) {
+    size_t page = (size_t)(addr - guard_pool_lo) / guard_page;
+    return (page & 1) ? (int)(page / 2) : -1;
+}
+
+void mm_guard_free(void *ptr) {
+    int i = slot_of(ptr);
+    guard_slot_t *slot = &guard_slots[i < 0 ? 0 : i];
+
+    if (i >= 0 && slot->state == SLOT_ALLOCATED && slot->ptr != ptr) {
+        // a pointer into the middle of a live block: its slot is writable,
+        // so there is no fault to report it from
+        fprintf(stderr,
+                "mm_guard: invalid free of %p (inside %zu-byte block at %p)\n",
+                ptr, slot->size, (void *)slot->ptr);
+        fprintf(stderr, "allocated at:\n");
+        backtrace_symbols_fd(slot->alloc_trace, slot->alloc_frames,
+                             STDERR_FILENO);
+        abort();
+    }
+    if (i < 0 || slot->state != SLOT_ALLOCATED) {
+        // double or invalid free; make the report from the fault handler's
+        // point of view by touching the (protected) slot
+        fprintf(stderr, "mm_guard: invalid free of %p\n", ptr);
+        *(volatile char *)ptr = 0;
+        return;
+    }
+    slot->free_frames = backtrace(slot->free_trace, GUARD_MAX_FRAMES);
+    slot->state = SLOT_QUARANTINED;
+    mprotect(slot_page(i), guard_page, PROT_NONE);
+
+    // the oldest quarantined slot becomes available once the queue is full
+    if (guard_q_len == GUARD_QUARANTINE) {
+        int old = guard_quarantine[guard_q_head];
+        guard_slots[old].state = SLOT_AVAILABLE;
+        guard_avail[guard_num_avail++] = old;
+        guard_q_head = (guard_q_head + 1) % GUARD_QUARANTINE;
+        guard_q_len--;
+    }
+    guard_quarantine[(guard_q_head + guard_q_len) % GUARD_QUARANTINE] = i;
+    guard_q_len++;
+}
+
+size_t mm_guard_size(void *ptr) {
+    int i = slot_of(ptr);
+
+    if (i < 0 || guard_slots[i].state != SLOT_ALLOCATED) {
+        // on a guard page, or a block that is not live: mm_guard_free will
+        // make the report
+        fprintf(stderr, "mm_guard: invalid pointer %p\n", ptr);
+        return 0;
+    }
+    return guard_slots[i].size;
+}
+
+// writes a message to stderr without going through stdio (which is not safe
+// to use from a signal handler)
+static void guard_write(const char *s) {
+    ssize_t ret = write(STDERR_FILENO, s, strlen(s));
+    (void)ret;
+}
+
+// reports the slot involved in a fault at addr and re-raises it
+static void guard_handler(int sig, siginfo_t *info, void *uctx) {
+    char *addr = info->si_addr;
+    char line[256];
+    int i;
+
+    (void)uctx;
+    if (!mm_guard_owns(addr)) {
+        // not ours: hand the fault to whoever was installed before us
+        sigaction(sig, &guard_prev_segv, NULL);
+        return;
+    }
+
+    i = slot_of(addr);
+    if (i >= 0 && guard_slots[i].state == SLOT_QUARANTINED) {
+        snprintf(line, sizeof(line),
+                 "mm_guard: use-after-free at %p (%zu-byte block at %p)\n",
+                 (void *)addr, guard_slots[i].size, (void *)guard_slots[i].ptr);
+    } else {
+        // a guard page (or an unused slot): blame the nearest allocation
+        int left = (int)((size_t)(addr - guard_pool_lo) / guard_page / 2) - 1;
+        int right = left + 1;
+        if (right < GUARD_NUM_SLOTS &&
+            guard_slots[right].state == SLOT_ALLOCATED) {
+            i = right;
+        } else if (left >= 0 && guard_slots[left].state == SLOT_ALLOCATED) {
+            i = left;
+        } else {
+            i = -1;
+        }
+        if (i >= 0) {
+            snprintf(line, sizeof(line),
+                     "mm_guard: buffer %s at %p (%zu-byte block at %p)\n",
+                     addr < guard_slots[i].ptr ? "underflow" : "overflow",
+                     (void *)addr, guard_slots[i].size,
+                     (void *)guard_slots[i].ptr);
+        } else {
+            snprintf(line, sizeof(line),
+                     "mm_guard: wild access at %p in guarded pool\n",
+                     (void *)addr);
+        }
+    }
+    guard_write(line);
+    if (i >= 0) {
+        guard_write("allocated at:\n");
+        backtrace_symbols_fd(guard_slots[i].alloc_trace,
+                             guard_slots[i].alloc_frames, STDERR_FILENO);
+        if (guard_slots[i].free_frames > 0) {
+            guard_write("freed at:\n");
+            backtrace_symbols_fd(guard_slots[i].free_trace,
+                                 guard_slots[i].free_frames, STDERR_FILENO);
+        }
+    }
+    // returning re-executes the faulting access with the default action
+    signal(sig, SIG_DFL);
+}
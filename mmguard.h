@@ -0,0 +1,64 @@
+#ifndef MMGUARD_H_
+#define MMGUARD_H_
+
+#include <stddef.h>
+
+// Sampled guard-page allocations, in the spirit of GWP-ASan.
+//
+// Roughly one in every GUARD_SAMPLE_RATE calls to mm_malloc is served from a
+// separate pool of page-sized slots, each of which is surrounded by
+// PROT_NONE guard pages. When such a block is freed its slot is made
+// PROT_NONE as well and parked in a quarantine, so that both overflows and
+// use-after-free bugs fault. The SIGSEGV handler installed by this module
+// reports the allocation (and free) backtraces of the offending slot before
+// letting the process die.
+
+// default sampling interval (1 in N calls); 0 disables sampling
+#define GUARD_SAMPLE_RATE 5000
+// number of guarded slots in the pool
+#define GUARD_NUM_SLOTS 256
+// number of freed slots that stay PROT_NONE before one may be reused
+#define GUARD_QUARANTINE 64
+// number of stack frames recorded per allocation and free
+#define GUARD_MAX_FRAMES 16
+
+// counts down to the next sampled allocation (see mm_guard_should_sample)
+extern size_t guard_countdown;
+// bounds of the guarded pool; both are NULL until the pool is mapped
+extern char *guard_pool_lo;
+extern char *guard_pool_hi;
+
+// sets the sampling interval to 1 in 'rate' allocations (0 disables)
+void mm_guard_set_sample_rate(unsigned rate);
+
+// returns the sampling interval set last
+unsigned mm_guard_sample_rate(void);
+
+// returns every slot to the available state (called from mm_init)
+void mm_guard_reset(void);
+
+// serves a sampled allocation of 'size' bytes from the pool; returns NULL
+// (and the caller falls back to the normal path) if the request does not
+// fit in a slot or no slot is available
+void *mm_guard_malloc(size_t size);
+
+// frees a block returned by mm_guard_malloc and quarantines its slot
+void mm_guard_free(void *ptr);
+
+// returns the requested size of a block returned by mm_guard_malloc, or 0
+// (with a message) if ptr is not a live one
+size_t mm_guard_size(void *ptr);
+
+// returns 1 once every GUARD_SAMPLE_RATE calls, 0 otherwise. This is the only
+// cost paid by unsampled allocations: one decrement and one branch.
+static inline int mm_guard_should_sample(void) {
+    return __builtin_expect(--guard_countdown == 0, 0);
+}
+
+// returns 1 if ptr was handed out by the guarded pool, 0 otherwise
+static inline int mm_guard_owns(const void *ptr) {
+    return (const char *)ptr >= guard_pool_lo &&
+           (const char *)ptr < guard_pool_hi;
+}
+
+#endif  // MMGUARD_H_
@@ -7,6 +7,8 @@
 // #include "mminline-unit-tests.h"
 #include "mminline.h"
 #include "mm.h"
+#include "range.h"
+#include "trace.h"
 
 #define USAGE                                                            \
     "./run_tests <all | "                                                \
@@ -14,7 +16,8 @@
     "\n   Ex. \"./inline_tests all\" runs all tests"                        \
     "\n   Ex. \"./inline_tests set_flink set_blink\" runs the set_flink and set_blink " \
     "\n   Ex. \"./inline_tests pull_free_block\" runs the pull_free_block test" \
-    "\n   Possible tests: 'set_flink', 'set_blink', 'pull_free_block'"
+    "\n   Possible tests: 'set_flink', 'set_blink', 'pull_free_block', "        \
+    "'trace_round_trip', 'range_treap', 'set_policy', 'repl'"
 
 void assert_flink(block_t *expected, block_t *actual, const char *message);
 
@@ -25,8 +28,7 @@ void assert_pull_free_block(block_t *expected, block_t *actual, const char *mess
 void print_test_summary();
 
 static block_t *flist_first;
-block_t* prologue;
-block_t* epilogue;
+int verbose = 0; // read by trace.c
 
 void set_flink_test() { 
     prologue = malloc(16);
@@ -107,6 +109,170 @@ void pull_free_block_test() {
     free(block_three);
 }
 
+// writes the trace to a temporary file in the text or the binary format,
+// and reads it back with read_trace
+static trace_t *reread_trace(trace_t *trace, int binary) {
+    char path[] = "/tmp/inline_tests.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    FILE *f = fdopen(fd, "w");
+    assert(f != NULL);
+    assert((binary ? write_trace_bin(trace, f) : write_trace_rep(trace, f)) == 0);
+    assert(fclose(f) == 0);
+    trace_t *copy = read_trace("", path);
+    unlink(path);
+    return copy;
+}
+
+void trace_round_trip_test() {
+    traceop_t ops[] = {{ALLOC, 0, 24}, {ALLOC, 1, 4000}, {REALLOC, 0, 100},
+                       {FREE, 1, 0}, {ALLOC, 2, 0}, {FREE, 0, 0}, {FREE, 2, 0}};
+    trace_t trace;
+    memset(&trace, 0, sizeof(trace));
+    trace.sugg_heapsize = 20000;
+    trace.num_ids = 3;
+    trace.num_ops = sizeof(ops) / sizeof(ops[0]);
+    trace.weight = 1;
+    trace.ops = ops;
+
+    for (int binary = 0; binary <= 1; binary++) {
+        trace_t *copy = reread_trace(&trace, binary);
+        assert(copy->sugg_heapsize == trace.sugg_heapsize);
+        assert(copy->num_ids == trace.num_ids);
+        assert(copy->num_ops == trace.num_ops);
+        assert(copy->weight == trace.weight);
+        for (int i = 0; i < trace.num_ops; i++) {
+            assert(copy->ops[i].type == ops[i].type);
+            assert(copy->ops[i].index == ops[i].index);
+            assert(ops[i].type == FREE || copy->ops[i].size == ops[i].size);
+        }
+        free_trace(copy);
+    }
+}
+
+// checks that the treap rooted at t is a search tree on lo, with every lo
+// in [min, max), and a heap on prio; returns the number of ranges in it
+static int treap_check(range_t *t, char *min, char *max) {
+    if (t == NULL) {
+        return 0;
+    }
+    assert(t->lo >= min && t->lo < max && t->hi >= t->lo);
+    assert(t->left == NULL || t->left->prio <= t->prio);
+    assert(t->right == NULL || t->right->prio <= t->prio);
+    return 1 + treap_check(t->left, min, t->lo) + treap_check(t->right, t->lo, max);
+}
+
+void range_treap_test() {
+    static char heap[64 * 32];
+    range_t *ranges = NULL;
+    int i, n = 64;
+
+    // 64 blocks of 16 bytes, 32 apart, added in a scrambled order
+    assert(find_range(ranges, heap, heap + 15) == NULL);
+    for (i = 0; i < n; i++) {
+        char *lo = heap + (i * 37 % n) * 32;
+        assert(insert_range(&ranges, lo, lo + 15) == 0);
+    }
+    assert(treap_check(ranges, heap, heap + sizeof(heap)) == n);
+
+    // any byte of a block overlaps it, and the gaps overlap nothing
+    for (i = 0; i < n; i++) {
+        char *lo = heap + i * 32;
+        assert(find_range(ranges, lo, lo)->lo == lo);
+        assert(find_range(ranges, lo + 15, lo + 20)->lo == lo);
+        assert(i == 0 || find_range(ranges, lo - 8, lo)->lo == lo);
+        assert(find_range(ranges, lo + 16, lo + 31) == NULL);
+    }
+    assert(find_range(ranges, heap + 16, heap + 64)->lo == heap + 32);
+
+    // removing the odd blocks frees their extents, and nothing else
+    remove_range(&ranges, heap + 1);  // not the start of a block
+    for (i = 1; i < n; i += 2) {
+        remove_range(&ranges, heap + i * 32);
+    }
+    assert(treap_check(ranges, heap, heap + sizeof(heap)) == n / 2);
+    for (i = 0; i < n; i++) {
+        range_t *p = find_range(ranges, heap + i * 32 + 8, heap + i * 32 + 8);
+        assert(i % 2 ? p == NULL : p->lo == heap + i * 32);
+    }
+    assert(find_range(ranges, heap + 16, heap + 63) == NULL);
+
+    clear_ranges(&ranges);
+    assert(ranges == NULL);
+}
+
+// checks that two policies have the same knobs
+static void assert_same_policy(const struct mm_policy *a, const struct mm_policy *b) {
+    assert(a->split_min == b->split_min);
+    assert(a->realloc_split_div == b->realloc_split_div);
+    assert(a->grow_chunk == b->grow_chunk);
+    assert(a->placement == b->placement);
+    assert(a->nclasses == b->nclasses);
+    for (int i = 0; i < a->nclasses; i++) {
+        assert(a->classes[i] == b->classes[i]);
+    }
+}
+
+// checks that mm_set_policy refuses p, and keeps the policy it had
+static void assert_refused(const struct mm_policy *p) {
+    struct mm_policy before, after;
+    mm_get_policy(&before);
+    assert(mm_set_policy(p) == -1);
+    mm_get_policy(&after);
+    assert_same_policy(&before, &after);
+}
+
+void set_policy_test() {
+    struct mm_policy old, p, q, got;
+    mm_get_policy(&old);
+    assert(mm_set_policy(&old) == 0);
+
+    // every knob changed, to the edges of what is valid
+    p = old;
+    p.split_min = MINBLOCKSIZE;
+    p.realloc_split_div = 1;
+    p.grow_chunk = 4096;
+    p.placement = MM_PLACE_ADDRESS;
+    p.nclasses = 3;
+    p.classes[0] = MINBLOCKSIZE;
+    p.classes[1] = 64;
+    p.classes[2] = MM_MAX_CLASS_SIZE;
+    assert(mm_set_policy(&p) == 0);
+    mm_get_policy(&got);
+    assert_same_policy(&got, &p);
+
+    // one bad knob at a time
+    q = p; q.split_min = MINBLOCKSIZE - ALIGNMENT; assert_refused(&q);
+    q = p; q.realloc_split_div = 0; assert_refused(&q);
+    q = p; q.grow_chunk = 4096 + 4; assert_refused(&q);
+    q = p; q.placement = MM_PLACE_ADDRESS + 1; assert_refused(&q);
+    q = p; q.nclasses = -1; assert_refused(&q);
+    q = p; q.nclasses = MM_MAX_CLASSES + 1; assert_refused(&q);
+    q = p; q.classes[0] = MINBLOCKSIZE - ALIGNMENT; assert_refused(&q);
+    q = p; q.classes[1] = 60; assert_refused(&q);  // not aligned
+    q = p; q.classes[1] = MINBLOCKSIZE; assert_refused(&q);  // not increasing
+    q = p; q.classes[2] = MM_MAX_CLASS_SIZE + ALIGNMENT; assert_refused(&q);
+
+    assert(mm_set_policy(&old) == 0);
+}
+
+// runs a short session in the malloc REPL of ./mdriver (built alongside
+// this test), which must get through every command and exit cleanly
+void repl_test() {
+    FILE *repl = popen("./mdriver -r >/dev/null", "w");
+    assert(repl != NULL);
+    fprintf(repl, "malloc 0 100\nmalloc 1 40\nprint\nprint -f\nprint -b 0\n"
+                  "realloc 0 300\nfree 1\nfree 0\nquit\n");
+    int status = pclose(repl);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // -r drives mm only, since it prints mm.c's heap
+    repl = popen("./mdriver -b libc -r >/dev/null 2>&1", "w");
+    assert(repl != NULL);
+    status = pclose(repl);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 1);
+}
+
 int total_tests, num_correct, num_incorrect;
 int run_test_in_separate_process(void (*func)(), int num_tests, const char *message) {
     printf("running test: ");
@@ -124,6 +290,10 @@ void foreach_test(int num_tests, char const *test_names[],
         functions_passed += wrapper(&set_blink_test,5, "set_blink");
         functions_passed += wrapper(&set_flink_test, 6, "set_flink");
         functions_passed += wrapper(&pull_free_block_test, 4, "pull_free_block");
+        functions_passed += wrapper(&trace_round_trip_test, 7, "trace_round_trip");
+        functions_passed += wrapper(&range_treap_test, 5, "range_treap");
+        functions_passed += wrapper(&set_policy_test, 5, "set_policy");
+        functions_passed += wrapper(&repl_test, 4, "repl");
         return;
     }
 
@@ -138,6 +308,14 @@ void foreach_test(int num_tests, char const *test_names[],
             functions_passed += wrapper(&set_flink_test, 6, "set_flink");
         else if (!strcmp(test_name, "pull_free_block"))
             functions_passed += wrapper(&pull_free_block_test, 4, "pull_free_block");
+        else if (!strcmp(test_name, "trace_round_trip"))
+            functions_passed += wrapper(&trace_round_trip_test, 7, "trace_round_trip");
+        else if (!strcmp(test_name, "range_treap"))
+            functions_passed += wrapper(&range_treap_test, 5, "range_treap");
+        else if (!strcmp(test_name, "set_policy"))
+            functions_passed += wrapper(&set_policy_test, 5, "set_policy");
+        else if (!strcmp(test_name, "repl"))
+            functions_passed += wrapper(&repl_test, 4, "repl");
         else if (sscanf(test_name, "%d", &dummy) != 1)
             printf("Unknown test: %s\n", test_name);
     }
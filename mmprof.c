@@ -0,0 +1,300 @@
+/*
+ * mmprof.c - sampling heap profiler with call-site attribution.
+ *
+ * Two tables are kept, both outside the simulated heap:
+ *   - the stack table, which interns every distinct sampled backtrace and
+ *     accumulates its live and cumulative object and byte counts;
+ *   - the sample table, an open-addressed hash from sampled payload address
+ *     to (stack, size), so that mm_free can retire live bytes.
+ */
+#include "mmprof.h"
+
+#include <execinfo.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One interned backtrace and its counters
+typedef struct {
+    int nframes;
+    void *frames[PROF_MAX_FRAMES];
+    size_t live_objs, live_bytes;    // sampled and not yet freed
+    size_t alloc_objs, alloc_bytes;  // sampled since the last reset
+} prof_stack_t;
+
+// One live sampled allocation
+typedef struct {
+    void *ptr;  // payload, NULL if the slot is empty
+    size_t size;
+    int stack;  // index into prof_stacks
+} prof_sample_t;
+
+long prof_countdown = LONG_MAX;
+size_t prof_num_live = 0;
+
+static size_t prof_interval = 0;
+static unsigned long prof_rng = 2463534242UL;
+
+static prof_stack_t *prof_stacks;
+static int prof_num_stacks;
+static int prof_cap_stacks;
+static int *prof_stack_index;  // open-addressed: hash -> stack + 1
+static size_t prof_stack_index_cap;
+
+static prof_sample_t *prof_samples;
+static size_t prof_samples_cap;
+
+// returns the next sampling interval, exponential with mean prof_interval
+static long next_countdown(void) {
+    double u;
+    if (prof_interval == 0) {
+        return LONG_MAX;
+    }
+    prof_rng ^= prof_rng << 13;
+    prof_rng ^= prof_rng >> 7;
+    prof_rng ^= prof_rng << 17;
+    // uniform on (0, 1], so log(u) is finite
+    u = ((prof_rng >> 11) + 1) * (1.0 / 9007199254740992.0);
+    return (long)(-log(u) * prof_interval) + 1;
+}
+
+static inline size_t hash_ptr(const void *p) {
+    uintptr_t x = (uintptr_t)p;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdUL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+static size_t hash_frames(void **frames, int n) {
+    size_t h = 14695981039346656037UL;
+    int i;
+    for (i = 0; i < n; i++) {
+        h = (h ^ (uintptr_t)frames[i]) * 1099511628211UL;
+    }
+    return h;
+}
+
+void mm_prof_set_interval(size_t bytes) {
+    prof_interval = bytes;
+    prof_countdown = next_countdown();
+}
+
+void mm_prof_reset(void) {
+    free(prof_stacks);
+    free(prof_stack_index);
+    free(prof_samples);
+    prof_stacks = NULL;
+    prof_stack_index = NULL;
+    prof_samples = NULL;
+    prof_num_stacks = prof_cap_stacks = 0;
+    prof_stack_index_cap = prof_samples_cap = 0;
+    prof_num_live = 0;
+    prof_countdown = next_countdown();
+}
+
+// rebuilds the stack index with room for 2 * cap stacks
+static void grow_stack_index(void) {
+    size_t cap = prof_stack_index_cap ? 2 * prof_stack_index_cap : 64;
+    int *index = calloc(cap, sizeof(int));
+    int i;
+    if (index == NULL) {
+        return;
+    }
+    for (i = 0; i < prof_num_stacks; i++) {
+        size_t h = hash_frames(prof_stacks[i].frames, prof_stacks[i].nframes) &
+                   (cap - 1);
+        while (index[h] != 0) {
+            h = (h + 1) & (cap - 1);
+        }
+        index[h] = i + 1;
+    }
+    free(prof_stack_index);
+    prof_stack_index = index;
+    prof_stack_index_cap = cap;
+}
+
+// returns the index of the interned stack, or -1 if out of memory
+static int intern_stack(void **frames, int n) {
+    size_t h;
+    prof_stack_t *s;
+
+    if (2 * (size_t)(prof_num_stacks + 1) > prof_stack_index_cap) {
+        grow_stack_index();
+        if (2 * (size_t)(prof_num_stacks + 1) > prof_stack_index_cap) {
+            return -1;
+        }
+    }
+    h = hash_frames(frames, n) & (prof_stack_index_cap - 1);
+    while (prof_stack_index[h] != 0) {
+        s = &prof_stacks[prof_stack_index[h] - 1];
+        if (s->nframes == n && !memcmp(s->frames, frames, n * sizeof(void *))) {
+            return prof_stack_index[h] - 1;
+        }
+        h = (h + 1) & (prof_stack_index_cap - 1);
+    }
+
+    if (prof_num_stacks == prof_cap_stacks) {
+        int cap = prof_cap_stacks ? 2 * prof_cap_stacks : 64;
+        s = realloc(prof_stacks, cap * sizeof(prof_stack_t));
+        if (s == NULL) {
+            return -1;
+        }
+        prof_stacks = s;
+        prof_cap_stacks = cap;
+    }
+    s = &prof_stacks[prof_num_stacks];
+    memset(s, 0, sizeof(*s));
+    s->nframes = n;
+    memcpy(s->frames, frames, n * sizeof(void *));
+    prof_stack_index[h] = ++prof_num_stacks;
+    return prof_num_stacks - 1;
+}
+
+// inserts a sample into the table (which must have a free slot)
+static void insert_sample(prof_sample_t *table, size_t cap,
+                          const prof_sample_t *sample) {
+    size_t h = hash_ptr(sample->ptr) & (cap - 1);
+    while (table[h].ptr != NULL) {
+        h = (h + 1) & (cap - 1);
+    }
+    table[h] = *sample;
+}
+
+// doubles the sample table; returns 0 on success
+static int grow_samples(void) {
+    size_t cap = prof_samples_cap ? 2 * prof_samples_cap : 256;
+    prof_sample_t *table = calloc(cap, sizeof(prof_sample_t));
+    size_t i;
+    if (table == NULL) {
+        return -1;
+    }
+    for (i = 0; i < prof_samples_cap; i++) {
+        if (prof_samples[i].ptr != NULL) {
+            insert_sample(table, cap, &prof_samples[i]);
+        }
+    }
+    free(prof_samples);
+    prof_samples = table;
+    prof_samples_cap = cap;
+    return 0;
+}
+
+void mm_prof_record(void *ptr, size_t size) {
+    void *frames[PROF_MAX_FRAMES + 1];
+    prof_sample_t sample;
+    prof_stack_t *s;
+    int n;
+
+    prof_countdown = next_countdown();
+    if (ptr == NULL) {
+        return;
+    }
+    // drop our own frame; the caller (mm_malloc) identifies the API
+    n = backtrace(frames, PROF_MAX_FRAMES + 1) - 1;
+    if ((sample.stack = intern_stack(frames + 1, n)) < 0) {
+        return;
+    }
+    if (2 * (prof_num_live + 1) > prof_samples_cap && grow_samples() < 0) {
+        return;
+    }
+    sample.ptr = ptr;
+    sample.size = size;
+    insert_sample(prof_samples, prof_samples_cap, &sample);
+    prof_num_live++;
+
+    s = &prof_stacks[sample.stack];
+    s->live_objs++;
+    s->live_bytes += size;
+    s->alloc_objs++;
+    s->alloc_bytes += size;
+}
+
+// returns the slot of ptr in the sample table, or -1 if it was not sampled
+static long find_sample(void *ptr) {
+    size_t mask = prof_samples_cap - 1;
+    size_t h = hash_ptr(ptr) & mask;
+
+    while (prof_samples[h].ptr != ptr) {
+        if (prof_samples[h].ptr == NULL) {
+            return -1;
+        }
+        h = (h + 1) & mask;
+    }
+    return (long)h;
+}
+
+void mm_prof_forget(void *ptr) {
+    size_t mask = prof_samples_cap - 1;
+    long slot = find_sample(ptr);
+    size_t h, j;
+    prof_stack_t *s;
+
+    if (slot < 0) {
+        return;  // not sampled
+    }
+    h = (size_t)slot;
+    s = &prof_stacks[prof_samples[h].stack];
+    s->live_objs--;
+    s->live_bytes -= prof_samples[h].size;
+    prof_num_live--;
+
+    // backward-shift deletion keeps linear probing tombstone-free
+    for (j = (h + 1) & mask; prof_samples[j].ptr != NULL; j = (j + 1) & mask) {
+        size_t home = hash_ptr(prof_samples[j].ptr) & mask;
+        if (((j - home) & mask) >= ((j - h) & mask)) {
+            prof_samples[h] = prof_samples[j];
+            h = j;
+        }
+    }
+    prof_samples[h].ptr = NULL;
+}
+
+void mm_prof_resize(void *ptr, size_t size) {
+    long slot = find_sample(ptr);
+    prof_stack_t *s;
+
+    if (slot < 0) {
+        return;  // not sampled
+    }
+    s = &prof_stacks[prof_samples[slot].stack];
+    s->live_bytes = s->live_bytes - prof_samples[slot].size + size;
+    prof_samples[slot].size = size;
+}
+
+int mm_prof_dump(FILE *f) {
+    size_t live_objs = 0, live_bytes = 0, alloc_objs = 0, alloc_bytes = 0;
+    FILE *maps;
+    char line[1024];
+    int i, j;
+
+    for (i = 0; i < prof_num_stacks; i++) {
+        live_objs += prof_stacks[i].live_objs;
+        live_bytes += prof_stacks[i].live_bytes;
+        alloc_objs += prof_stacks[i].alloc_objs;
+        alloc_bytes += prof_stacks[i].alloc_bytes;
+    }
+    fprintf(f, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", live_objs,
+            live_bytes, alloc_objs, alloc_bytes, prof_interval);
+    for (i = 0; i < prof_num_stacks; i++) {
+        prof_stack_t *s = &prof_stacks[i];
+        fprintf(f, "%zu: %zu [%zu: %zu] @", s->live_objs, s->live_bytes,
+                s->alloc_objs, s->alloc_bytes);
+        for (j = 0; j < s->nframes; j++) {
+            fprintf(f, " %p", s->frames[j]);
+        }
+        fprintf(f, "\n");
+    }
+
+    // pprof needs the mappings to symbolize the addresses
+    fprintf(f, "\nMAPPED_LIBRARIES:\n");
+    if ((maps = fopen("/proc/self/maps", "r")) != NULL) {
+        while (fgets(line, sizeof(line), maps) != NULL) {
+            fputs(line, f);
+        }
+        fclose(maps);
+    }
+    return ferror(f) ? -1 : 0;
+}
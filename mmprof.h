@@ -0,0 +1,50 @@
+#ifndef MMPROF_H_
+#define MMPROF_H_
+
+#include <stdio.h>
+
+// Sampling heap profiler.
+//
+// Allocations are sampled on a byte-count countdown whose intervals are
+// drawn from an exponential distribution with mean PROF_SAMPLE_BYTES, so
+// every allocated byte has the same chance of being sampled. Sampled
+// allocations record a short backtrace in a side table keyed by payload,
+// and mm_prof_dump writes the live and cumulative bytes per stack in the
+// legacy pprof heap profile format ("heap_v2"), which pprof un-samples.
+
+// default mean number of bytes between samples
+#define PROF_SAMPLE_BYTES (512 * 1024)
+// number of stack frames recorded per sampled allocation
+#define PROF_MAX_FRAMES 16
+
+// bytes left until the next sampled allocation
+extern long prof_countdown;
+// number of sampled allocations that have not been freed yet
+extern size_t prof_num_live;
+
+// sets the mean sampling interval to 'bytes' (0 disables the profiler)
+void mm_prof_set_interval(size_t bytes);
+
+// discards all samples (called from mm_init, since the heap is reset)
+void mm_prof_reset(void);
+
+// records a sampled allocation of 'size' bytes at payload ptr
+void mm_prof_record(void *ptr, size_t size);
+
+// removes ptr from the live set if it was sampled
+void mm_prof_forget(void *ptr);
+
+// updates the live bytes of ptr, if it was sampled, after a realloc resized
+// it in place; the bytes stay with the call site that allocated it
+void mm_prof_resize(void *ptr, size_t size);
+
+// writes a pprof-compatible heap profile to f; returns 0 on success
+int mm_prof_dump(FILE *f);
+
+// returns 1 if an allocation of 'size' bytes should be sampled. This is the
+// only cost paid by unsampled allocations: one decrement and one branch.
+static inline int mm_prof_should_sample(size_t size) {
+    return __builtin_expect((prof_countdown -= (long)size) < 0, 0);
+}
+
+#endif  // MMPROF_H_
@@ -0,0 +1,727 @@
+/*
+ * mmrecord.c - allocation trace recorder, built as libmmrecord.so and
+ *     loaded into a live process with
+ *
+ *         MMRECORD_OUT=app.rep LD_PRELOAD=./libmmrecord.so app ...
+ *
+ * It intercepts malloc, calloc, realloc, free, memalign, posix_memalign,
+ * aligned_alloc and valloc, and writes a trace that mdriver can replay.
+ *
+ * The hooks only append a fixed-size event to a ring buffer owned by the
+ * calling thread. Each ring has one producer (its thread) and one consumer
+ * (the flusher thread), so it needs no locks: the producer publishes with
+ * a release store of head and the flusher frees space with a release store
+ * of tail. The flusher appends the raw events to <out>.raw. Events carry a
+ * sequence number from a global counter, which is the only shared write on
+ * the fast path.
+ *
+ * At exit the raw events are sorted by sequence number, addresses are
+ * mapped to ids (a freed id is reused, so num_ids is the peak number of
+ * live blocks), and the trace is written in the text format, or in the
+ * binary format if the output name ends in ".bin".
+ *
+ * Environment:
+ *   MMRECORD_OUT       output trace (default mmrecord.rep)
+ *   MMRECORD_ANNOTATE  if set, end each text op with "# tid=<tid> t=<ns>"
+ *
+ * Notes:
+ *   - mdriver has no aligned allocation, so memalign and friends are
+ *     recorded as plain allocations, and size 0 is recorded as size 1.
+ *   - frees of blocks allocated before recording started are dropped.
+ *   - a forked child is not recorded.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define RING_SIZE 65536        /* events per thread ring, a power of two */
+#define FLUSH_INTERVAL 1000000 /* ns the flusher sleeps when idle */
+#define BOOTSTRAP_BYTES 65536  /* served while dlsym resolves the hooks */
+#define MAXLINE 1024
+
+#define TLS __thread __attribute__((tls_model("initial-exec")))
+#define EXPORT __attribute__((visibility("default")))
+
+/* One intercepted call */
+typedef struct {
+    uint64_t seq;  /* global order */
+    uint64_t ts;   /* ns since recording started, if annotating */
+    uintptr_t ptr; /* block returned (or freed) */
+    uintptr_t old; /* realloc's old block; the id once the trace is built */
+    uint32_t size;
+    int32_t tid;
+    int32_t type; /* ALLOC, FREE, REALLOC or EV_SKIP */
+    int32_t pad;
+} event_t;
+
+#define EV_SKIP (-1) /* event dropped while building the trace */
+
+/* A single-producer, single-consumer ring of events */
+typedef struct ring {
+    uint64_t head; /* next event the owning thread writes */
+    uint64_t tail; /* next event the flusher reads */
+    int retired;   /* the owning thread has exited */
+    struct ring *next;
+    event_t ev[RING_SIZE];
+} ring_t;
+
+/* the real allocator */
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static void *(*real_memalign)(size_t, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+static void *(*real_valloc)(size_t);
+
+static char bootstrap[BOOTSTRAP_BYTES] __attribute__((aligned(16)));
+static size_t bootstrap_used;
+static int resolving;
+
+static int recording;  /* set while events are being recorded */
+static int annotate;   /* MMRECORD_ANNOTATE */
+static uint64_t seq;   /* next sequence number */
+static uint64_t start; /* ns at which recording started */
+static ring_t *rings;  /* every ring ever created, newest first */
+static int flusher_stop;
+static pthread_t flusher;
+static pthread_key_t ring_key;
+static int raw_fd = -1;
+static char out_path[MAXLINE];
+static char raw_path[MAXLINE + 4];
+
+static TLS ring_t *my_ring;
+static TLS int in_hook; /* set while we are inside a hook (or the recorder) */
+
+/*
+ * now - monotonic nanoseconds
+ */
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * bootstrap_alloc - serve dlsym's allocations before the hooks resolve
+ */
+static void *bootstrap_alloc(size_t size) {
+    void *p;
+
+    size = (size + 15) & ~(size_t)15;
+    if (bootstrap_used + size > BOOTSTRAP_BYTES) return NULL;
+    p = bootstrap + bootstrap_used;
+    bootstrap_used += size;
+    return p;
+}
+
+static int is_bootstrap(void *p) {
+    return (char *)p >= bootstrap && (char *)p < bootstrap + BOOTSTRAP_BYTES;
+}
+
+/*
+ * resolve - look up the allocator we interpose on. The *(void **)& casts
+ *     are how POSIX suggests storing dlsym's result in a function pointer.
+ */
+static void resolve(void) {
+    resolving = 1;
+    *(void **)&real_malloc = dlsym(RTLD_NEXT, "malloc");
+    *(void **)&real_calloc = dlsym(RTLD_NEXT, "calloc");
+    *(void **)&real_realloc = dlsym(RTLD_NEXT, "realloc");
+    *(void **)&real_free = dlsym(RTLD_NEXT, "free");
+    *(void **)&real_memalign = dlsym(RTLD_NEXT, "memalign");
+    *(void **)&real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    *(void **)&real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+    *(void **)&real_valloc = dlsym(RTLD_NEXT, "valloc");
+    resolving = 0;
+    if (real_malloc == NULL || real_free == NULL) {
+        fprintf(stderr, "mmrecord: cannot find the real allocator\n");
+        _exit(1);
+    }
+}
+
+/*
+ * retire_ring - pthread key destructor, run when a thread exits. The
+ *     flusher frees the ring once it has drained it.
+ */
+static void retire_ring(void *arg) {
+    ring_t *ring = arg;
+
+    in_hook = 1; /* record nothing more from this thread */
+    my_ring = NULL;
+    __atomic_store_n(&ring->retired, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * new_ring - create and register the calling thread's ring
+ */
+static ring_t *new_ring(void) {
+    ring_t *ring = mmap(NULL, sizeof(ring_t), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ring == MAP_FAILED) return NULL;
+    ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+/*
+ * next_seq - take the next sequence number
+ */
+static inline uint64_t next_seq(void) {
+    return __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * record - append an event with sequence number s to the calling thread's
+ *     ring
+ */
+static void record(int type, void *ptr, void *old, size_t size, uint64_t s) {
+    ring_t *ring = my_ring;
+    event_t *ev;
+    uint64_t h;
+
+    if (ring == NULL && (ring = my_ring = new_ring()) == NULL) return;
+    h = ring->head;
+    /* the ring is full: wait for the flusher to catch up */
+    while (h - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= RING_SIZE)
+        sched_yield();
+
+    ev = &ring->ev[h & (RING_SIZE - 1)];
+    ev->seq = s;
+    ev->ts = annotate ? now() - start : 0;
+    ev->ptr = (uintptr_t)ptr;
+    ev->old = (uintptr_t)old;
+    ev->size = size > INT_MAX ? 0 : (size ? size : 1);
+    ev->tid = annotate ? syscall(SYS_gettid) : 0;
+    ev->type = size > INT_MAX ? EV_SKIP : type;
+    __atomic_store_n(&ring->head, h + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * write_all - write(2) all of buf, or die
+ */
+static void write_all(int fd, const void *buf, size_t len) {
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = write(fd, buf, len)) < 0) {
+            if (errno == EINTR) continue;
+            perror("mmrecord: write");
+            _exit(1);
+        }
+        buf = (const char *)buf + n;
+        len -= n;
+    }
+}
+
+/*
+ * drain - move every published event to the raw file; returns the number
+ *     of events moved
+ */
+static size_t drain(void) {
+    ring_t *ring, *prev = NULL, *next;
+    size_t moved = 0;
+    uint64_t h, t;
+    int retired;
+
+    for (ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring; ring = next) {
+        next = ring->next;
+        retired = __atomic_load_n(&ring->retired, __ATOMIC_ACQUIRE);
+        h = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        t = ring->tail;
+        if (h != t) {
+            size_t lo = t & (RING_SIZE - 1), hi = h & (RING_SIZE - 1);
+            if (lo < hi) {
+                write_all(raw_fd, &ring->ev[lo], (hi - lo) * sizeof(event_t));
+            } else {
+                write_all(raw_fd, &ring->ev[lo],
+                          (RING_SIZE - lo) * sizeof(event_t));
+                write_all(raw_fd, ring->ev, hi * sizeof(event_t));
+            }
+            __atomic_store_n(&ring->tail, h, __ATOMIC_RELEASE);
+            moved += h - t;
+        }
+        /* Only the flusher unlinks, and threads only push at the list
+         * head, so any ring but the head can be unlinked safely */
+        if (retired && prev != NULL) {
+            prev->next = next;
+            munmap(ring, sizeof(ring_t));
+        } else {
+            prev = ring;
+        }
+    }
+    return moved;
+}
+
+/*
+ * flusher_main - body of the flusher thread
+ */
+static void *flusher_main(void *arg) {
+    struct timespec idle = {0, FLUSH_INTERVAL};
+
+    (void)arg;
+    in_hook = 1;
+    while (!__atomic_load_n(&flusher_stop, __ATOMIC_ACQUIRE))
+        if (drain() == 0) nanosleep(&idle, NULL);
+    return NULL;
+}
+
+/*
+ * stop_in_child - the child of a fork has no flusher, so it records nothing
+ */
+static void stop_in_child(void) { recording = 0; }
+
+/*
+ * mmrecord_start - open the raw file and start the flusher
+ */
+__attribute__((constructor)) static void mmrecord_start(void) {
+    char *out = getenv("MMRECORD_OUT");
+
+    in_hook = 1;
+    if (real_malloc == NULL) resolve();
+    snprintf(out_path, sizeof(out_path), "%s", out ? out : "mmrecord.rep");
+    snprintf(raw_path, sizeof(raw_path), "%s.raw", out_path);
+    annotate = getenv("MMRECORD_ANNOTATE") != NULL;
+
+    raw_fd = open(raw_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (raw_fd < 0) {
+        perror(raw_path);
+        in_hook = 0;
+        return;
+    }
+    pthread_key_create(&ring_key, retire_ring);
+    pthread_atfork(NULL, NULL, stop_in_child);
+    if (pthread_create(&flusher, NULL, flusher_main, NULL) != 0) {
+        fprintf(stderr, "mmrecord: cannot start the flusher thread\n");
+        in_hook = 0;
+        return;
+    }
+    start = now();
+    __atomic_store_n(&recording, 1, __ATOMIC_RELEASE);
+    in_hook = 0;
+}
+
+/*
+ * The hooks. Each one calls the real allocator and then records the call,
+ * unless we are already inside the recorder.
+ */
+#define ENTER()                                                          \
+    int rec = !in_hook && __atomic_load_n(&recording, __ATOMIC_ACQUIRE); \
+    in_hook++
+#define LEAVE() in_hook--
+
+EXPORT void *malloc(size_t size) {
+    void *p;
+
+    if (real_malloc == NULL) {
+        if (resolving) return bootstrap_alloc(size);
+        resolve();
+    }
+    ENTER();
+    p = real_malloc(size);
+    if (rec && p) record(ALLOC, p, NULL, size, next_seq());
+    LEAVE();
+    return p;
+}
+
+EXPORT void *calloc(size_t nmemb, size_t size) {
+    void *p;
+
+    if (real_calloc == NULL) {
+        if (resolving) return bootstrap_alloc(nmemb * size); /* zeroed */
+        resolve();
+    }
+    ENTER();
+    p = real_calloc(nmemb, size);
+    if (rec && p) record(ALLOC, p, NULL, nmemb * size, next_seq());
+    LEAVE();
+    return p;
+}
+
+EXPORT void *realloc(void *ptr, size_t size) {
+    uint64_t s = 0;
+    void *p;
+
+    if (is_bootstrap(ptr)) { /* move it to the real heap */
+        if ((p = malloc(size)) != NULL)
+            memcpy(p, ptr, size); /* over-reads only the bootstrap buffer */
+        return p;
+    }
+    if (real_realloc == NULL) resolve();
+    ENTER();
+    /* order a realloc before it frees the old block, like free */
+    if (rec && ptr != NULL) s = next_seq();
+    p = real_realloc(ptr, size);
+    if (rec) {
+        if (ptr == NULL) {
+            if (p) record(ALLOC, p, NULL, size, next_seq());
+        } else if (size == 0) {
+            record(FREE, ptr, NULL, 0, s);
+        } else if (p) {
+            record(REALLOC, p, ptr, size, s);
+        }
+    }
+    LEAVE();
+    return p;
+}
+
+EXPORT void free(void *ptr) {
+    if (ptr == NULL || is_bootstrap(ptr)) return;
+    if (real_free == NULL) resolve();
+    ENTER();
+    /* record before the block can be handed to another thread */
+    if (rec) record(FREE, ptr, NULL, 0, next_seq());
+    real_free(ptr);
+    LEAVE();
+}
+
+EXPORT void *memalign(size_t alignment, size_t size) {
+    void *p;
+
+    if (real_memalign == NULL) resolve();
+    ENTER();
+    p = real_memalign(alignment, size);
+    if (rec && p) record(ALLOC, p, NULL, size, next_seq());
+    LEAVE();
+    return p;
+}
+
+EXPORT int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    int ret;
+
+    if (real_posix_memalign == NULL) resolve();
+    ENTER();
+    ret = real_posix_memalign(memptr, alignment, size);
+    if (rec && ret == 0) record(ALLOC, *memptr, NULL, size, next_seq());
+    LEAVE();
+    return ret;
+}
+
+EXPORT void *aligned_alloc(size_t alignment, size_t size) {
+    void *p;
+
+    if (real_aligned_alloc == NULL) resolve();
+    ENTER();
+    p = real_aligned_alloc(alignment, size);
+    if (rec && p) record(ALLOC, p, NULL, size, next_seq());
+    LEAVE();
+    return p;
+}
+
+EXPORT void *valloc(size_t size) {
+    void *p;
+
+    if (real_valloc == NULL) resolve();
+    ENTER();
+    p = real_valloc(size);
+    if (rec && p) record(ALLOC, p, NULL, size, next_seq());
+    LEAVE();
+    return p;
+}
+
+/*****************************************************************
+ * Building the trace from the raw events, at exit
+ ****************************************************************/
+
+/*
+ * Open-addressed hash from address to id. A free is recorded before the
+ * block is released and an allocation after it returns, so a block's free
+ * is always ordered before its reuse, except when a realloc (ordered at
+ * its start) returns a block whose free was recorded during the realloc.
+ * Then the old owner is dropped from the trace and its pending free is
+ * counted in 'stale' and skipped when it comes.
+ */
+typedef struct {
+    uintptr_t addr; /* 0 if the slot is empty */
+    int id;         /* -1 if the address is not live */
+    int stale;      /* frees of dropped owners still to come */
+} addr_slot_t;
+
+static addr_slot_t *addrs;
+static size_t addrs_cap, addrs_count;
+
+static inline size_t hash_addr(uintptr_t a) {
+    a ^= a >> 33;
+    a *= 0xff51afd7ed558ccdUL;
+    a ^= a >> 33;
+    return a & (addrs_cap - 1);
+}
+
+static addr_slot_t *addr_find(uintptr_t a) {
+    size_t h;
+
+    if (addrs_cap == 0) return NULL;
+    for (h = hash_addr(a); addrs[h].addr != a; h = (h + 1) & (addrs_cap - 1))
+        if (addrs[h].addr == 0) return NULL;
+    return &addrs[h];
+}
+
+static addr_slot_t *addr_insert(uintptr_t a) {
+    size_t h;
+
+    if (2 * (addrs_count + 1) > addrs_cap) {
+        addr_slot_t *old = addrs;
+        size_t i, old_cap = addrs_cap;
+
+        addrs_cap = addrs_cap ? 2 * addrs_cap : 4096;
+        if ((addrs = calloc(addrs_cap, sizeof(addr_slot_t))) == NULL) {
+            perror("mmrecord");
+            _exit(1);
+        }
+        addrs_count = 0;
+        for (i = 0; i < old_cap; i++)
+            if (old[i].addr) *addr_insert(old[i].addr) = old[i];
+        free(old);
+    }
+    for (h = hash_addr(a); addrs[h].addr; h = (h + 1) & (addrs_cap - 1))
+        ;
+    addrs[h].addr = a;
+    addrs[h].id = -1;
+    addrs[h].stale = 0;
+    addrs_count++;
+    return &addrs[h];
+}
+
+static void addr_remove(addr_slot_t *slot) {
+    size_t mask = addrs_cap - 1;
+    size_t h = slot - addrs, j;
+
+    for (j = (h + 1) & mask; addrs[j].addr; j = (j + 1) & mask) {
+        size_t home = hash_addr(addrs[j].addr);
+        if (((j - home) & mask) >= ((j - h) & mask)) {
+            addrs[h] = addrs[j];
+            h = j;
+        }
+    }
+    addrs[h].addr = 0;
+    addrs_count--;
+}
+
+/*
+ * addr_release - the block at slot is no longer live
+ */
+static void addr_release(addr_slot_t *slot) {
+    if (slot->stale > 0)
+        slot->id = -1;
+    else
+        addr_remove(slot);
+}
+
+/*
+ * addr_bind - the block at a is now live with the given id
+ */
+static void addr_bind(uintptr_t a, int id) {
+    addr_slot_t *slot = addr_find(a);
+
+    if (slot == NULL) slot = addr_insert(a);
+    if (slot->id >= 0) slot->stale++; /* see above */
+    slot->id = id;
+}
+
+static int cmp_seq(const void *a, const void *b) {
+    uint64_t x = ((const event_t *)a)->seq, y = ((const event_t *)b)->seq;
+    return (x > y) - (x < y);
+}
+
+/*
+ * assign_ids - replay the events against the address map, turning each
+ *     into an op on an id (stored in ev->old), or EV_SKIP. Freed ids go on
+ *     a stack and are reused, so ids stay dense. Returns the number of
+ *     ops, and sets *num_ids to the number of ids used.
+ */
+static int assign_ids(event_t *evs, size_t n, int *num_ids) {
+    int *free_ids = NULL;
+    int num_free = 0, cap_free = 0;
+    int num_ops = 0;
+    addr_slot_t *slot;
+    size_t i;
+    int id;
+
+    *num_ids = 0;
+    for (i = 0; i < n; i++) {
+        event_t *ev = &evs[i];
+
+        slot = NULL;
+        if (ev->type == REALLOC || ev->type == FREE) {
+            slot = addr_find(ev->type == REALLOC ? ev->old : ev->ptr);
+            if (slot != NULL && ev->type == FREE && slot->stale > 0) {
+                slot->stale--; /* a dropped owner's free */
+                if (slot->stale == 0 && slot->id < 0) addr_remove(slot);
+                ev->type = EV_SKIP;
+                continue;
+            }
+            if (slot != NULL && slot->id < 0) slot = NULL;
+        }
+
+        switch (ev->type) {
+            case REALLOC:
+                if (slot == NULL) { /* its block predates the recording */
+                    ev->type = ALLOC;
+                } else {
+                    id = slot->id;
+                    addr_release(slot);
+                    addr_bind(ev->ptr, id);
+                    break;
+                }
+                /* fall through */
+            case ALLOC:
+                id = num_free > 0 ? free_ids[--num_free] : (*num_ids)++;
+                addr_bind(ev->ptr, id);
+                break;
+
+            case FREE:
+                if (slot == NULL) { /* its block predates the recording */
+                    ev->type = EV_SKIP;
+                    continue;
+                }
+                id = slot->id;
+                addr_release(slot);
+                if (num_free == cap_free) {
+                    cap_free = cap_free ? 2 * cap_free : 1024;
+                    free_ids = realloc(free_ids, cap_free * sizeof(int));
+                    if (free_ids == NULL) {
+                        perror("mmrecord");
+                        _exit(1);
+                    }
+                }
+                free_ids[num_free++] = id;
+                break;
+
+            default:
+                continue;
+        }
+        ev->old = id;
+        num_ops++;
+    }
+    free(free_ids);
+    return num_ops;
+}
+
+/*
+ * write_rep - write the ops in the text format
+ */
+static int write_rep(FILE *f, event_t *evs, size_t n, int num_ids,
+                     int num_ops) {
+    static const char codes[] = {[ALLOC] = 'a', [FREE] = 'f', [REALLOC] = 'r'};
+    size_t i;
+
+    fprintf(f, "0\n%d\n%d\n1\n", num_ids, num_ops);
+    for (i = 0; i < n; i++) {
+        event_t *ev = &evs[i];
+
+        if (ev->type == EV_SKIP) continue;
+        if (ev->type == FREE)
+            fprintf(f, "f %d", (int)ev->old);
+        else
+            fprintf(f, "%c %d %u", codes[ev->type], (int)ev->old, ev->size);
+        if (annotate)
+            fprintf(f, " # tid=%d t=%llu", ev->tid, (unsigned long long)ev->ts);
+        fputc('\n', f);
+    }
+    return ferror(f) ? -1 : 0;
+}
+
+/*
+ * write_bin - write the ops in the binary format
+ */
+static int write_bin(FILE *f, event_t *evs, size_t n, int num_ids,
+                     int num_ops) {
+    trace_bin_header_t hdr;
+    traceop_t ops[TRACE_CHUNK_OPS];
+    size_t i;
+    int k = 0;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = TRACE_BIN_VERSION;
+    hdr.op_size = sizeof(traceop_t);
+    hdr.num_ids = num_ids;
+    hdr.num_ops = num_ops;
+    hdr.weight = 1;
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    for (i = 0; i < n; i++) {
+        if (evs[i].type == EV_SKIP) continue;
+        ops[k].type = evs[i].type;
+        ops[k].index = evs[i].old;
+        ops[k].size = evs[i].type == FREE ? 0 : (int)evs[i].size;
+        if (++k == TRACE_CHUNK_OPS) {
+            fwrite(ops, sizeof(traceop_t), k, f);
+            k = 0;
+        }
+    }
+    fwrite(ops, sizeof(traceop_t), k, f);
+    return ferror(f) ? -1 : 0;
+}
+
+/*
+ * build_trace - sort the raw events and write the trace
+ */
+static void build_trace(void) {
+    struct stat st;
+    event_t *evs = NULL;
+    size_t n, len = strlen(out_path);
+    int num_ids, num_ops;
+    FILE *f;
+
+    if (fstat(raw_fd, &st) < 0) {
+        perror(raw_path);
+        return;
+    }
+    n = st.st_size / sizeof(event_t);
+    if (n > 0) {
+        evs = mmap(NULL, n * sizeof(event_t), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, raw_fd, 0);
+        if (evs == MAP_FAILED) {
+            perror(raw_path);
+            return;
+        }
+        qsort(evs, n, sizeof(event_t), cmp_seq);
+    }
+    num_ops = assign_ids(evs, n, &num_ids);
+
+    if ((f = fopen(out_path, "w")) == NULL) {
+        perror(out_path);
+    } else {
+        int ret = (len >= 4 && !strcmp(out_path + len - 4, ".bin"))
+                      ? write_bin(f, evs, n, num_ids, num_ops)
+                      : write_rep(f, evs, n, num_ids, num_ops);
+        if (fclose(f) != 0 || ret < 0) perror(out_path);
+    }
+    if (evs) munmap(evs, n * sizeof(event_t));
+    free(addrs);
+}
+
+/*
+ * mmrecord_stop - stop recording, write the trace and remove the raw file
+ */
+__attribute__((destructor)) static void mmrecord_stop(void) {
+    if (!__atomic_load_n(&recording, __ATOMIC_ACQUIRE)) return;
+    in_hook = 1;
+    __atomic_store_n(&recording, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&flusher_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(flusher, NULL);
+    drain();
+    build_trace();
+    close(raw_fd);
+    unlink(raw_path);
+}
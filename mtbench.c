@@ -0,0 +1,328 @@
+/*
+ * mtbench.c - multithreaded allocator benchmarks (see mtbench.h)
+ */
+#include "mtbench.h"
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "memlib.h"
+
+#define MT_MAX_THREADS 64
+
+#define LARSON_SLOTS 1000 /* live objects per thread */
+#define LARSON_EPOCHS 10  /* times the arrays move on to the next thread */
+#define LARSON_MIN 16
+#define LARSON_MAX 512
+
+#define XMALLOC_BATCH 100 /* objects handed over at a time */
+#define XMALLOC_QUEUE 4   /* batches waiting for one thread, at most */
+#define XMALLOC_MIN 8
+#define XMALLOC_MAX 256
+
+#define THREADTEST_OBJS 100 /* objects a thread holds at once */
+#define THREADTEST_MIN 8
+#define THREADTEST_MAX 64
+
+/* One benchmark thread */
+typedef struct {
+    int id;
+    int nthreads;
+    unsigned long rng; /* xorshift64 state */
+    pthread_t tid;
+} worker_t;
+
+/* A queue of batches handed to one thread (xmalloc) */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    void **batches[XMALLOC_QUEUE];
+    int head, count;
+} queue_t;
+
+/* The backend under test, and the lock that serializes it if need be */
+static const backend_t *mt_backend;
+static pthread_mutex_t mt_lock = PTHREAD_MUTEX_INITIALIZER;
+static int mt_failed;      /* set when an allocation fails */
+static size_t mt_baseline; /* footprint before the first run (libc) */
+
+/* Shared by the threads of one run */
+static pthread_barrier_t start_barrier; /* threads and main: timing starts */
+static pthread_barrier_t done_barrier;  /* ... timing stops */
+static pthread_barrier_t clean_barrier; /* ... heap measured, clean up */
+static pthread_barrier_t epoch_barrier; /* threads only (larson) */
+static void **larson_arrays[MT_MAX_THREADS];
+static queue_t queues[MT_MAX_THREADS];
+
+/*****************************************************************
+ * Calls into the backend
+ ****************************************************************/
+
+static unsigned long next_random(worker_t *w) {
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 7;
+    w->rng ^= w->rng << 17;
+    return w->rng;
+}
+
+static size_t random_size(worker_t *w, size_t min, size_t max) {
+    return min + next_random(w) % (max - min + 1);
+}
+
+/*
+ * mt_malloc - allocate from the backend and write the first and last
+ *     bytes, as a program would (this is where false sharing shows)
+ */
+static void *mt_malloc(size_t size) {
+    char *p;
+
+    if (!mt_backend->thread_safe) pthread_mutex_lock(&mt_lock);
+    p = (char *)mt_backend->malloc(size);
+    if (!mt_backend->thread_safe) pthread_mutex_unlock(&mt_lock);
+    if (p == NULL) {
+        __atomic_store_n(&mt_failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    p[0] = p[size - 1] = 1;
+    return p;
+}
+
+static void mt_free(void *p) {
+    if (p == NULL) return; /* an allocation that failed */
+    if (!mt_backend->thread_safe) pthread_mutex_lock(&mt_lock);
+    mt_backend->free(p);
+    if (!mt_backend->thread_safe) pthread_mutex_unlock(&mt_lock);
+}
+
+/*
+ * heap_footprint - the memory the backend holds from the system: the
+ *     memlib heap, or the C library's arenas and mmapped chunks less what
+ *     they held before the benchmarks (the memlib heap among others)
+ */
+static size_t heap_footprint(void) {
+    if (mt_backend->uses_memlib) return mem_heapsize();
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    {
+        struct mallinfo2 mi = mallinfo2();
+        size_t bytes = mi.arena + mi.hblkhd;
+        return bytes > mt_baseline ? bytes - mt_baseline : 0;
+    }
+#else
+    return 0;
+#endif
+}
+
+/*****************************************************************
+ * The benchmarks. Each thread does MT_OPS mallocs and frees between
+ * start_barrier and done_barrier, and frees what it still holds after
+ * clean_barrier.
+ ****************************************************************/
+
+/*
+ * larson_thread - replace random objects of the array the thread holds
+ *     in this epoch; arrays move on to the next thread every epoch
+ */
+static void *larson_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    int per_epoch = MT_OPS / 2 / LARSON_EPOCHS;
+    void **a = larson_arrays[w->id];
+    int e, i, j;
+
+    for (j = 0; j < LARSON_SLOTS; j++)
+        a[j] = mt_malloc(random_size(w, LARSON_MIN, LARSON_MAX));
+    pthread_barrier_wait(&start_barrier);
+    for (e = 0; e < LARSON_EPOCHS; e++) {
+        a = larson_arrays[(w->id + e) % w->nthreads];
+        for (i = 0; i < per_epoch; i++) {
+            j = next_random(w) % LARSON_SLOTS;
+            mt_free(a[j]);
+            a[j] = mt_malloc(random_size(w, LARSON_MIN, LARSON_MAX));
+        }
+        pthread_barrier_wait(&epoch_barrier);
+    }
+    pthread_barrier_wait(&done_barrier);
+    pthread_barrier_wait(&clean_barrier);
+    a = larson_arrays[w->id];
+    for (j = 0; j < LARSON_SLOTS; j++) mt_free(a[j]);
+    return NULL;
+}
+
+static void queue_push(queue_t *q, void **batch) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == XMALLOC_QUEUE) pthread_cond_wait(&q->cond, &q->lock);
+    q->batches[(q->head + q->count++) % XMALLOC_QUEUE] = batch;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void **queue_pop(queue_t *q) {
+    void **batch;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) pthread_cond_wait(&q->cond, &q->lock);
+    batch = q->batches[q->head];
+    q->head = (q->head + 1) % XMALLOC_QUEUE;
+    q->count--;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    return batch;
+}
+
+/*
+ * xmalloc_thread - allocate a batch, hand it to the next thread, and free
+ *     the batch handed over by the previous one. Every thread pushes
+ *     before it pops, so the queues can never all be full.
+ */
+static void *xmalloc_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    int rounds = MT_OPS / 2 / XMALLOC_BATCH;
+    void **batch;
+    int r, k;
+
+    if ((batch = (void **)malloc(XMALLOC_BATCH * sizeof(void *))) == NULL) {
+        fprintf(stderr, "mtbench: out of memory\n");
+        exit(1);
+    }
+    pthread_barrier_wait(&start_barrier);
+    for (r = 0; r < rounds; r++) {
+        for (k = 0; k < XMALLOC_BATCH; k++)
+            batch[k] = mt_malloc(random_size(w, XMALLOC_MIN, XMALLOC_MAX));
+        queue_push(&queues[(w->id + 1) % w->nthreads], batch);
+        batch = queue_pop(&queues[w->id]);
+        for (k = 0; k < XMALLOC_BATCH; k++) mt_free(batch[k]);
+    }
+    pthread_barrier_wait(&done_barrier);
+    pthread_barrier_wait(&clean_barrier);
+    free(batch);
+    return NULL;
+}
+
+/*
+ * threadtest_thread - allocate objects and free them again, sharing
+ *     nothing with the other threads
+ */
+static void *threadtest_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    int rounds = MT_OPS / 2 / THREADTEST_OBJS;
+    void *objs[THREADTEST_OBJS];
+    int r, k;
+
+    pthread_barrier_wait(&start_barrier);
+    for (r = 0; r < rounds; r++) {
+        for (k = 0; k < THREADTEST_OBJS; k++)
+            objs[k] = mt_malloc(random_size(w, THREADTEST_MIN, THREADTEST_MAX));
+        for (k = 0; k < THREADTEST_OBJS; k++) mt_free(objs[k]);
+    }
+    pthread_barrier_wait(&done_barrier);
+    pthread_barrier_wait(&clean_barrier);
+    return NULL;
+}
+
+/*****************************************************************
+ * Running and reporting
+ ****************************************************************/
+
+/*
+ * run - run one benchmark on nthreads threads on a fresh heap; return the
+ *     seconds the timed part took and set *heap to the footprint at its
+ *     end (the memlib heap never shrinks, so for it that is the peak)
+ */
+static double run(void *(*fn)(void *), int nthreads, size_t *heap) {
+    static worker_t workers[MT_MAX_THREADS];
+    struct timespec start, end;
+    int i;
+
+    mem_reset_brk();
+    if (mt_backend->init() < 0) {
+        fprintf(stderr, "mtbench: %s init failed\n", mt_backend->name);
+        exit(1);
+    }
+    mt_failed = 0;
+    pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+    pthread_barrier_init(&done_barrier, NULL, nthreads + 1);
+    pthread_barrier_init(&clean_barrier, NULL, nthreads + 1);
+    pthread_barrier_init(&epoch_barrier, NULL, nthreads);
+    for (i = 0; i < nthreads; i++) {
+        pthread_mutex_init(&queues[i].lock, NULL);
+        pthread_cond_init(&queues[i].cond, NULL);
+        queues[i].head = queues[i].count = 0;
+        larson_arrays[i] = (void **)calloc(LARSON_SLOTS, sizeof(void *));
+        if (larson_arrays[i] == NULL) {
+            fprintf(stderr, "mtbench: out of memory\n");
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        workers[i].id = i;
+        workers[i].nthreads = nthreads;
+        workers[i].rng = 0x9e3779b97f4a7c15UL * (i + 1);
+        if (pthread_create(&workers[i].tid, NULL, fn, &workers[i]) != 0) {
+            fprintf(stderr, "mtbench: cannot create thread %d\n", i);
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&start_barrier);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_barrier_wait(&done_barrier);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *heap = heap_footprint();
+    pthread_barrier_wait(&clean_barrier);
+    for (i = 0; i < nthreads; i++) pthread_join(workers[i].tid, NULL);
+
+    for (i = 0; i < nthreads; i++) {
+        pthread_mutex_destroy(&queues[i].lock);
+        pthread_cond_destroy(&queues[i].cond);
+        free(larson_arrays[i]);
+    }
+    pthread_barrier_destroy(&start_barrier);
+    pthread_barrier_destroy(&done_barrier);
+    pthread_barrier_destroy(&clean_barrier);
+    pthread_barrier_destroy(&epoch_barrier);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * mtbench_run - run every benchmark on 1 to max_threads threads, and
+ *     print the throughput, the scaling efficiency (throughput over
+ *     nthreads times that of one thread) and the heap footprint
+ */
+void mtbench_run(const backend_t *b, int max_threads) {
+    static const struct {
+        const char *name;
+        void *(*fn)(void *);
+    } benches[] = {{"larson", larson_thread},
+                   {"xmalloc", xmalloc_thread},
+                   {"threadtest", threadtest_thread}};
+    double secs, mops, mops1 = 0;
+    size_t heap;
+    int i, t;
+
+    if (max_threads > MT_MAX_THREADS) max_threads = MT_MAX_THREADS;
+    mt_backend = b;
+    mt_baseline = 0;
+    mt_baseline = heap_footprint();
+    printf("Multithreaded benchmarks for %s malloc%s:\n", b->name,
+           b->thread_safe ? "" : " (not thread-safe: behind a global lock)");
+    printf("%-12s %7s %10s %9s %10s\n", "bench", "threads", "Mops/s", "scaling",
+           "heap KB");
+    printf("------------------------------------------------------\n");
+    for (i = 0; i < (int)(sizeof(benches) / sizeof(benches[0])); i++) {
+        for (t = 1; t <= max_threads; t++) {
+            secs = run(benches[i].fn, t, &heap);
+            if (mt_failed) {
+                printf("%-12s %7d %10s %9s %10s  (out of memory)\n",
+                       benches[i].name, t, "-", "-", "-");
+                continue;
+            }
+            mops = (double)t * MT_OPS / secs / 1e6;
+            if (t == 1) mops1 = mops;
+            printf("%-12s %7d %10.3f %8.1f%% %10zu\n", benches[i].name, t, mops,
+                   mops1 > 0 ? mops / (t * mops1) * 100 : 0, heap / 1024);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef MTBENCH_H_
+#define MTBENCH_H_
+
+#include "backend.h"
+
+/*
+ * Multithreaded allocator benchmarks (mdriver -M):
+ *
+ *  - larson: each thread replaces random objects in an array of live
+ *    objects, and between epochs the arrays move on to the next thread,
+ *    so that objects are freed by a different thread than allocated them
+ *    (after Larson and Krishnan's server simulation);
+ *
+ *  - xmalloc: each thread allocates batches of objects and hands them to
+ *    the next thread, which frees them (producer/consumer, after
+ *    xmalloc-test);
+ *
+ *  - threadtest: each thread allocates and frees its own objects, with
+ *    no sharing at all (after Hoard's threadtest).
+ *
+ * Every thread does the same amount of work whatever the number of
+ * threads, so perfect scaling keeps the time constant. A backend that is
+ * not thread-safe is serialized by one global lock.
+ */
+
+#define MT_OPS 1000000 /* mallocs and frees per thread per benchmark */
+
+/* run the benchmarks on 1 to max_threads threads and print the results */
+void mtbench_run(const backend_t *b, int max_threads);
+
+#endif /* MTBENCH_H_ */
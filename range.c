@@ -0,0 +1,150 @@
+/*
+ * range.c - the treap of payload extents (see range.h)
+ */
+#include "range.h"
+
+#include <stdlib.h>
+
+#define RANGE_POOL_CHUNK 4096 /* range records carved from each pool chunk */
+
+static range_t *range_pool = NULL; /* free range records */
+static unsigned range_rng = 2463534242u;
+
+/*
+ * new_range - take a range record from the pool, refilling it from libc
+ *     malloc a chunk at a time; return NULL if out of memory
+ */
+static range_t *new_range(char *lo, char *hi) {
+    range_t *p;
+    int i;
+
+    if (range_pool == NULL) {
+        if ((p = (range_t *)malloc(RANGE_POOL_CHUNK * sizeof(range_t))) == NULL)
+            return NULL;
+        for (i = 0; i < RANGE_POOL_CHUNK; i++) {
+            p[i].right = range_pool;
+            range_pool = &p[i];
+        }
+    }
+    p = range_pool;
+    range_pool = p->right;
+    p->lo = lo;
+    p->hi = hi;
+    range_rng ^= range_rng << 13;
+    range_rng ^= range_rng >> 17;
+    range_rng ^= range_rng << 5;
+    p->prio = range_rng;
+    p->left = p->right = NULL;
+    return p;
+}
+
+/*
+ * treap_insert - insert p into the treap rooted at t; returns the new root
+ */
+static range_t *treap_insert(range_t *t, range_t *p) {
+    range_t *c;
+
+    if (t == NULL) return p;
+    if (p->lo < t->lo) {
+        t->left = treap_insert(t->left, p);
+        if (t->left->prio > t->prio) { /* rotate right */
+            c = t->left;
+            t->left = c->right;
+            c->right = t;
+            t = c;
+        }
+    } else {
+        t->right = treap_insert(t->right, p);
+        if (t->right->prio > t->prio) { /* rotate left */
+            c = t->right;
+            t->right = c->left;
+            c->left = t;
+            t = c;
+        }
+    }
+    return t;
+}
+
+/*
+ * merge_ranges - join two treaps, all of whose ranges in a lie below
+ *     those in b
+ */
+static range_t *merge_ranges(range_t *a, range_t *b) {
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    if (a->prio > b->prio) {
+        a->right = merge_ranges(a->right, b);
+        return a;
+    }
+    b->left = merge_ranges(a, b->left);
+    return b;
+}
+
+/*
+ * find_range - Return the range that overlaps lo..hi. The ranges in the
+ *     tree are disjoint, so only the ones just below and just above lo
+ *     can overlap it.
+ */
+range_t *find_range(range_t *ranges, char *lo, char *hi) {
+    range_t *p, *pred = NULL, *succ = NULL;
+
+    for (p = ranges; p != NULL;) {
+        if (p->lo <= lo) {
+            pred = p;
+            p = p->right;
+        } else {
+            succ = p;
+            p = p->left;
+        }
+    }
+    if (pred != NULL && pred->hi >= lo) return pred;
+    if (succ != NULL && succ->lo <= hi) return succ;
+    return NULL;
+}
+
+/*
+ * insert_range - Add a record of lo..hi to the treap
+ */
+int insert_range(range_t **ranges, char *lo, char *hi) {
+    range_t *p = new_range(lo, hi);
+
+    if (p == NULL) return -1;
+    *ranges = treap_insert(*ranges, p);
+    return 0;
+}
+
+/*
+ * remove_range - Free the range record of block whose payload starts at lo
+ */
+void remove_range(range_t **ranges, char *lo) {
+    range_t *p;
+
+    while ((p = *ranges) != NULL && p->lo != lo)
+        ranges = lo < p->lo ? &p->left : &p->right;
+    if (p == NULL) return;
+    *ranges = merge_ranges(p->left, p->right);
+    p->right = range_pool;
+    range_pool = p;
+}
+
+/*
+ * free_ranges - return every record in the treap rooted at t to the pool
+ */
+static void free_ranges(range_t *t) {
+    range_t *left;
+
+    for (; t != NULL; t = left) {
+        left = t->left;
+        free_ranges(t->right);
+        t->right = range_pool;
+        range_pool = t;
+    }
+}
+
+/*
+ * clear_ranges - free all of the range records for a trace
+ */
+void clear_ranges(range_t **ranges) {
+    free_ranges(*ranges);
+    *ranges = NULL;
+}
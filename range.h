@@ -0,0 +1,33 @@
+#ifndef RANGE_H_
+#define RANGE_H_
+
+/*
+ * The extents of the allocated payloads of a trace, kept by mdriver to
+ * catch blocks that overlap. They form a treap (a binary search tree on
+ * lo, and a heap on prio), so that overlaps are checked in O(log n). The
+ * records come from a pool that is refilled from libc malloc a chunk at a
+ * time and never returned to it.
+ */
+
+/* Records the extent of each block's payload */
+typedef struct range_t {
+    char *lo;              /* low payload address */
+    char *hi;              /* high payload address */
+    unsigned prio;         /* random heap priority */
+    struct range_t *left;  /* ranges below lo */
+    struct range_t *right; /* ranges above lo (also the pool's free list) */
+} range_t;
+
+/* the range in the treap that overlaps lo..hi, or NULL if none does */
+range_t *find_range(range_t *ranges, char *lo, char *hi);
+
+/* add the range lo..hi to the treap; return -1 if out of memory */
+int insert_range(range_t **ranges, char *lo, char *hi);
+
+/* remove the range that starts at lo, if there is one */
+void remove_range(range_t **ranges, char *lo);
+
+/* remove every range */
+void clear_ranges(range_t **ranges);
+
+#endif /* RANGE_H_ */
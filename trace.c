@@ -0,0 +1,628 @@
+/*
+ * trace.c - read and write allocator trace files, in the text (.rep)
+ *           and binary formats described in trace.h
+ */
+#include "trace.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAXLINE 1024 /* max string size */
+
+/* Binary records are used in place, so their layout is part of the format */
+typedef char traceop_is_12_bytes[sizeof(traceop_t) == 12 ? 1 : -1];
+
+extern int verbose; /* -v option in mdriver.c */
+
+/*
+ * trace_error - Report a Unix-style error and exit
+ */
+static void trace_error(char *msg, char *path) {
+    printf("%s %s: %s\n", msg, path, strerror(errno));
+    exit(1);
+}
+
+static void _check(int errcode) {
+    if (errcode < 0) {
+        printf("Error: %s\n", strerror(-errcode));
+    }
+}
+
+/*
+ * alloc_blocks - allocate the arrays that remember each id's block
+ */
+static void alloc_blocks(trace_t *trace, char *path) {
+    /* We'll keep an array of pointers to the allocated blocks here... */
+    if ((trace->blocks = (char **)malloc(trace->num_ids * sizeof(char *))) ==
+        NULL)
+        trace_error("malloc 3 failed in read_trace for", path);
+
+    /* ... along with the corresponding byte sizes of each block */
+    if ((trace->block_sizes =
+             (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+        trace_error("malloc 4 failed in read_trace for", path);
+}
+
+/*
+ * bin_header_ok - check the fields of a binary header
+ */
+static int bin_header_ok(trace_bin_header_t *hdr) {
+    return hdr->version == TRACE_BIN_VERSION &&
+           hdr->op_size == sizeof(traceop_t) && hdr->num_ids >= 0 &&
+           hdr->num_ops >= 0;
+}
+
+/*
+ * bin_ops_ok - check n binary records against a trace with num_ids ids.
+ *     Nothing parses them, so this is all that keeps a bad file from
+ *     sending the replays outside the blocks arrays.
+ */
+static int bin_ops_ok(traceop_t *ops, int n, int num_ids) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (ops[i].type != ALLOC && ops[i].type != FREE &&
+            ops[i].type != REALLOC)
+            return 0;
+        if (ops[i].index < 0 || ops[i].index >= num_ids || ops[i].size < 0)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * read_trace_bin - map a binary trace; the ops array points into the
+ *     mapping, so there is nothing to parse, only the records to check
+ */
+static void read_trace_bin(trace_t *trace, int fd, char *path) {
+    struct stat st;
+    trace_bin_header_t *hdr;
+
+    if (fstat(fd, &st) < 0) trace_error("Could not stat", path);
+    trace->map_len = st.st_size;
+    trace->map = mmap(NULL, trace->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (trace->map == MAP_FAILED) trace_error("Could not map", path);
+
+    hdr = trace->map;
+    if (trace->map_len < sizeof(*hdr) || !bin_header_ok(hdr) ||
+        trace->map_len <
+            sizeof(*hdr) + (size_t)hdr->num_ops * sizeof(traceop_t) ||
+        !bin_ops_ok((traceop_t *)(hdr + 1), hdr->num_ops, hdr->num_ids)) {
+        printf("Malformed binary tracefile %s\n", path);
+        exit(1);
+    }
+    trace->sugg_heapsize = hdr->sugg_heapsize;
+    trace->num_ids = hdr->num_ids;
+    trace->num_ops = hdr->num_ops;
+    trace->weight = hdr->weight;
+    trace->ops = (traceop_t *)(hdr + 1);
+
+    /* the replay will walk the ops front to back */
+    madvise(trace->map, trace->map_len, MADV_SEQUENTIAL);
+}
+
+/*
+ * read_rep_header - parse the 4-line header of a text trace
+ */
+static void read_rep_header(trace_t *trace, FILE *tracefile) {
+    _check(fscanf(tracefile, "%d", &(trace->sugg_heapsize))); /* not used */
+    _check(fscanf(tracefile, "%d", &(trace->num_ids)));
+    _check(fscanf(tracefile, "%d", &(trace->num_ops)));
+    _check(fscanf(tracefile, "%d", &(trace->weight))); /* not used */
+}
+
+/*
+ * read_rep_op - parse the next request line of a text trace into *op;
+ *     returns 0 at the end of the file
+ */
+static int read_rep_op(FILE *tracefile, traceop_t *op, char *path) {
+    char type[MAXLINE];
+    unsigned index, size;
+
+    /* "#" starts a comment that runs to the end of the line */
+    while (fscanf(tracefile, "%s", type) != EOF && type[0] == '#')
+        if (fscanf(tracefile, "%*[^\n]") == EOF) return 0;
+    if (feof(tracefile)) return 0;
+    switch (type[0]) {
+        case 'a':
+            _check(fscanf(tracefile, "%u %u", &index, &size));
+            op->type = ALLOC;
+            op->index = index;
+            op->size = size;
+            break;
+        case 'r':
+            _check(fscanf(tracefile, "%u %u", &index, &size));
+            op->type = REALLOC;
+            op->index = index;
+            op->size = size;
+            break;
+        case 'f':
+            _check(fscanf(tracefile, "%ud", &index));
+            op->type = FREE;
+            op->index = index;
+            op->size = 0;
+            break;
+        default:
+            printf("Bogus type character (%c) in tracefile %s\n", type[0],
+                   path);
+            exit(1);
+    }
+    return 1;
+}
+
+/*
+ * read_trace_rep - parse a text trace
+ */
+static void read_trace_rep(trace_t *trace, FILE *tracefile, char *path) {
+    int max_index = 0;
+    int op_index;
+
+    read_rep_header(trace, tracefile);
+
+    /* We'll store each request line in the trace in this array */
+    if ((trace->ops =
+             (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+        trace_error("malloc 2 failed in read_trace for", path);
+
+    /* read every request line in the trace file */
+    op_index = 0;
+    while (op_index < trace->num_ops &&
+           read_rep_op(tracefile, &trace->ops[op_index], path)) {
+        if (trace->ops[op_index].type != FREE &&
+            trace->ops[op_index].index > max_index)
+            max_index = trace->ops[op_index].index;
+        op_index++;
+    }
+    assert(max_index == trace->num_ids - 1);
+    assert(op_index == trace->num_ops);
+}
+
+/*
+ * read_trace - read a trace file and store it in memory
+ */
+trace_t *read_trace(char *tracedir, char *filename) {
+    FILE *tracefile;
+    trace_t *trace;
+    char path[MAXLINE];
+    char magic[sizeof(TRACE_BIN_MAGIC) - 1];
+
+    if (verbose > 1) printf("Reading tracefile: %s\n", filename);
+
+    /* Allocate the trace record */
+    if ((trace = (trace_t *)malloc(sizeof(trace_t))) == NULL)
+        trace_error("malloc 1 failed in read_trace for", filename);
+
+    /* Open the trace file and look at its format */
+    strcpy(path, tracedir);
+    strcat(path, filename);
+    strncpy(trace->trace_name, filename, MAXLINE - 1);
+    trace->trace_name[MAXLINE - 1] = '\0';
+    trace->map = NULL;
+    trace->map_len = 0;
+    if ((tracefile = fopen(path, "r")) == NULL)
+        trace_error("Could not open in read_trace:", path);
+
+    if (fread(magic, 1, sizeof(magic), tracefile) == sizeof(magic) &&
+        !memcmp(magic, TRACE_BIN_MAGIC, sizeof(magic))) {
+        read_trace_bin(trace, fileno(tracefile), path);
+    } else {
+        rewind(tracefile);
+        read_trace_rep(trace, tracefile, path);
+    }
+    fclose(tracefile);
+    alloc_blocks(trace, path);
+
+    return trace;
+}
+
+/*
+ * free_trace - Free the trace record and the three arrays it points
+ *              to, all of which were allocated in read_trace().
+ */
+void free_trace(trace_t *trace) {
+    if (trace->map) /* free the three arrays... */
+        munmap(trace->map, trace->map_len);
+    else
+        free(trace->ops);
+    free(trace->blocks);
+    free(trace->block_sizes);
+    free(trace); /* and the trace record itself... */
+}
+
+/*
+ * write_trace_rep - write a trace in the text format
+ */
+int write_trace_rep(trace_t *trace, FILE *f) {
+    int i;
+
+    fprintf(f, "%d\n%d\n%d\n%d\n", trace->sugg_heapsize, trace->num_ids,
+            trace->num_ops, trace->weight);
+    for (i = 0; i < trace->num_ops; i++) {
+        traceop_t *op = &trace->ops[i];
+        switch (op->type) {
+            case ALLOC:
+                fprintf(f, "a %d %d\n", op->index, op->size);
+                break;
+            case REALLOC:
+                fprintf(f, "r %d %d\n", op->index, op->size);
+                break;
+            case FREE:
+                fprintf(f, "f %d\n", op->index);
+                break;
+        }
+    }
+    return ferror(f) ? -1 : 0;
+}
+
+/*
+ * write_trace_bin - write a trace in the binary format
+ */
+int write_trace_bin(trace_t *trace, FILE *f) {
+    trace_bin_header_t hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = TRACE_BIN_VERSION;
+    hdr.op_size = sizeof(traceop_t);
+    hdr.sugg_heapsize = trace->sugg_heapsize;
+    hdr.num_ids = trace->num_ids;
+    hdr.num_ops = trace->num_ops;
+    hdr.weight = trace->weight;
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(trace->ops, sizeof(traceop_t), trace->num_ops, f) !=
+            (size_t)trace->num_ops)
+        return -1;
+    return 0;
+}
+
+/*
+ * A trace stream. The reader thread fills bufs[k] and marks it full; the
+ * replay takes the full buffers in turn and hands each one back (clears
+ * full) when it asks for the next. Both sides wait on the same condition.
+ * The reader lives as long as the stream: after the end of the trace it
+ * waits for a rewind, so that timed replays do not start a thread.
+ */
+struct trace_stream {
+    FILE *file;
+    char path[MAXLINE];
+    int binary;       /* binary or text format */
+    long data_offset; /* file offset of the first op */
+    int num_ops;
+    int num_ids;
+    int ops_read; /* ops read so far (reader thread only) */
+
+    traceop_t *bufs[2];
+    int counts[2]; /* ops in each buffer, valid while it is full */
+    int full[2];
+    int cur;          /* buffer the replay takes next */
+    int held;         /* buffer the replay is using, or -1 */
+    int done;         /* the reader has reached the end of the trace */
+    int restart;      /* tells the reader thread to start over */
+    int stop;         /* tells the reader thread to exit */
+    double pass_secs; /* time spent reading in this pass (reader only) */
+    double read_secs; /* ... and in the last complete pass */
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/*
+ * fill_chunk - read up to TRACE_CHUNK_OPS ops into buf; returns the number
+ *     read, 0 at the end of the trace
+ */
+static int fill_chunk(trace_stream_t *s, traceop_t *buf) {
+    int n = s->num_ops - s->ops_read;
+
+    if (n > TRACE_CHUNK_OPS) n = TRACE_CHUNK_OPS;
+    if (s->binary) {
+        if (fread(buf, sizeof(traceop_t), n, s->file) != (size_t)n) {
+            printf("Truncated binary tracefile %s\n", s->path);
+            exit(1);
+        }
+        if (!bin_ops_ok(buf, n, s->num_ids)) {
+            printf("Malformed binary tracefile %s\n", s->path);
+            exit(1);
+        }
+    } else {
+        int i;
+        for (i = 0; i < n; i++)
+            if (!read_rep_op(s->file, &buf[i], s->path)) break;
+        n = i;
+    }
+    s->ops_read += n;
+    return n;
+}
+
+/*
+ * stream_reset - go back to the first op, with both buffers empty
+ */
+static void stream_reset(trace_stream_t *s) {
+    if (fseek(s->file, s->data_offset, SEEK_SET) < 0)
+        trace_error("Could not seek in", s->path);
+    s->ops_read = 0;
+    s->full[0] = s->full[1] = 0;
+    s->cur = 0;
+    s->held = -1;
+    s->done = 0;
+    s->restart = 0;
+    s->pass_secs = 0;
+}
+
+static double now_secs(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * stream_reader - body of the reader thread
+ */
+static void *stream_reader(void *arg) {
+    trace_stream_t *s = arg;
+    int k = 0;
+    int n;
+    double start;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (!s->stop && !s->restart && (s->done || s->full[k]))
+            pthread_cond_wait(&s->cond, &s->lock);
+        if (s->stop) {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+        if (s->restart) {
+            stream_reset(s);
+            k = 0;
+            pthread_cond_broadcast(&s->cond);
+            pthread_mutex_unlock(&s->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&s->lock);
+
+        start = now_secs();
+        n = fill_chunk(s, s->bufs[k]);
+        s->pass_secs += now_secs() - start;
+
+        pthread_mutex_lock(&s->lock);
+        s->counts[k] = n;
+        s->full[k] = 1;
+        if (n == 0) {
+            s->done = 1;
+            s->read_secs = s->pass_secs;
+        }
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        if (n > 0) k ^= 1;
+    }
+    return NULL;
+}
+
+/*
+ * stream_start - start the reader thread at the first op
+ */
+static void stream_start(trace_stream_t *s) {
+    stream_reset(s);
+    s->stop = 0;
+    if ((errno = pthread_create(&s->reader, NULL, stream_reader, s)) != 0)
+        trace_error("Could not start the reader thread for", s->path);
+}
+
+/*
+ * stream_stop - stop the reader thread, wherever it is
+ */
+static void stream_stop(trace_stream_t *s) {
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->reader, NULL);
+}
+
+/*
+ * trace_stream_open - open a trace file for streaming replay
+ */
+trace_stream_t *trace_stream_open(char *tracedir, char *filename,
+                                  trace_t *info) {
+    trace_stream_t *s;
+    trace_bin_header_t hdr;
+
+    if (verbose > 1) printf("Streaming tracefile: %s\n", filename);
+
+    if ((s = (trace_stream_t *)calloc(1, sizeof(trace_stream_t))) == NULL ||
+        (s->bufs[0] = malloc(2 * TRACE_CHUNK_OPS * sizeof(traceop_t))) == NULL)
+        trace_error("malloc failed in trace_stream_open for", filename);
+    s->bufs[1] = s->bufs[0] + TRACE_CHUNK_OPS;
+
+    snprintf(s->path, MAXLINE, "%s%s", tracedir, filename);
+    memset(info, 0, sizeof(*info));
+    snprintf(info->trace_name, sizeof(info->trace_name), "%s", filename);
+    if ((s->file = fopen(s->path, "r")) == NULL)
+        trace_error("Could not open in trace_stream_open:", s->path);
+
+    if (fread(&hdr, sizeof(hdr), 1, s->file) == 1 &&
+        !memcmp(hdr.magic, TRACE_BIN_MAGIC, sizeof(hdr.magic))) {
+        if (!bin_header_ok(&hdr)) {
+            printf("Malformed binary tracefile %s\n", s->path);
+            exit(1);
+        }
+        s->binary = 1;
+        info->sugg_heapsize = hdr.sugg_heapsize;
+        info->num_ids = hdr.num_ids;
+        info->num_ops = hdr.num_ops;
+        info->weight = hdr.weight;
+    } else {
+        rewind(s->file);
+        read_rep_header(info, s->file);
+    }
+    s->data_offset = ftell(s->file);
+    s->num_ops = info->num_ops;
+    s->num_ids = info->num_ids;
+    posix_fadvise(fileno(s->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    stream_start(s);
+    return s;
+}
+
+/*
+ * trace_stream_next - hand back the current chunk and take the next one
+ */
+int trace_stream_next(trace_stream_t *s, traceop_t **ops) {
+    int n;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->held >= 0) {
+        s->full[s->held] = 0;
+        s->held = -1;
+        pthread_cond_broadcast(&s->cond);
+    }
+    while (!s->full[s->cur]) pthread_cond_wait(&s->cond, &s->lock);
+    n = s->counts[s->cur];
+    *ops = s->bufs[s->cur];
+    if (n > 0) { /* the end-of-trace marker stays put */
+        s->held = s->cur;
+        s->cur ^= 1;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return n;
+}
+
+/*
+ * trace_stream_rewind - start the stream over from the first op, and wait
+ *     until the reader has
+ */
+void trace_stream_rewind(trace_stream_t *s) {
+    pthread_mutex_lock(&s->lock);
+    s->restart = 1;
+    pthread_cond_broadcast(&s->cond);
+    while (s->restart) pthread_cond_wait(&s->cond, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * trace_stream_read_secs - the time the reader spent reading and parsing
+ *     the last pass it completed, 0 before the first
+ */
+double trace_stream_read_secs(trace_stream_t *s) {
+    double secs;
+
+    pthread_mutex_lock(&s->lock);
+    secs = s->read_secs;
+    pthread_mutex_unlock(&s->lock);
+    return secs;
+}
+
+/*
+ * trace_stream_close - stop the reader and free the stream
+ */
+void trace_stream_close(trace_stream_t *s) {
+    stream_stop(s);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    fclose(s->file);
+    free(s->bufs[0]);
+    free(s);
+}
+
+/*
+ * The id map is an open-addressed hash with linear probing, kept at most
+ * half full and without tombstones (removal shifts entries back), so its
+ * size follows the number of live ids rather than the number of ids.
+ */
+static inline size_t hash_id(int id, size_t cap) {
+    return ((unsigned)id * 2654435761u) & (cap - 1);
+}
+
+void idmap_init(idmap_t *map) {
+    map->slots = NULL;
+    map->cap = 0;
+    map->count = 0;
+}
+
+void idmap_clear(idmap_t *map) {
+    size_t i;
+    for (i = 0; i < map->cap; i++) map->slots[i].id = -1;
+    map->count = 0;
+}
+
+void idmap_destroy(idmap_t *map) {
+    free(map->slots);
+    idmap_init(map);
+}
+
+/*
+ * idmap_grow - double the capacity of the map and rehash
+ */
+static void idmap_grow(idmap_t *map) {
+    size_t cap = map->cap ? 2 * map->cap : 1024;
+    idmap_slot_t *slots = malloc(cap * sizeof(idmap_slot_t));
+    size_t i, h;
+
+    if (slots == NULL) trace_error("malloc failed in", "idmap_grow");
+    for (i = 0; i < cap; i++) slots[i].id = -1;
+    for (i = 0; i < map->cap; i++) {
+        if (map->slots[i].id < 0) continue;
+        for (h = hash_id(map->slots[i].id, cap); slots[h].id >= 0;
+             h = (h + 1) & (cap - 1))
+            ;
+        slots[h] = map->slots[i];
+    }
+    free(map->slots);
+    map->slots = slots;
+    map->cap = cap;
+}
+
+idmap_slot_t *idmap_find(idmap_t *map, int id) {
+    size_t h;
+
+    if (map->cap == 0) return NULL;
+    for (h = hash_id(id, map->cap); map->slots[h].id != id;
+         h = (h + 1) & (map->cap - 1))
+        if (map->slots[h].id < 0) return NULL;
+    return &map->slots[h];
+}
+
+idmap_slot_t *idmap_insert(idmap_t *map, int id) {
+    idmap_slot_t *slot = idmap_find(map, id);
+    size_t h;
+
+    if (slot != NULL) return slot;
+    if (2 * (map->count + 1) > map->cap) idmap_grow(map);
+    for (h = hash_id(id, map->cap); map->slots[h].id >= 0;
+         h = (h + 1) & (map->cap - 1))
+        ;
+    map->slots[h].id = id;
+    map->slots[h].block = NULL;
+    map->slots[h].size = 0;
+    map->count++;
+    return &map->slots[h];
+}
+
+void idmap_remove(idmap_t *map, int id) {
+    idmap_slot_t *slot = idmap_find(map, id);
+    size_t mask = map->cap - 1;
+    size_t h, j;
+
+    if (slot == NULL) return;
+    h = slot - map->slots;
+    for (j = (h + 1) & mask; map->slots[j].id >= 0; j = (j + 1) & mask) {
+        size_t home = hash_id(map->slots[j].id, map->cap);
+        if (((j - home) & mask) >= ((j - h) & mask)) {
+            map->slots[h] = map->slots[j];
+            h = j;
+        }
+    }
+    map->slots[h].id = -1;
+    map->count--;
+}
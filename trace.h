@@ -0,0 +1,123 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+
+/*
+ * Trace files come in two formats:
+ *
+ *  - the text format (.rep), a 4-line header followed by one request per
+ *    line ("a <id> <bytes>", "r <id> <bytes>" or "f <id>"), where "#" starts
+ *    a comment that runs to the end of the line;
+ *
+ *  - the binary format, a trace_bin_header_t followed by num_ops
+ *    traceop_t records. The records are fixed-width and in native byte
+ *    order, so that a binary trace is mmap'd and used in place, with no
+ *    parse step.
+ *
+ * read_trace tells the two apart by the binary magic number.
+ */
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct {
+    enum { ALLOC, FREE, REALLOC } type; /* type of request */
+    int index;                          /* index for free() to use later */
+    int size;                           /* byte size of alloc/realloc request */
+} traceop_t;
+
+/* Holds the information for one trace file*/
+typedef struct {
+    char trace_name[1024];
+    int sugg_heapsize;   /* suggested heap size (unused) */
+    int num_ids;         /* number of alloc/realloc ids */
+    int num_ops;         /* number of distinct requests */
+    int weight;          /* weight for this trace (unused) */
+    traceop_t *ops;      /* array of requests */
+    char **blocks;       /* array of ptrs returned by malloc/realloc... */
+    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    void *map;           /* mapping of a binary trace (ops point into it) */
+    size_t map_len;      /* ... and its length, or 0 if ops was malloc'd */
+} trace_t;
+
+#define TRACE_BIN_MAGIC "MMTRACE\n" /* first 8 bytes of a binary trace */
+#define TRACE_BIN_VERSION 1
+
+/* Header of a binary trace */
+typedef struct {
+    char magic[8];     /* TRACE_BIN_MAGIC */
+    int version;       /* TRACE_BIN_VERSION, also catches byte order */
+    int op_size;       /* sizeof(traceop_t) */
+    int sugg_heapsize; /* same fields as the text header */
+    int num_ids;
+    int num_ops;
+    int weight;
+} trace_bin_header_t;
+
+/* read a trace file (of either format) and store it in memory */
+trace_t *read_trace(char *tracedir, char *filename);
+
+/* free a trace returned by read_trace */
+void free_trace(trace_t *trace);
+
+/* write a trace in the text or binary format; return 0 on success */
+int write_trace_rep(trace_t *trace, FILE *f);
+int write_trace_bin(trace_t *trace, FILE *f);
+
+/*
+ * Streaming replay: instead of loading the whole op array, a trace stream
+ * reads TRACE_CHUNK_OPS ops at a time into one of two buffers on a reader
+ * thread, while the driver replays the other buffer. Together with an
+ * idmap_t in place of the dense blocks/block_sizes arrays, this keeps the
+ * driver's memory independent of the length of the trace.
+ */
+#define TRACE_CHUNK_OPS 4096
+
+typedef struct trace_stream trace_stream_t;
+
+/* open a trace file (of either format) for streaming; the header fields
+ * and name are copied to *info, whose ops and blocks are left NULL */
+trace_stream_t *trace_stream_open(char *tracedir, char *filename,
+                                  trace_t *info);
+
+/* set *ops to the next chunk of the trace and return its length, or 0 at
+ * the end of the trace; the previous chunk is handed back to the reader */
+int trace_stream_next(trace_stream_t *s, traceop_t **ops);
+
+/* start over from the first op (for repeated timing runs) */
+void trace_stream_rewind(trace_stream_t *s);
+
+/* seconds the reader thread spent reading the last whole pass over the
+ * trace, the streaming counterpart of the time to load it */
+double trace_stream_read_secs(trace_stream_t *s);
+
+/* stop the reader thread and close the trace */
+void trace_stream_close(trace_stream_t *s);
+
+/* One live id in an idmap_t */
+typedef struct {
+    int id; /* -1 if the slot is empty */
+    char *block;
+    size_t size;
+} idmap_slot_t;
+
+/* Open-addressed hash from id to block, sized by the live ids only */
+typedef struct {
+    idmap_slot_t *slots;
+    size_t cap;   /* power of two */
+    size_t count; /* live ids */
+} idmap_t;
+
+void idmap_init(idmap_t *map);
+void idmap_clear(idmap_t *map);
+void idmap_destroy(idmap_t *map);
+
+/* return the slot for id, adding it if it is not there yet */
+idmap_slot_t *idmap_insert(idmap_t *map, int id);
+
+/* return the slot for id, or NULL if it is not live */
+idmap_slot_t *idmap_find(idmap_t *map, int id);
+
+/* remove id, if it is live */
+void idmap_remove(idmap_t *map, int id);
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,78 @@
+/*
+ * traceconv - convert allocator traces between the text (.rep) and the
+ *     binary format read by mdriver (see trace.h)
+ *
+ * The input format is detected automatically. The output is binary if
+ * the output file name ends in ".bin" (or -b is given) and text otherwise
+ * (or if -r is given).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+int verbose = 0; /* read by trace.c */
+
+static void usage(void) {
+    fprintf(stderr, "Usage: traceconv [-hbrv] <input> <output>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b         Write the binary format.\n");
+    fprintf(stderr, "\t-r         Write the text (.rep) format.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-v         Print the trace header.\n");
+}
+
+int main(int argc, char **argv) {
+    int binary = -1; /* -1: decide from the output file name */
+    trace_t *trace;
+    FILE *out;
+    char *outname;
+    size_t len;
+    int c, ret;
+
+    while ((c = getopt(argc, argv, "hbrv")) != EOF) {
+        switch (c) {
+            case 'b':
+                binary = 1;
+                break;
+            case 'r':
+                binary = 0;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+                usage();
+                exit(0);
+            default:
+                usage();
+                exit(1);
+        }
+    }
+    if (argc - optind != 2) {
+        usage();
+        exit(1);
+    }
+    outname = argv[optind + 1];
+    len = strlen(outname);
+    if (binary < 0) binary = len >= 4 && !strcmp(outname + len - 4, ".bin");
+
+    trace = read_trace("", argv[optind]);
+    if (verbose)
+        printf("%s: %d ids, %d ops\n", trace->trace_name, trace->num_ids,
+               trace->num_ops);
+
+    if ((out = fopen(outname, binary ? "wb" : "w")) == NULL) {
+        perror(outname);
+        exit(1);
+    }
+    ret = binary ? write_trace_bin(trace, out) : write_trace_rep(trace, out);
+    if (fclose(out) != 0 || ret < 0) {
+        perror(outname);
+        exit(1);
+    }
+    free_trace(trace);
+    return 0;
+}
@@ -0,0 +1,7 @@
+# Small and large blocks with very different lifetimes, the pattern that
+# strands small survivors between freed large blocks.
+seed 4
+peak 16000000
+allocs 1000000
+size bimodal 24 3000 0.9
+lifetime bimodal 50000 20 0.1
@@ -0,0 +1,7 @@
+# Steady churn of log-normally distributed sizes with exponential-ish
+# lifetimes: the common shape of real C programs, at scale.
+seed 1
+peak 8000000
+allocs 2000000
+size lognormal 48 1.2
+lifetime powerlaw 1 100000 1.1
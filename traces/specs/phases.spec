@@ -0,0 +1,21 @@
+# A program with distinct phases: a startup phase that builds long-lived
+# structures, a churn phase of small short-lived objects, and a batch phase
+# of large buffers that are all released at once.
+seed 2
+peak 12000000
+
+phase startup
+allocs 20000
+size powerlaw 16 4096 1.8
+lifetime forever
+
+phase churn
+allocs 1000000
+size uniform 8 128
+lifetime uniform 1 64
+
+phase batch
+allocs 2000
+size bimodal 65536 262144 0.8
+lifetime const 1000
+drain
@@ -0,0 +1,8 @@
+# Growing buffers (string builders, vectors) interleaved with small
+# allocations: a fifth of the blocks are doubled up to 6 times.
+seed 3
+peak 8000000
+allocs 500000
+size bimodal 16 64 0.5
+lifetime powerlaw 10 20000 1.2
+realloc 0.2 2 6